@@ -0,0 +1,852 @@
+/*
+ * This file is part of PRO ONLINE.
+
+ * PRO ONLINE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * PRO ONLINE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PRO ONLINE. If not, see <http://www.gnu.org/licenses/ .
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <pthread.h>
+#include <user.h>
+#include <catalog.h>
+#include <status.h>
+#include <config.h>
+#include <log.h>
+#include <settings.h>
+#include <sqlite3.h>
+
+// Crosslink Chain Depth Limit (longer Chains are treated as Cycles)
+#define CATALOG_CROSSLINK_DEPTH 16
+
+// Catalog Reload Request
+volatile sig_atomic_t _catalog_reload = 0;
+
+// Published Catalog
+static SceNetAdhocctlCatalog * _catalog = NULL;
+
+// Catalog Generation (bumped on every Publish, Threads compare it against their cached Reference)
+static uint32_t _catalog_generation = 0;
+
+// Catalog Lock (guards Publishing and refreshing a Thread's cached Reference)
+static pthread_mutex_t _catalog_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Cached Reference of the calling Thread (keeps Acquisitions off the Catalog Lock until the next Publish)
+static __thread SceNetAdhocctlCatalog * _catalog_local = NULL;
+static __thread uint32_t _catalog_local_generation = 0;
+
+// Reload Thread (Acceptor Thread only)
+static pthread_t _catalog_thread;
+static int _catalog_thread_started = 0;
+static int _catalog_loading = 0;
+
+// Unknown Product Writer Thread
+static pthread_t _product_thread;
+static int _product_running = 0;
+
+// Unknown Product Lock & Condition (guard the Queue and the Deduplication Set)
+static pthread_mutex_t _product_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t _product_cond = PTHREAD_COND_INITIALIZER;
+
+// Unknown Product Queue (waiting for the next Transaction)
+static SceNetAdhocctlProductCode * _product_queue = NULL;
+static uint32_t _product_queue_count = 0;
+static uint32_t _product_queue_size = 0;
+
+// Unknown Product Deduplication Set (Open Addressing, at most half full)
+static SceNetAdhocctlProductCode * _product_seen = NULL;
+static uint32_t _product_seen_count = 0;
+static uint32_t _product_seen_size = 0;
+
+// Function Prototypes
+void * catalog_main(void * arg);
+SceNetAdhocctlCatalog * build_catalog(void);
+SceNetAdhocctlCatalogEntry * insert_catalog_entry(SceNetAdhocctlCatalog * catalog, const char * id);
+void resolve_catalog_links(SceNetAdhocctlCatalog * catalog);
+void publish_catalog(SceNetAdhocctlCatalog * catalog);
+void * product_main(void * arg);
+int remember_product(const SceNetAdhocctlProductCode * product);
+void write_products(sqlite3 * db, sqlite3_stmt * statement, SceNetAdhocctlProductCode * product, uint32_t count);
+
+/**
+ * Load Product Catalog from the Database (blocking, used at Startup)
+ * @return 0 on Success or -1 if the Database couldn't be read
+ */
+int load_catalog(void)
+{
+	// Build Catalog
+	SceNetAdhocctlCatalog * catalog = build_catalog();
+	
+	// Failed to build Catalog
+	if(catalog == NULL) return -1;
+	
+	// Publish Catalog
+	publish_catalog(catalog);
+	
+	// Return Success
+	return 0;
+}
+
+/**
+ * Reload Product Catalog in the Background (the old Catalog stays in use until the new one is ready)
+ */
+void reload_catalog(void)
+{
+	// Reload already running
+	if(__atomic_load_n(&_catalog_loading, __ATOMIC_ACQUIRE))
+	{
+		// Notify User
+		log_text(LOG_LEVEL_WARNING, "Product Catalog Reload already in progress.");
+		
+		// Stop here
+		return;
+	}
+	
+	// Reap finished Reload Thread
+	if(_catalog_thread_started) pthread_join(_catalog_thread, NULL);
+	_catalog_thread_started = 0;
+	
+	// Mark Reload as running
+	__atomic_store_n(&_catalog_loading, 1, __ATOMIC_RELEASE);
+	
+	// Keep Signals on the Acceptor Thread
+	sigset_t mask, oldmask;
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGINT);
+	sigaddset(&mask, SIGTERM);
+	sigaddset(&mask, SIGHUP);
+	pthread_sigmask(SIG_BLOCK, &mask, &oldmask);
+	
+	// Create Reload Thread
+	if(pthread_create(&_catalog_thread, NULL, catalog_main, NULL) == 0) _catalog_thread_started = 1;
+	
+	// Failed to create Reload Thread
+	else
+	{
+		// Notify User
+		log_text(LOG_LEVEL_ERROR, "%s: failed to create Reload Thread.", __func__);
+		
+		// Reload not running
+		__atomic_store_n(&_catalog_loading, 0, __ATOMIC_RELEASE);
+	}
+	
+	// Restore Signal Mask
+	pthread_sigmask(SIG_SETMASK, &oldmask, NULL);
+}
+
+/**
+ * Free Product Catalog (waits for a running Reload)
+ */
+void free_catalog(void)
+{
+	// Wait for Reload Thread
+	if(_catalog_thread_started) pthread_join(_catalog_thread, NULL);
+	_catalog_thread_started = 0;
+	
+	// Unpublish Catalog (remaining References keep it alive)
+	publish_catalog(NULL);
+	
+	// Drop cached Reference of this Thread
+	drop_catalog_cache();
+}
+
+/**
+ * Acquire Reference to the current Product Catalog
+ * @return Catalog or NULL if none is loaded
+ */
+SceNetAdhocctlCatalog * acquire_catalog(void)
+{
+	// Cached Reference outdated
+	if(__atomic_load_n(&_catalog_generation, __ATOMIC_ACQUIRE) != _catalog_local_generation)
+	{
+		// Lock Catalog
+		pthread_mutex_lock(&_catalog_lock);
+		
+		// Reference published Catalog
+		SceNetAdhocctlCatalog * catalog = _catalog;
+		if(catalog != NULL) __atomic_add_fetch(&catalog->refcount, 1, __ATOMIC_RELAXED);
+		uint32_t generation = _catalog_generation;
+		
+		// Unlock Catalog
+		pthread_mutex_unlock(&_catalog_lock);
+		
+		// Replace cached Reference
+		release_catalog(_catalog_local);
+		_catalog_local = catalog;
+		_catalog_local_generation = generation;
+	}
+	
+	// Reference cached Catalog (the cached Reference keeps it alive, so no Lock is needed)
+	if(_catalog_local != NULL) __atomic_add_fetch(&_catalog_local->refcount, 1, __ATOMIC_RELAXED);
+	
+	// Return Catalog
+	return _catalog_local;
+}
+
+/**
+ * Drop the cached Catalog Reference of the calling Thread (call before the Thread exits)
+ */
+void drop_catalog_cache(void)
+{
+	// Release cached Reference
+	release_catalog(_catalog_local);
+	_catalog_local = NULL;
+	
+	// Refresh on the next Acquisition
+	_catalog_local_generation = __atomic_load_n(&_catalog_generation, __ATOMIC_RELAXED) - 1;
+}
+
+/**
+ * Release Product Catalog Reference
+ * @param catalog Catalog (NULL is ignored)
+ */
+void release_catalog(SceNetAdhocctlCatalog * catalog)
+{
+	// Drop Reference (the last one frees the Catalog)
+	if(catalog != NULL && __atomic_sub_fetch(&catalog->refcount, 1, __ATOMIC_ACQ_REL) == 0)
+	{
+		// Free Slots
+		free(catalog->entry);
+		
+		// Free Catalog
+		free(catalog);
+	}
+}
+
+/**
+ * Start Unknown Product Writer Thread
+ * @return 0 on Success or -1 on Error
+ */
+int start_product_writer(void)
+{
+	// Keep Signals on the Acceptor Thread
+	sigset_t mask, oldmask;
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGINT);
+	sigaddset(&mask, SIGTERM);
+	sigaddset(&mask, SIGHUP);
+	pthread_sigmask(SIG_BLOCK, &mask, &oldmask);
+	
+	// Create Writer Thread
+	_product_running = 1;
+	int result = pthread_create(&_product_thread, NULL, product_main, NULL);
+	
+	// Restore Signal Mask
+	pthread_sigmask(SIG_SETMASK, &oldmask, NULL);
+	
+	// Failed to create Writer Thread
+	if(result != 0)
+	{
+		// Notify User
+		log_text(LOG_LEVEL_ERROR, "%s: failed to create Unknown Product Writer Thread.", __func__);
+		
+		// Not running
+		_product_running = 0;
+		
+		// Return Error
+		return -1;
+	}
+	
+	// Return Success
+	return 0;
+}
+
+/**
+ * Stop Unknown Product Writer Thread (commits the queued Products first)
+ */
+void stop_product_writer(void)
+{
+	// Writer not running
+	if(!_product_running) return;
+	
+	// Stop Writer (after it committed the Queue)
+	pthread_mutex_lock(&_product_lock);
+	_product_running = 0;
+	pthread_cond_signal(&_product_cond);
+	pthread_mutex_unlock(&_product_lock);
+	
+	// Wait for Writer
+	pthread_join(_product_thread, NULL);
+	
+	// Free Queue
+	free(_product_queue);
+	_product_queue = NULL;
+	_product_queue_count = 0;
+	_product_queue_size = 0;
+	
+	// Free Deduplication Set
+	free(_product_seen);
+	_product_seen = NULL;
+	_product_seen_count = 0;
+	_product_seen_size = 0;
+}
+
+/**
+ * Queue Unknown Product for the Database (each Product Code gets written once)
+ * @param product Product Code
+ */
+void queue_unknown_product(const SceNetAdhocctlProductCode * product)
+{
+	// Lock Queue
+	pthread_mutex_lock(&_product_lock);
+	
+	// New Product Code (Writer running)
+	if(_product_running && remember_product(product) == 1)
+	{
+		// Grow Queue
+		if(_product_queue_count == _product_queue_size)
+		{
+			// New Capacity
+			uint32_t size = (_product_queue_size == 0) ? 64 : _product_queue_size * 2;
+			
+			// Resize Queue
+			SceNetAdhocctlProductCode * queue = (SceNetAdhocctlProductCode *)realloc(_product_queue, size * sizeof(SceNetAdhocctlProductCode));
+			
+			// Save Queue
+			if(queue != NULL)
+			{
+				_product_queue = queue;
+				_product_queue_size = size;
+			}
+		}
+		
+		// Enqueue Product Code (dropped if out of Memory)
+		if(_product_queue_count < _product_queue_size)
+		{
+			// Append Product Code
+			_product_queue[_product_queue_count++] = *product;
+			
+			// Wake Writer
+			pthread_cond_signal(&_product_cond);
+		}
+	}
+	
+	// Unlock Queue
+	pthread_mutex_unlock(&_product_lock);
+}
+
+/**
+ * Find Product in Catalog
+ * @param catalog Catalog (NULL is treated as empty)
+ * @param product Product Code
+ * @return Catalog Entry or NULL
+ */
+const SceNetAdhocctlCatalogEntry * find_catalog_entry(SceNetAdhocctlCatalog * catalog, const SceNetAdhocctlProductCode * product)
+{
+	// Empty Catalog
+	if(catalog == NULL) return NULL;
+	
+	// Linear Probing (the Table is at most half full)
+	uint32_t slot = hash_product_code((SceNetAdhocctlProductCode *)product) & catalog->mask;
+	while(catalog->entry[slot].id.data[0] != 0)
+	{
+		// Found Product
+		if(memcmp(catalog->entry[slot].id.data, product->data, PRODUCT_CODE_LENGTH) == 0) return &catalog->entry[slot];
+		
+		// Next Slot
+		slot = (slot + 1) & catalog->mask;
+	}
+	
+	// Unknown Product
+	return NULL;
+}
+
+/**
+ * Catalog Reload Thread
+ * @param arg Unused
+ * @return NULL
+ */
+void * catalog_main(void * arg)
+{
+	// Build Catalog
+	SceNetAdhocctlCatalog * catalog = build_catalog();
+	
+	// Publish Catalog (Logins switch over with their next Lookup)
+	if(catalog != NULL) publish_catalog(catalog);
+	
+	// Keep old Catalog
+	else log_text(LOG_LEVEL_WARNING, "Product Catalog Reload failed, keeping the old Catalog.");
+	
+	// Reload finished
+	__atomic_store_n(&_catalog_loading, 0, __ATOMIC_RELEASE);
+	
+	// Exit Thread
+	return NULL;
+}
+
+/**
+ * Build Product Catalog from the Database
+ * @return Catalog or NULL on Error
+ */
+SceNetAdhocctlCatalog * build_catalog(void)
+{
+	// Database Handle
+	sqlite3 * db = NULL;
+	
+	// Open Database
+	if(sqlite3_open_v2(_settings.database, &db, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK)
+	{
+		// Notify User
+		log_text(LOG_LEVEL_ERROR, "%s: failed to open %s.", __func__, _settings.database);
+		
+		// Close Database
+		sqlite3_close(db);
+		
+		// Return Error
+		return NULL;
+	}
+	
+	// Wait for concurrent Product Writes instead of failing
+	sqlite3_busy_timeout(db, 1000);
+	
+	// Read all Tables from one Snapshot
+	int complete = (sqlite3_exec(db, "BEGIN;", NULL, NULL, NULL) == SQLITE_OK);
+	
+	// Catalog
+	SceNetAdhocctlCatalog * catalog = NULL;
+	
+	// SQL Statements
+	const char * sql = "SELECT (SELECT COUNT(*) FROM productids) + (SELECT COUNT(*) FROM crosslinks);";
+	const char * sql2 = "SELECT id, name FROM productids;";
+	const char * sql3 = "SELECT id_from, id_to FROM crosslinks;";
+	
+	// Prepared SQL Statement
+	sqlite3_stmt * statement = NULL;
+	
+	// Count Rows (upper Bound for the Product Count)
+	if(complete && sqlite3_prepare_v2(db, sql, strlen(sql) + 1, &statement, NULL) == SQLITE_OK && sqlite3_step(statement) == SQLITE_ROW)
+	{
+		// Row Count
+		uint32_t rows = (uint32_t)sqlite3_column_int(statement, 0);
+		
+		// Slot Count (Power of 2, at least twice the Row Count)
+		uint32_t slots = 16;
+		while(slots < rows * 2) slots *= 2;
+		
+		// Allocate Catalog
+		catalog = (SceNetAdhocctlCatalog *)calloc(1, sizeof(SceNetAdhocctlCatalog));
+		if(catalog != NULL) catalog->entry = (SceNetAdhocctlCatalogEntry *)calloc(slots, sizeof(SceNetAdhocctlCatalogEntry));
+		
+		// Out of Memory
+		if(catalog != NULL && catalog->entry == NULL)
+		{
+			// Free Catalog
+			free(catalog);
+			catalog = NULL;
+		}
+		
+		// Initialize Catalog
+		if(catalog != NULL)
+		{
+			catalog->refcount = 1;
+			catalog->mask = slots - 1;
+		}
+	}
+	
+	// Destroy Prepared SQL Statement
+	sqlite3_finalize(statement);
+	statement = NULL;
+	
+	// Load Product Names
+	complete = 0;
+	if(catalog != NULL && sqlite3_prepare_v2(db, sql2, strlen(sql2) + 1, &statement, NULL) == SQLITE_OK)
+	{
+		// Step Result
+		int stepresult = SQLITE_ROW;
+		
+		// Iterate Rows
+		while((stepresult = sqlite3_step(statement)) == SQLITE_ROW)
+		{
+			// Fetch Row
+			const char * id = (const char *)sqlite3_column_text(statement, 0);
+			const char * name = (const char *)sqlite3_column_text(statement, 1);
+			
+			// Add Product
+			SceNetAdhocctlCatalogEntry * entry = insert_catalog_entry(catalog, id);
+			
+			// Copy Display Name
+			if(entry != NULL && name != NULL)
+			{
+				strncpy(entry->name, name, sizeof(entry->name) - 1);
+				entry->name[sizeof(entry->name) - 1] = 0;
+			}
+		}
+		
+		// Read every Row (Busy or I/O Errors stop early)
+		complete = (stepresult == SQLITE_DONE);
+	}
+	
+	// Destroy Prepared SQL Statement
+	sqlite3_finalize(statement);
+	statement = NULL;
+	
+	// Load Crosslinks
+	if(complete && sqlite3_prepare_v2(db, sql3, strlen(sql3) + 1, &statement, NULL) == SQLITE_OK)
+	{
+		// Step Result
+		int stepresult = SQLITE_ROW;
+		
+		// Iterate Rows
+		while((stepresult = sqlite3_step(statement)) == SQLITE_ROW)
+		{
+			// Fetch Row
+			const char * from = (const char *)sqlite3_column_text(statement, 0);
+			const char * to = (const char *)sqlite3_column_text(statement, 1);
+			
+			// Add Product
+			SceNetAdhocctlCatalogEntry * entry = (to != NULL) ? insert_catalog_entry(catalog, from) : NULL;
+			
+			// Link Product (the first Crosslink of a Product wins)
+			if(entry != NULL && !entry->crosslinked)
+			{
+				strncpy(entry->link.data, to, PRODUCT_CODE_LENGTH);
+				entry->crosslinked = 1;
+				catalog->crosslinks++;
+			}
+		}
+		
+		// Read every Row (Busy or I/O Errors stop early)
+		complete = (stepresult == SQLITE_DONE);
+	}
+	
+	// Crosslinks unavailable
+	else complete = 0;
+	
+	// Destroy Prepared SQL Statement
+	sqlite3_finalize(statement);
+	
+	// Truncated or missing Catalog
+	if(!complete)
+	{
+		// Notify User
+		log_text(LOG_LEVEL_ERROR, "%s: failed to read the Product Catalog (%s).", __func__, sqlite3_errmsg(db));
+		
+		// Free partial Catalog
+		release_catalog(catalog);
+		catalog = NULL;
+	}
+	
+	// End Read Transaction
+	sqlite3_exec(db, "COMMIT;", NULL, NULL, NULL);
+	
+	// Close Database
+	sqlite3_close(db);
+	
+	// Resolve Crosslink Chains
+	if(catalog != NULL)
+	{
+		// Resolve Chains
+		resolve_catalog_links(catalog);
+		
+		// Notify User
+		log_text(LOG_LEVEL_INFO, "Loaded %u Products (%u Crosslinks) into the Product Catalog.", catalog->count, catalog->crosslinks);
+	}
+	
+	// Return Catalog
+	return catalog;
+}
+
+/**
+ * Insert Product into Catalog under Construction
+ * @param catalog Catalog
+ * @param id Product Code String
+ * @return Catalog Entry (existing or new) or NULL for an invalid Product Code
+ */
+SceNetAdhocctlCatalogEntry * insert_catalog_entry(SceNetAdhocctlCatalog * catalog, const char * id)
+{
+	// Invalid Product Code
+	if(id == NULL || id[0] == 0) return NULL;
+	
+	// Padded Product Code
+	SceNetAdhocctlProductCode product;
+	strncpy(product.data, id, PRODUCT_CODE_LENGTH);
+	
+	// Linear Probing
+	uint32_t slot = hash_product_code(&product) & catalog->mask;
+	while(catalog->entry[slot].id.data[0] != 0)
+	{
+		// Existing Product
+		if(memcmp(catalog->entry[slot].id.data, product.data, PRODUCT_CODE_LENGTH) == 0) return &catalog->entry[slot];
+		
+		// Next Slot
+		slot = (slot + 1) & catalog->mask;
+	}
+	
+	// New Product (named after its Product Code until the Database says otherwise)
+	SceNetAdhocctlCatalogEntry * entry = &catalog->entry[slot];
+	entry->id = product;
+	strncpy(entry->name, id, PRODUCT_CODE_LENGTH);
+	catalog->count++;
+	
+	// Return Entry
+	return entry;
+}
+
+/**
+ * Resolve Crosslink Chains to their final Target
+ * @param catalog Catalog
+ */
+void resolve_catalog_links(SceNetAdhocctlCatalog * catalog)
+{
+	// Iterate Slots
+	uint32_t i = 0; for(; i <= catalog->mask; i++)
+	{
+		// Crosslinked Product
+		SceNetAdhocctlCatalogEntry * entry = &catalog->entry[i];
+		if(entry->id.data[0] == 0 || !entry->crosslinked) continue;
+		
+		// Follow Chain
+		SceNetAdhocctlProductCode target = entry->link;
+		int depth = 0;
+		const SceNetAdhocctlCatalogEntry * next = find_catalog_entry(catalog, &target);
+		while(next != NULL && next->crosslinked && depth < CATALOG_CROSSLINK_DEPTH)
+		{
+			target = next->link;
+			next = find_catalog_entry(catalog, &target);
+			depth++;
+		}
+		
+		// Crosslink Cycle (keep the direct Link)
+		if(next != NULL && next->crosslinked)
+		{
+			// Notify User
+			log_text(LOG_LEVEL_WARNING, "%s: Crosslink Cycle at %.9s, not following it.", __func__, entry->id.data);
+			
+			// Stop here
+			continue;
+		}
+		
+		// Link to Chain End
+		entry->link = target;
+	}
+}
+
+/**
+ * Publish Product Catalog (drops the Reference to the previous one)
+ * @param catalog Catalog (NULL to unpublish)
+ */
+void publish_catalog(SceNetAdhocctlCatalog * catalog)
+{
+	// Lock Catalog
+	pthread_mutex_lock(&_catalog_lock);
+	
+	// Swap Catalog
+	SceNetAdhocctlCatalog * old = _catalog;
+	_catalog = catalog;
+	
+	// Outdate cached References
+	__atomic_add_fetch(&_catalog_generation, 1, __ATOMIC_RELEASE);
+	
+	// Unlock Catalog
+	pthread_mutex_unlock(&_catalog_lock);
+	
+	// Release previous Catalog
+	release_catalog(old);
+	
+	// Refresh Display Names in the Status
+	update_status();
+}
+
+/**
+ * Unknown Product Writer Thread
+ * @param arg Unused
+ * @return NULL
+ */
+void * product_main(void * arg)
+{
+	// Database Handle
+	sqlite3 * db = NULL;
+	
+	// Prepared SQL Statement
+	sqlite3_stmt * statement = NULL;
+	
+	// SQL Statement
+	const char * sql = "INSERT OR IGNORE INTO productids(id, name) VALUES(?, ?);";
+	
+	// Open Database
+	if(sqlite3_open(_settings.database, &db) == SQLITE_OK)
+	{
+		// Wait for concurrent Catalog Reloads instead of failing
+		sqlite3_busy_timeout(db, 1000);
+		
+		// Prepare SQL Statement (once for all Batches)
+		if(sqlite3_prepare_v2(db, sql, strlen(sql) + 1, &statement, NULL) != SQLITE_OK) statement = NULL;
+	}
+	
+	// Database unavailable
+	if(statement == NULL) log_text(LOG_LEVEL_ERROR, "%s: can't write to %s, Unknown Products won't be saved.", __func__, _settings.database);
+	
+	// Batch Buffer (swapped with the Queue)
+	SceNetAdhocctlProductCode * batch = NULL;
+	uint32_t batchsize = 0;
+	
+	// Lock Queue
+	pthread_mutex_lock(&_product_lock);
+	
+	// Commit Batches until stopped and drained
+	while(1)
+	{
+		// Wait for Products
+		while(_product_queue_count == 0 && _product_running) pthread_cond_wait(&_product_cond, &_product_lock);
+		
+		// Stopped without queued Products
+		if(_product_queue_count == 0) break;
+		
+		// Take Queue
+		SceNetAdhocctlProductCode * product = _product_queue;
+		uint32_t count = _product_queue_count;
+		uint32_t size = _product_queue_size;
+		_product_queue = batch;
+		_product_queue_count = 0;
+		_product_queue_size = batchsize;
+		batch = product;
+		batchsize = size;
+		
+		// Unlock Queue
+		pthread_mutex_unlock(&_product_lock);
+		
+		// Commit Batch
+		if(statement != NULL) write_products(db, statement, batch, count);
+		
+		// Lock Queue
+		pthread_mutex_lock(&_product_lock);
+	}
+	
+	// Unlock Queue
+	pthread_mutex_unlock(&_product_lock);
+	
+	// Free Batch Buffer
+	free(batch);
+	
+	// Destroy Prepared SQL Statement
+	sqlite3_finalize(statement);
+	
+	// Close Database
+	sqlite3_close(db);
+	
+	// Exit Thread
+	return NULL;
+}
+
+/**
+ * Remember Unknown Product in the Deduplication Set (Queue Lock held)
+ * @param product Product Code
+ * @return 1 if the Product Code is new, 0 if it was seen before or -1 if out of Memory
+ */
+int remember_product(const SceNetAdhocctlProductCode * product)
+{
+	// Grow Set (keeps it at most half full)
+	if((_product_seen_count + 1) * 2 > _product_seen_size)
+	{
+		// New Capacity
+		uint32_t size = (_product_seen_size == 0) ? 64 : _product_seen_size * 2;
+		
+		// Allocate Set
+		SceNetAdhocctlProductCode * seen = (SceNetAdhocctlProductCode *)calloc(size, sizeof(SceNetAdhocctlProductCode));
+		
+		// Out of Memory
+		if(seen == NULL) return -1;
+		
+		// Rehash Product Codes
+		uint32_t i = 0; for(; i < _product_seen_size; i++)
+		{
+			// Empty Slot
+			if(_product_seen[i].data[0] == 0) continue;
+			
+			// Linear Probing
+			uint32_t slot = hash_product_code(&_product_seen[i]) & (size - 1);
+			while(seen[slot].data[0] != 0) slot = (slot + 1) & (size - 1);
+			
+			// Move Product Code
+			seen[slot] = _product_seen[i];
+		}
+		
+		// Replace Set
+		free(_product_seen);
+		_product_seen = seen;
+		_product_seen_size = size;
+	}
+	
+	// Linear Probing
+	uint32_t slot = hash_product_code((SceNetAdhocctlProductCode *)product) & (_product_seen_size - 1);
+	while(_product_seen[slot].data[0] != 0)
+	{
+		// Seen before
+		if(memcmp(_product_seen[slot].data, product->data, PRODUCT_CODE_LENGTH) == 0) return 0;
+		
+		// Next Slot
+		slot = (slot + 1) & (_product_seen_size - 1);
+	}
+	
+	// Remember Product Code
+	_product_seen[slot] = *product;
+	_product_seen_count++;
+	
+	// New Product Code
+	return 1;
+}
+
+/**
+ * Write Unknown Products in one Transaction
+ * @param db Database Handle
+ * @param statement Prepared INSERT Statement
+ * @param product Product Codes
+ * @param count Number of Product Codes
+ */
+void write_products(sqlite3 * db, sqlite3_stmt * statement, SceNetAdhocctlProductCode * product, uint32_t count)
+{
+	// Begin Transaction
+	if(sqlite3_exec(db, "BEGIN;", NULL, NULL, NULL) != SQLITE_OK)
+	{
+		// Notify User
+		log_text(LOG_LEVEL_ERROR, "%s: failed to begin Transaction, dropping %u Unknown Products.", __func__, count);
+		
+		// Stop here
+		return;
+	}
+	
+	// Iterate Product Codes
+	uint32_t i = 0; for(; i < count; i++)
+	{
+		// Safe Product Code
+		char productid[PRODUCT_CODE_LENGTH + 1];
+		strncpy(productid, product[i].data, PRODUCT_CODE_LENGTH);
+		productid[PRODUCT_CODE_LENGTH] = 0;
+		
+		// Bind SQL Statement Data
+		sqlite3_reset(statement);
+		if(sqlite3_bind_text(statement, 1, productid, strlen(productid), SQLITE_TRANSIENT) == SQLITE_OK && sqlite3_bind_text(statement, 2, productid, strlen(productid), SQLITE_TRANSIENT) == SQLITE_OK)
+		{
+			// Save Product ID to Database
+			if(sqlite3_step(statement) == SQLITE_DONE && sqlite3_changes(db) > 0)
+			{
+				// Log Addition
+				log_text(LOG_LEVEL_INFO, "Added Unknown Product ID %s to Database.", productid);
+			}
+		}
+	}
+	
+	// Release Bindings
+	sqlite3_reset(statement);
+	
+	// Commit Transaction
+	if(sqlite3_exec(db, "COMMIT;", NULL, NULL, NULL) != SQLITE_OK)
+	{
+		// Notify User
+		log_text(LOG_LEVEL_ERROR, "%s: failed to commit %u Unknown Products.", __func__, count);
+		
+		// Drop Transaction
+		sqlite3_exec(db, "ROLLBACK;", NULL, NULL, NULL);
+	}
+}
@@ -0,0 +1,120 @@
+/*
+ * This file is part of PRO ONLINE.
+
+ * PRO ONLINE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * PRO ONLINE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PRO ONLINE. If not, see <http://www.gnu.org/licenses/ .
+ */
+#ifndef _CATALOG_H_
+#define _CATALOG_H_
+
+#include <stdint.h>
+#include <signal.h>
+#include <packets.h>
+
+// Product Catalog Entry
+typedef struct
+{
+	// Product Code (empty Slot if the first Byte is NUL)
+	SceNetAdhocctlProductCode id;
+	
+	// Crosslink Target (End of the Crosslink Chain)
+	SceNetAdhocctlProductCode link;
+	
+	// Crosslinked Flag
+	uint32_t crosslinked;
+	
+	// Display Name (Product Code if unnamed)
+	char name[128];
+} SceNetAdhocctlCatalogEntry;
+
+// Product Catalog (immutable Open-Addressing Table, replaced as a Whole on Reload)
+typedef struct
+{
+	// Reference Count (the published Catalog holds one Reference)
+	uint32_t refcount;
+	
+	// Slot Mask (Slot Count - 1)
+	uint32_t mask;
+	
+	// Product Count
+	uint32_t count;
+	
+	// Crosslink Count
+	uint32_t crosslinks;
+	
+	// Slots
+	SceNetAdhocctlCatalogEntry * entry;
+} SceNetAdhocctlCatalog;
+
+// Catalog Reload Request (set by SIGHUP)
+extern volatile sig_atomic_t _catalog_reload;
+
+/**
+ * Load Product Catalog from the Database (blocking, used at Startup)
+ * @return 0 on Success or -1 if the Database couldn't be read
+ */
+int load_catalog(void);
+
+/**
+ * Reload Product Catalog in the Background (the old Catalog stays in use until the new one is ready)
+ */
+void reload_catalog(void);
+
+/**
+ * Free Product Catalog (waits for a running Reload)
+ */
+void free_catalog(void);
+
+/**
+ * Acquire Reference to the current Product Catalog (lock-free while the Thread's cached Reference is current)
+ * @return Catalog or NULL if none is loaded
+ */
+SceNetAdhocctlCatalog * acquire_catalog(void);
+
+/**
+ * Drop the cached Catalog Reference of the calling Thread (call before the Thread exits)
+ */
+void drop_catalog_cache(void);
+
+/**
+ * Release Product Catalog Reference
+ * @param catalog Catalog (NULL is ignored)
+ */
+void release_catalog(SceNetAdhocctlCatalog * catalog);
+
+/**
+ * Start Unknown Product Writer Thread
+ * @return 0 on Success or -1 on Error
+ */
+int start_product_writer(void);
+
+/**
+ * Stop Unknown Product Writer Thread (commits the queued Products first)
+ */
+void stop_product_writer(void);
+
+/**
+ * Queue Unknown Product for the Database (each Product Code gets written once)
+ * @param product Product Code
+ */
+void queue_unknown_product(const SceNetAdhocctlProductCode * product);
+
+/**
+ * Find Product in Catalog
+ * @param catalog Catalog (NULL is treated as empty)
+ * @param product Product Code
+ * @return Catalog Entry or NULL
+ */
+const SceNetAdhocctlCatalogEntry * find_catalog_entry(SceNetAdhocctlCatalog * catalog, const SceNetAdhocctlProductCode * product);
+
+#endif
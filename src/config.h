@@ -20,24 +20,96 @@
 
 #include <time.h>
 
-// Server Listening Port
+// Server Config File (optional, "key = value" Lines named like the long Command Line Options)
+#define SERVER_CONFIG_FILE "adhocserver.conf"
+
+// Default Server Listening Port (--port)
 #define SERVER_PORT 27312
 
-// Listener Connection Backlog (aka. Max Concurrent Logins)
+// Default Listener Connection Backlog (aka. Max Concurrent Logins, --backlog)
 #define SERVER_LISTEN_BACKLOG 128
 
-// Server User Maximum
+// Default Server User Maximum (--users, sizes the Node Pools and Hash Indexes at Startup)
 #define SERVER_USER_MAXIMUM 1024
 
-// Server User Timeout (in seconds)
+// Server Game Hash Buckets per Thread (Power of 2)
+#define SERVER_GAME_HASH_BUCKETS 1024
+
+// Default Server User Timeout (in seconds, --timeout)
 #define SERVER_USER_TIMEOUT 15
 
-// Server SQLite3 Database
+// Server User TX Queue Limit (in bytes, Users falling further behind get dropped)
+#define SERVER_USER_TXBUF_MAXIMUM 65536
+
+// Default Server Worker Threads (--workers, Games get sharded across them by Product Code, 0 keeps everything on one Thread)
+#define SERVER_WORKER_THREADS 0
+
+// Default Server HTTP Port for Metrics & Status JSON (--http-port, 0 disables it)
+#define SERVER_HTTP_PORT 27313
+
+// Default Server HTTP Address (--http-address, Loopback keeps Metrics & Status JSON off the Network, 0.0.0.0 serves every Interface)
+#define SERVER_HTTP_ADDRESS "127.0.0.1"
+
+// Server HTTP Clients (served at the same Time, further ones get refused)
+#define SERVER_HTTP_CLIENTS 16
+
+// Server HTTP Request Header Limit (in bytes)
+#define SERVER_HTTP_REQUEST 2048
+
+// Server HTTP Client Timeout (in seconds)
+#define SERVER_HTTP_TIMEOUT 5
+
+// Default Server Membership Feed Port (--feed-port, Snapshot + Event Lines with every Player's Nickname & MAC, 0 disables it)
+#define SERVER_FEED_PORT 0
+
+// Default Server Membership Feed Address (--feed-address, the Feed has no Authentication, so keep it on Loopback unless the Network is trusted)
+#define SERVER_FEED_ADDRESS "127.0.0.1"
+
+// Server Membership Feed Subscribers (served at the same Time, further ones get refused)
+#define SERVER_FEED_SUBSCRIBERS 16
+
+// Server Membership Feed Backlog (in bytes, Subscribers falling further behind get dropped)
+#define SERVER_FEED_BACKLOG 1048576
+
+// Default Server Traffic Trace (--trace, records framed C2S Packets per Connection for tools/replay, empty disables it)
+#define SERVER_TRACE_FILE ""
+
+// Server Traffic Trace Backlog (in bytes, Records beyond it get dropped while the Disk falls behind)
+#define SERVER_TRACE_BACKLOG 67108864
+
+// Server Event Batch (Events handled per Event Poll Wakeup)
+#define SERVER_EVENT_BATCH 256
+
+// Default Server I/O Backend (--uring, 1 moves User Sockets to io_uring where the Kernel supports it, 0 keeps them on epoll)
+#define SERVER_IO_URING 0
+
+// Server I/O Ring Submission Queue Entries (per Thread, the Completion Queue holds four times as many)
+#define SERVER_URING_ENTRIES 1024
+
+// Server I/O Ring Receive Buffers (per Thread, must be a Power of Two)
+#define SERVER_URING_BUFFERS 1024
+
+// Server I/O Ring Receive Buffer Size (in bytes)
+#define SERVER_URING_BUFFER_SIZE 1024
+
+// Default Server SQLite3 Database (--database)
 #define SERVER_DATABASE "database.db"
 
-// Server Status Logfile
+// Default Server Status Logfile (--status)
 #define SERVER_STATUS_XMLOUT "www/status.xml"
 
+// Default Server Status Interval (--status-interval, Minimum Milliseconds between Logfile Rewrites and status.json Recaptures)
+#define SERVER_STATUS_INTERVAL 1000
+
+// Server Log Level (LOG_LEVEL_DEBUG adds Scans and Chat Messages, disabled Levels compile away)
+#define SERVER_LOG_LEVEL LOG_LEVEL_INFO
+
+// Server Log Format (0 for Text Lines, 1 for JSON Lines)
+#define SERVER_LOG_JSON 0
+
+// Server Log Ring (Records buffered for the Log Thread, Power of 2, Overflow gets dropped)
+#define SERVER_LOG_RING 4096
+
 // Server Shutdown Message
 #define SERVER_SHUTDOWN_MESSAGE "PROMETHEUS HUB IS SHUTTING DOWN!"
 
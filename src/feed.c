@@ -0,0 +1,1040 @@
+/*
+ * This file is part of PRO ONLINE.
+
+ * PRO ONLINE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * PRO ONLINE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PRO ONLINE. If not, see <http://www.gnu.org/licenses/ .
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <config.h>
+#include <http.h>
+#include <loop.h>
+#include <log.h>
+#include <feed.h>
+
+// Mirrored User (what the Feed knows about a logged-in User)
+typedef struct SceNetAdhocctlFeedUser {
+	// Next Element (Hash Bucket)
+	struct SceNetAdhocctlFeedUser * hash_next;
+	
+	// User IP Address
+	uint32_t ip;
+	
+	// User MAC Address
+	SceNetEtherAddr mac;
+	
+	// User Nickname
+	SceNetAdhocctlNickname name;
+	
+	// Game Product Code
+	SceNetAdhocctlProductCode game;
+	
+	// Group Name (valid if grouped)
+	SceNetAdhocctlGroupName group;
+	int grouped;
+} SceNetAdhocctlFeedUser;
+
+// Mirrored Group (Player Count per Game & Group Name)
+typedef struct SceNetAdhocctlFeedGroup {
+	// Next Element (Hash Bucket)
+	struct SceNetAdhocctlFeedGroup * hash_next;
+	
+	// Game Product Code
+	SceNetAdhocctlProductCode game;
+	
+	// Group Name
+	SceNetAdhocctlGroupName group;
+	
+	// Number of Players
+	uint32_t playercount;
+} SceNetAdhocctlFeedGroup;
+
+// Feed Subscriber
+typedef struct
+{
+	// TCP Socket (-1 for free Slots)
+	int stream;
+	
+	// Unsent Lines (starting at outpos)
+	SceNetAdhocctlHttpBuffer out;
+	uint32_t outpos;
+	
+	// End of the queued Snapshot (the Backlog Limit only covers the Deltas behind it)
+	uint32_t snapshotend;
+} SceNetAdhocctlFeedSubscriber;
+
+// Feed Thread running
+int _feed_running = 0;
+
+// Feed Thread
+static pthread_t _feed_thread;
+
+// Feed Listening Socket
+static int _feed_server = -1;
+
+// Feed Thread Wakeup (signalled when the Queue fills up and by the Stop Request)
+static int _feed_wakeup = -1;
+
+// Feed Queue (filled by the Loop Threads, swapped out by the Feed Thread)
+static pthread_mutex_t _feed_lock = PTHREAD_MUTEX_INITIALIZER;
+static SceNetAdhocctlFeedEvent * _feed_queue = NULL;
+static uint32_t _feed_queue_count = 0;
+static uint32_t _feed_queue_size = 0;
+
+// Mirrored Users & Groups (Feed Thread only)
+static SceNetAdhocctlFeedUser ** _feed_user = NULL;
+static uint32_t _feed_user_count = 0;
+static SceNetAdhocctlFeedGroup ** _feed_group = NULL;
+
+// Subscribers (Feed Thread only)
+static SceNetAdhocctlFeedSubscriber _feed_subscriber[SERVER_FEED_SUBSCRIBERS];
+
+// Last Event Sequence Number (Feed Thread only)
+static uint64_t _feed_sequence = 0;
+
+// Encoded Event Line (Feed Thread only, reused across Events)
+static SceNetAdhocctlHttpBuffer _feed_line;
+
+// Event Names
+static const char * _feed_event_name[] = { "login", "logout", "join", "leave", "group_create", "group_destroy" };
+
+// Function Prototypes
+void * feed_main(void * arg);
+void wake_feed(void);
+void drain_feed_queue(void);
+void apply_feed_event(SceNetAdhocctlFeedEvent * event);
+SceNetAdhocctlFeedUser ** find_feed_user(uint32_t ip);
+SceNetAdhocctlFeedGroup ** find_feed_group(SceNetAdhocctlProductCode * game, SceNetAdhocctlGroupName * group);
+void leave_feed_group(SceNetAdhocctlFeedUser * user);
+void broadcast_feed_event(int event, SceNetAdhocctlProductCode * game, SceNetAdhocctlGroupName * group, SceNetAdhocctlFeedUser * user);
+void write_feed_user(SceNetAdhocctlHttpBuffer * out, SceNetAdhocctlFeedUser * user);
+void write_feed_snapshot(SceNetAdhocctlHttpBuffer * out);
+int compare_feed_users(const void * a, const void * b);
+void accept_feed_subscribers(int epoll);
+void receive_feed_subscriber(SceNetAdhocctlFeedSubscriber * subscriber);
+void flush_feed_subscriber(SceNetAdhocctlFeedSubscriber * subscriber);
+void close_feed_subscriber(SceNetAdhocctlFeedSubscriber * subscriber);
+
+/**
+ * Start Feed Thread (serves Snapshot + Deltas to Subscribers)
+ * @param server Feed Listening Socket (owned by the Feed Thread from now on)
+ * @return 0 on Success or -1 on Error
+ */
+int start_feed(int server)
+{
+	// Free Subscriber Slots
+	uint32_t i = 0; for(; i < SERVER_FEED_SUBSCRIBERS; i++) _feed_subscriber[i].stream = -1;
+	
+	// Save Listening Socket
+	_feed_server = server;
+	
+	// Allocate Mirror Hash Indexes (sized like the User Index)
+	_feed_user = (SceNetAdhocctlFeedUser **)calloc(_db_user_buckets, sizeof(SceNetAdhocctlFeedUser *));
+	_feed_group = (SceNetAdhocctlFeedGroup **)calloc(_db_user_buckets, sizeof(SceNetAdhocctlFeedGroup *));
+	
+	// Out of Memory
+	if(_feed_user == NULL || _feed_group == NULL)
+	{
+		// Notify User
+		log_text(LOG_LEVEL_ERROR, "%s: out of memory for the Feed Mirror.", __func__);
+		
+		// Free Mirror Hash Indexes
+		free(_feed_user);
+		free(_feed_group);
+		_feed_user = NULL;
+		_feed_group = NULL;
+		
+		// Close Listening Socket
+		close(_feed_server);
+		_feed_server = -1;
+		
+		// Return Error
+		return -1;
+	}
+	
+	// Create Wakeup Event
+	_feed_wakeup = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if(_feed_wakeup == -1)
+	{
+		// Notify User
+		log_text(LOG_LEVEL_ERROR, "%s: failed to create Feed Wakeup Event.", __func__);
+		
+		// Free Mirror Hash Indexes
+		free(_feed_user);
+		free(_feed_group);
+		_feed_user = NULL;
+		_feed_group = NULL;
+		
+		// Close Listening Socket
+		close(_feed_server);
+		_feed_server = -1;
+		
+		// Return Error
+		return -1;
+	}
+	
+	// Keep Signals on the Acceptor Thread
+	sigset_t mask, oldmask;
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGINT);
+	sigaddset(&mask, SIGTERM);
+	sigaddset(&mask, SIGHUP);
+	pthread_sigmask(SIG_BLOCK, &mask, &oldmask);
+	
+	// Create Feed Thread
+	__atomic_store_n(&_feed_running, 1, __ATOMIC_RELEASE);
+	int result = pthread_create(&_feed_thread, NULL, feed_main, NULL);
+	
+	// Restore Signal Mask
+	pthread_sigmask(SIG_SETMASK, &oldmask, NULL);
+	
+	// Failed to create Feed Thread
+	if(result != 0)
+	{
+		// Notify User
+		log_text(LOG_LEVEL_ERROR, "%s: failed to create Feed Thread.", __func__);
+		
+		// Not running
+		__atomic_store_n(&_feed_running, 0, __ATOMIC_RELEASE);
+		
+		// Free Mirror Hash Indexes
+		free(_feed_user);
+		free(_feed_group);
+		_feed_user = NULL;
+		_feed_group = NULL;
+		
+		// Close Event Sources
+		close(_feed_wakeup);
+		_feed_wakeup = -1;
+		close(_feed_server);
+		_feed_server = -1;
+		
+		// Return Error
+		return -1;
+	}
+	
+	// Return Success
+	return 0;
+}
+
+/**
+ * Stop Feed Thread (sends the queued Events first)
+ */
+void stop_feed(void)
+{
+	// Feed not running
+	if(!__atomic_load_n(&_feed_running, __ATOMIC_ACQUIRE)) return;
+	
+	// Stop Producers & Feed Thread (it drains the Queue once more)
+	pthread_mutex_lock(&_feed_lock);
+	__atomic_store_n(&_feed_running, 0, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&_feed_lock);
+	
+	// Wake Feed Thread
+	wake_feed();
+	
+	// Wait for Feed Thread
+	pthread_join(_feed_thread, NULL);
+	
+	// Close Wakeup Event
+	close(_feed_wakeup);
+	_feed_wakeup = -1;
+	
+	// Free Queue
+	free(_feed_queue);
+	_feed_queue = NULL;
+	_feed_queue_count = 0;
+	_feed_queue_size = 0;
+	
+	// Free Mirror Hash Indexes (emptied by the Feed Thread)
+	free(_feed_user);
+	free(_feed_group);
+	_feed_user = NULL;
+	_feed_group = NULL;
+}
+
+/**
+ * Queue Feed Event (use feed_user)
+ * @param event Feed Event
+ * @param user User Node (logged in, Group set for Join & Leave)
+ */
+void queue_feed_event(int event, SceNetAdhocctlUserNode * user)
+{
+	// Lock Queue
+	pthread_mutex_lock(&_feed_lock);
+	
+	// Feed still running
+	if(__atomic_load_n(&_feed_running, __ATOMIC_ACQUIRE))
+	{
+		// Grow Queue
+		if(_feed_queue_count == _feed_queue_size)
+		{
+			// New Capacity
+			uint32_t size = (_feed_queue_size == 0) ? 64 : _feed_queue_size * 2;
+			
+			// Resize Queue
+			SceNetAdhocctlFeedEvent * queue = (SceNetAdhocctlFeedEvent *)realloc(_feed_queue, size * sizeof(SceNetAdhocctlFeedEvent));
+			
+			// Save Queue
+			if(queue != NULL)
+			{
+				_feed_queue = queue;
+				_feed_queue_size = size;
+			}
+		}
+		
+		// Enqueue Event (dropped if out of Memory)
+		if(_feed_queue_count < _feed_queue_size)
+		{
+			// Copy Event
+			SceNetAdhocctlFeedEvent * record = &_feed_queue[_feed_queue_count++];
+			memset(record, 0, sizeof(*record));
+			record->event = event;
+			record->ip = user->info->resolver.ip;
+			record->mac = user->info->resolver.mac;
+			record->name = user->info->resolver.name;
+			record->game = user->game->game;
+			if(user->group != NULL) record->group = user->group->group;
+			
+			// Wake Feed Thread (once per Drain, later Events find it awake)
+			if(_feed_queue_count == 1) wake_feed();
+		}
+	}
+	
+	// Unlock Queue
+	pthread_mutex_unlock(&_feed_lock);
+}
+
+/**
+ * Feed Thread (applies queued Events to the Mirror and sends them to the Subscribers)
+ * @param arg Unused
+ * @return NULL
+ */
+void * feed_main(void * arg)
+{
+	// Create Event Poll
+	int epoll = epoll_create1(0);
+	
+	// Watch Listening Socket
+	if(epoll != -1)
+	{
+		struct epoll_event event;
+		memset(&event, 0, sizeof(event));
+		event.events = EPOLLIN;
+		event.data.ptr = &_feed_server;
+		epoll_ctl(epoll, EPOLL_CTL_ADD, _feed_server, &event);
+		
+		// Watch Wakeup Event
+		event.data.ptr = &_feed_wakeup;
+		epoll_ctl(epoll, EPOLL_CTL_ADD, _feed_wakeup, &event);
+	}
+	
+	// Notify User (Events still get mirrored, so a later Restart isn't needed)
+	else log_text(LOG_LEVEL_ERROR, "%s: epoll_create1 returned %d.", __func__, epoll);
+	
+	// Serve until stopped and drained
+	while(1)
+	{
+		// Running Flag (read before draining, so the last Drain gets everything)
+		int running = __atomic_load_n(&_feed_running, __ATOMIC_ACQUIRE);
+		
+		// Wait for Socket Events or queued Events
+		struct epoll_event events[16];
+		int count = (epoll != -1) ? epoll_wait(epoll, events, 16, running ? -1 : 0) : 0;
+		
+		// Wait for queued Events without Event Poll
+		if(epoll == -1 && running)
+		{
+			struct pollfd wakeup = { _feed_wakeup, POLLIN, 0 };
+			poll(&wakeup, 1, -1);
+		}
+		
+		// Reset Wakeup Event (the Drain below picks up everything queued so far)
+		uint64_t wakeups = 0;
+		read(_feed_wakeup, &wakeups, sizeof(wakeups));
+		
+		// Iterate Ready Events
+		int i = 0; for(; i < count; i++)
+		{
+			// Queued Events (applied below)
+			if(events[i].data.ptr == &_feed_wakeup) continue;
+			
+			// New Subscribers
+			if(events[i].data.ptr == &_feed_server) accept_feed_subscribers(epoll);
+			
+			// Subscriber Socket
+			else
+			{
+				// Subscriber
+				SceNetAdhocctlFeedSubscriber * subscriber = (SceNetAdhocctlFeedSubscriber *)events[i].data.ptr;
+				
+				// Hangup, Error or Input (Subscribers don't talk, Input is discarded)
+				if(events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) receive_feed_subscriber(subscriber);
+				
+				// Socket became writable
+				if(events[i].events & EPOLLOUT) flush_feed_subscriber(subscriber);
+			}
+		}
+		
+		// Apply queued Events
+		drain_feed_queue();
+		
+		// Send queued Lines
+		for(i = 0; i < SERVER_FEED_SUBSCRIBERS; i++) flush_feed_subscriber(&_feed_subscriber[i]);
+		
+		// Stopped and drained
+		if(!running) break;
+	}
+	
+	// Close Subscribers
+	uint32_t i = 0; for(; i < SERVER_FEED_SUBSCRIBERS; i++) close_feed_subscriber(&_feed_subscriber[i]);
+	
+	// Free Mirror
+	for(i = 0; i < _db_user_buckets; i++)
+	{
+		// Free Users
+		while(_feed_user[i] != NULL)
+		{
+			SceNetAdhocctlFeedUser * user = _feed_user[i];
+			_feed_user[i] = user->hash_next;
+			free(user);
+		}
+		
+		// Free Groups
+		while(_feed_group[i] != NULL)
+		{
+			SceNetAdhocctlFeedGroup * group = _feed_group[i];
+			_feed_group[i] = group->hash_next;
+			free(group);
+		}
+	}
+	_feed_user_count = 0;
+	
+	// Free Line Buffer
+	free(_feed_line.data);
+	memset(&_feed_line, 0, sizeof(_feed_line));
+	
+	// Close Event Sources
+	if(epoll != -1) close(epoll);
+	close(_feed_server);
+	_feed_server = -1;
+	
+	// Exit Thread
+	return NULL;
+}
+
+/**
+ * Wake Feed Thread
+ */
+void wake_feed(void)
+{
+	// Signal Wakeup Event
+	uint64_t event = 1;
+	write(_feed_wakeup, &event, sizeof(event));
+}
+
+/**
+ * Apply queued Events (swaps the Queue out, so Producers never wait for the Subscribers)
+ */
+void drain_feed_queue(void)
+{
+	// Swapped-out Queue (Feed Thread only, reused across Drains)
+	static SceNetAdhocctlFeedEvent * queue = NULL;
+	static uint32_t size = 0;
+	
+	// Lock Queue
+	pthread_mutex_lock(&_feed_lock);
+	
+	// Swap Queues
+	SceNetAdhocctlFeedEvent * events = _feed_queue;
+	uint32_t count = _feed_queue_count;
+	uint32_t eventsize = _feed_queue_size;
+	_feed_queue = queue;
+	_feed_queue_size = size;
+	_feed_queue_count = 0;
+	queue = events;
+	size = eventsize;
+	
+	// Unlock Queue
+	pthread_mutex_unlock(&_feed_lock);
+	
+	// Apply Events
+	uint32_t i = 0; for(; i < count; i++) apply_feed_event(&queue[i]);
+	
+	// Free swapped-out Queue on Shutdown
+	if(!__atomic_load_n(&_feed_running, __ATOMIC_ACQUIRE))
+	{
+		free(queue);
+		queue = NULL;
+		size = 0;
+	}
+}
+
+/**
+ * Apply Event to the Mirror and broadcast it
+ * @param event Feed Event
+ */
+void apply_feed_event(SceNetAdhocctlFeedEvent * event)
+{
+	// Mirrored User
+	SceNetAdhocctlFeedUser ** link = find_feed_user(event->ip);
+	SceNetAdhocctlFeedUser * user = *link;
+	
+	// Login
+	if(event->event == FEED_EVENT_LOGIN)
+	{
+		// Allocate User (cleared)
+		if(user == NULL)
+		{
+			// Allocate Memory
+			user = (SceNetAdhocctlFeedUser *)calloc(1, sizeof(SceNetAdhocctlFeedUser));
+			
+			// Out of Memory (the User stays invisible to the Feed)
+			if(user == NULL) return;
+			
+			// Link into Hash Bucket
+			user->hash_next = *link;
+			*link = user;
+			_feed_user_count++;
+		}
+		
+		// Stale User with the same IP (missed its Logout)
+		else if(user->grouped) leave_feed_group(user);
+		
+		// Copy Identity
+		user->ip = event->ip;
+		user->mac = event->mac;
+		user->name = event->name;
+		user->game = event->game;
+		
+		// Broadcast Login
+		broadcast_feed_event(FEED_EVENT_LOGIN, &user->game, NULL, user);
+	}
+	
+	// Logout
+	else if(event->event == FEED_EVENT_LOGOUT && user != NULL)
+	{
+		// Leave Group first (if its Leave went missing)
+		if(user->grouped) leave_feed_group(user);
+		
+		// Broadcast Logout
+		broadcast_feed_event(FEED_EVENT_LOGOUT, &user->game, NULL, user);
+		
+		// Unlink & Free User
+		*link = user->hash_next;
+		_feed_user_count--;
+		free(user);
+	}
+	
+	// Join
+	else if(event->event == FEED_EVENT_JOIN && user != NULL)
+	{
+		// Leave previous Group first (if its Leave went missing)
+		if(user->grouped) leave_feed_group(user);
+		
+		// Find Group
+		SceNetAdhocctlFeedGroup ** grouplink = find_feed_group(&user->game, &event->group);
+		SceNetAdhocctlFeedGroup * group = *grouplink;
+		
+		// New Group
+		if(group == NULL)
+		{
+			// Allocate Group (cleared)
+			group = (SceNetAdhocctlFeedGroup *)calloc(1, sizeof(SceNetAdhocctlFeedGroup));
+			
+			// Out of Memory (the Join stays invisible to the Feed)
+			if(group == NULL) return;
+			
+			// Copy Names
+			group->game = user->game;
+			group->group = event->group;
+			
+			// Link into Hash Bucket
+			group->hash_next = *grouplink;
+			*grouplink = group;
+			
+			// Broadcast Group Creation
+			broadcast_feed_event(FEED_EVENT_GROUP_CREATE, &group->game, &group->group, NULL);
+		}
+		
+		// Join Group
+		group->playercount++;
+		user->group = event->group;
+		user->grouped = 1;
+		
+		// Broadcast Join
+		broadcast_feed_event(FEED_EVENT_JOIN, &user->game, &user->group, user);
+	}
+	
+	// Leave
+	else if(event->event == FEED_EVENT_LEAVE && user != NULL && user->grouped) leave_feed_group(user);
+}
+
+/**
+ * Find mirrored User
+ * @param ip User IP Address
+ * @return Link to the User (points to NULL if missing)
+ */
+SceNetAdhocctlFeedUser ** find_feed_user(uint32_t ip)
+{
+	// Iterate Hash Bucket
+	SceNetAdhocctlFeedUser ** link = &_feed_user[hash_ip(ip) & (_db_user_buckets - 1)];
+	while(*link != NULL && (*link)->ip != ip) link = &(*link)->hash_next;
+	
+	// Return Link
+	return link;
+}
+
+/**
+ * Find mirrored Group
+ * @param game Game Product Code
+ * @param group Group Name
+ * @return Link to the Group (points to NULL if missing)
+ */
+SceNetAdhocctlFeedGroup ** find_feed_group(SceNetAdhocctlProductCode * game, SceNetAdhocctlGroupName * group)
+{
+	// Iterate Hash Bucket
+	SceNetAdhocctlFeedGroup ** link = &_feed_group[(hash_product_code(game) ^ hash_group_name(group)) & (_db_user_buckets - 1)];
+	while(*link != NULL && (memcmp((*link)->game.data, game->data, PRODUCT_CODE_LENGTH) != 0 || strncmp((char *)(*link)->group.data, (char *)group->data, ADHOCCTL_GROUPNAME_LEN) != 0)) link = &(*link)->hash_next;
+	
+	// Return Link
+	return link;
+}
+
+/**
+ * Remove mirrored User from its Group (broadcasts the Leave and an empty Group's Destruction)
+ * @param user Mirrored User
+ */
+void leave_feed_group(SceNetAdhocctlFeedUser * user)
+{
+	// Leave Group
+	user->grouped = 0;
+	
+	// Broadcast Leave
+	broadcast_feed_event(FEED_EVENT_LEAVE, &user->game, &user->group, user);
+	
+	// Find Group
+	SceNetAdhocctlFeedGroup ** link = find_feed_group(&user->game, &user->group);
+	SceNetAdhocctlFeedGroup * group = *link;
+	
+	// Last Player left
+	if(group != NULL && --group->playercount == 0)
+	{
+		// Broadcast Group Destruction
+		broadcast_feed_event(FEED_EVENT_GROUP_DESTROY, &group->game, &group->group, NULL);
+		
+		// Unlink & Free Group
+		*link = group->hash_next;
+		free(group);
+	}
+}
+
+/**
+ * Encode Event Line once and queue it for every Subscriber
+ * @param event Feed Event
+ * @param game Game Product Code
+ * @param group Group Name (NULL if none)
+ * @param user Mirrored User (NULL for Group Events)
+ */
+void broadcast_feed_event(int event, SceNetAdhocctlProductCode * game, SceNetAdhocctlGroupName * group, SceNetAdhocctlFeedUser * user)
+{
+	// Reset Line
+	SceNetAdhocctlHttpBuffer * line = &_feed_line;
+	line->len = 0;
+	line->failed = 0;
+	
+	// Safe Product ID
+	char productid[PRODUCT_CODE_LENGTH + 1];
+	strncpy(productid, game->data, PRODUCT_CODE_LENGTH);
+	productid[PRODUCT_CODE_LENGTH] = 0;
+	
+	// Escaped Text
+	char escaped[6 * 64 + 1];
+	
+	// Sequence Number, Event & Game
+	append_http(line, "{\"seq\":%llu,\"event\":\"%s\",\"game\":\"%s\"", (unsigned long long)++_feed_sequence, _feed_event_name[event], strcpyjson(escaped, productid, sizeof(escaped)));
+	
+	// Group
+	if(group != NULL)
+	{
+		// Safe Group Name
+		char groupname[ADHOCCTL_GROUPNAME_LEN + 1];
+		strncpy(groupname, (const char *)group->data, ADHOCCTL_GROUPNAME_LEN);
+		groupname[ADHOCCTL_GROUPNAME_LEN] = 0;
+		
+		// Write Group
+		append_http(line, ",\"group\":\"%s\"", strcpyjson(escaped, groupname, sizeof(escaped)));
+	}
+	
+	// User
+	if(user != NULL)
+	{
+		// Write User
+		append_http(line, ",\"user\":");
+		write_feed_user(line, user);
+	}
+	
+	// End Line
+	append_http(line, "}\n");
+	
+	// Out of Memory (the Line is lost for everyone, like a dropped Log Record)
+	if(line->failed) return;
+	
+	// Queue Line for Subscribers
+	uint32_t i = 0; for(; i < SERVER_FEED_SUBSCRIBERS; i++)
+	{
+		// Subscriber
+		SceNetAdhocctlFeedSubscriber * subscriber = &_feed_subscriber[i];
+		
+		// Free Slot
+		if(subscriber->stream == -1) continue;
+		
+		// Unsent Deltas (the Snapshot scales with the User Count and doesn't count)
+		uint32_t behind = subscriber->out.len - ((subscriber->outpos > subscriber->snapshotend) ? subscriber->outpos : subscriber->snapshotend);
+		
+		// Subscriber fell too far behind (dropped instead of slowing anyone down)
+		if(behind + line->len > SERVER_FEED_BACKLOG)
+		{
+			// Notify User
+			log_text(LOG_LEVEL_WARNING, "Dropping Feed Subscriber (fell %u bytes behind).", behind);
+			
+			// Close Subscriber
+			close_feed_subscriber(subscriber);
+			
+			// Next Subscriber
+			continue;
+		}
+		
+		// Queue Line
+		append_http(&subscriber->out, "%s", line->data);
+		
+		// Out of Memory
+		if(subscriber->out.failed) close_feed_subscriber(subscriber);
+	}
+}
+
+/**
+ * Write mirrored User as JSON Object
+ * @param out Output Buffer
+ * @param user Mirrored User
+ */
+void write_feed_user(SceNetAdhocctlHttpBuffer * out, SceNetAdhocctlFeedUser * user)
+{
+	// Safe Username
+	char username[ADHOCCTL_NICKNAME_LEN + 1];
+	strncpy(username, (const char *)user->name.data, ADHOCCTL_NICKNAME_LEN);
+	username[ADHOCCTL_NICKNAME_LEN] = 0;
+	
+	// Escaped Username
+	char escaped[6 * ADHOCCTL_NICKNAME_LEN + 1];
+	
+	// Write MAC & Name
+	append_http(out, "{\"mac\":\"%02X:%02X:%02X:%02X:%02X:%02X\",\"name\":\"%s\"}", user->mac.data[0], user->mac.data[1], user->mac.data[2], user->mac.data[3], user->mac.data[4], user->mac.data[5], strcpyjson(escaped, username, sizeof(escaped)));
+}
+
+/**
+ * Write Snapshot Line (Game -> Group -> User Tree at the current Sequence Number)
+ * @param out Output Buffer
+ */
+void write_feed_snapshot(SceNetAdhocctlHttpBuffer * out)
+{
+	// Sorted Users (Game, then Groups, then the Groupless)
+	SceNetAdhocctlFeedUser ** users = (SceNetAdhocctlFeedUser **)malloc((_feed_user_count > 0 ? _feed_user_count : 1) * sizeof(SceNetAdhocctlFeedUser *));
+	
+	// Out of Memory
+	if(users == NULL)
+	{
+		// Mark Buffer
+		out->failed = 1;
+		
+		// Stop here
+		return;
+	}
+	
+	// Collect Users
+	uint32_t count = 0;
+	uint32_t i = 0; for(; i < _db_user_buckets; i++)
+	{
+		SceNetAdhocctlFeedUser * user = _feed_user[i];
+		for(; user != NULL; user = user->hash_next) users[count++] = user;
+	}
+	
+	// Sort Users
+	qsort(users, count, sizeof(SceNetAdhocctlFeedUser *), compare_feed_users);
+	
+	// Snapshot Header
+	append_http(out, "{\"seq\":%llu,\"event\":\"snapshot\",\"games\":[", (unsigned long long)_feed_sequence);
+	
+	// Iterate Users
+	for(i = 0; i < count; i++)
+	{
+		// User & Predecessor
+		SceNetAdhocctlFeedUser * user = users[i];
+		SceNetAdhocctlFeedUser * prev = (i > 0) ? users[i - 1] : NULL;
+		
+		// New Game
+		int newgame = (prev == NULL || memcmp(prev->game.data, user->game.data, PRODUCT_CODE_LENGTH) != 0);
+		
+		// New Group (or the Groupless Tail of the Game)
+		int newgroup = newgame || prev->grouped != user->grouped || (user->grouped && strncmp((char *)prev->group.data, (char *)user->group.data, ADHOCCTL_GROUPNAME_LEN) != 0);
+		
+		// Close previous Group & Game
+		if(prev != NULL && newgroup) append_http(out, prev->grouped ? "]}" : "]");
+		if(prev != NULL && newgame) append_http(out, prev->grouped ? "],\"groupless\":[]}," : "}," );
+		
+		// Open Game
+		if(newgame)
+		{
+			// Safe Product ID
+			char productid[PRODUCT_CODE_LENGTH + 1];
+			strncpy(productid, user->game.data, PRODUCT_CODE_LENGTH);
+			productid[PRODUCT_CODE_LENGTH] = 0;
+			
+			// Escaped Product ID
+			char escaped[6 * PRODUCT_CODE_LENGTH + 1];
+			
+			// Write Game
+			append_http(out, "{\"game\":\"%s\",\"groups\":[", strcpyjson(escaped, productid, sizeof(escaped)));
+		}
+		
+		// Open Group
+		if(newgroup)
+		{
+			// Grouped Users
+			if(user->grouped)
+			{
+				// Safe Group Name
+				char groupname[ADHOCCTL_GROUPNAME_LEN + 1];
+				strncpy(groupname, (const char *)user->group.data, ADHOCCTL_GROUPNAME_LEN);
+				groupname[ADHOCCTL_GROUPNAME_LEN] = 0;
+				
+				// Escaped Group Name
+				char escaped[6 * ADHOCCTL_GROUPNAME_LEN + 1];
+				
+				// Write Group
+				append_http(out, "%s{\"group\":\"%s\",\"users\":[", (!newgame && prev->grouped) ? "," : "", strcpyjson(escaped, groupname, sizeof(escaped)));
+			}
+			
+			// Groupless Users (close the Group List first)
+			else append_http(out, "],\"groupless\":[");
+		}
+		
+		// Write User
+		if(!newgroup) append_http(out, ",");
+		write_feed_user(out, user);
+	}
+	
+	// Close last Group & Game
+	if(count > 0) append_http(out, users[count - 1]->grouped ? "]}],\"groupless\":[]}" : "]}");
+	
+	// Snapshot Footer
+	append_http(out, "]}\n");
+	
+	// Free Sorted Users
+	free(users);
+}
+
+/**
+ * Order mirrored Users for the Snapshot (Game, Grouped first, Group Name)
+ * @param a User A
+ * @param b User B
+ * @return Comparison Result
+ */
+int compare_feed_users(const void * a, const void * b)
+{
+	// Users
+	const SceNetAdhocctlFeedUser * ua = *(const SceNetAdhocctlFeedUser **)a;
+	const SceNetAdhocctlFeedUser * ub = *(const SceNetAdhocctlFeedUser **)b;
+	
+	// Compare Games
+	int result = memcmp(ua->game.data, ub->game.data, PRODUCT_CODE_LENGTH);
+	if(result != 0) return result;
+	
+	// Grouped Users first
+	if(ua->grouped != ub->grouped) return ub->grouped - ua->grouped;
+	
+	// Compare Groups
+	if(ua->grouped) return strncmp((const char *)ua->group.data, (const char *)ub->group.data, ADHOCCTL_GROUPNAME_LEN);
+	
+	// Same Place
+	return 0;
+}
+
+/**
+ * Accept pending Subscribers (each one starts with a Snapshot)
+ * @param epoll Event Poll
+ */
+void accept_feed_subscribers(int epoll)
+{
+	// Drain Backlog
+	while(1)
+	{
+		// Accept Subscriber
+		int stream = accept(_feed_server, NULL, NULL);
+		
+		// Backlog drained
+		if(stream == -1) return;
+		
+		// Find free Slot
+		SceNetAdhocctlFeedSubscriber * subscriber = NULL;
+		uint32_t i = 0; for(; i < SERVER_FEED_SUBSCRIBERS && subscriber == NULL; i++) if(_feed_subscriber[i].stream == -1) subscriber = &_feed_subscriber[i];
+		
+		// All Slots busy
+		if(subscriber == NULL)
+		{
+			// Refuse Subscriber
+			close(stream);
+			
+			// Continue Loop
+			continue;
+		}
+		
+		// Switch Socket into Non-Blocking Mode
+		change_blocking_mode(stream, 1);
+		
+		// Initialize Subscriber
+		subscriber->stream = stream;
+		subscriber->out.len = 0;
+		subscriber->out.failed = 0;
+		subscriber->outpos = 0;
+		subscriber->snapshotend = 0;
+		
+		// Watch Subscriber Socket (Edge-Triggered, Writability flushes the Queue)
+		struct epoll_event event;
+		memset(&event, 0, sizeof(event));
+		event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+		event.data.ptr = subscriber;
+		epoll_ctl(epoll, EPOLL_CTL_ADD, stream, &event);
+		
+		// Queue Snapshot (the Deltas follow at the next Sequence Number)
+		write_feed_snapshot(&subscriber->out);
+		
+		// Remember Snapshot End
+		subscriber->snapshotend = subscriber->out.len;
+		
+		// Out of Memory
+		if(subscriber->out.failed) close_feed_subscriber(subscriber);
+		
+		// Notify User
+		else log_text(LOG_LEVEL_INFO, "Feed Subscriber connected (Snapshot of %u Users).", _feed_user_count);
+	}
+}
+
+/**
+ * Discard Subscriber Input (closes the Subscriber on Hangup or Error)
+ * @param subscriber Subscriber
+ */
+void receive_feed_subscriber(SceNetAdhocctlFeedSubscriber * subscriber)
+{
+	// Closed earlier
+	if(subscriber->stream == -1) return;
+	
+	// Drain Socket
+	while(1)
+	{
+		// Receive Data
+		char buffer[256];
+		int recvresult = recv(subscriber->stream, buffer, sizeof(buffer), 0);
+		
+		// No more Data available
+		if(recvresult == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+		
+		// Connection Closed or Failed
+		if(recvresult <= 0)
+		{
+			// Close Subscriber
+			close_feed_subscriber(subscriber);
+			
+			// Stop Receiving
+			return;
+		}
+	}
+}
+
+/**
+ * Send queued Lines to Subscriber
+ * @param subscriber Subscriber
+ */
+void flush_feed_subscriber(SceNetAdhocctlFeedSubscriber * subscriber)
+{
+	// Nothing to send
+	if(subscriber->stream == -1 || subscriber->outpos == subscriber->out.len) return;
+	
+	// Send until done or the Socket is full
+	while(subscriber->outpos < subscriber->out.len)
+	{
+		// Send Data
+		int sendresult = send(subscriber->stream, subscriber->out.data + subscriber->outpos, subscriber->out.len - subscriber->outpos, MSG_NOSIGNAL | MSG_DONTWAIT);
+		
+		// Socket full (retried on Writability)
+		if(sendresult == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+		
+		// Connection Failed
+		if(sendresult <= 0)
+		{
+			// Close Subscriber
+			close_feed_subscriber(subscriber);
+			
+			// Stop Sending
+			return;
+		}
+		
+		// Move Position
+		subscriber->outpos += sendresult;
+	}
+	
+	// Everything sent (rewind Queue)
+	if(subscriber->outpos == subscriber->out.len) subscriber->outpos = subscriber->out.len = subscriber->snapshotend = 0;
+	
+	// Compact Queue (once the sent Part dominates)
+	else if(subscriber->outpos > subscriber->out.len / 2)
+	{
+		// Move Unsent Data to Front
+		memmove(subscriber->out.data, subscriber->out.data + subscriber->outpos, subscriber->out.len - subscriber->outpos);
+		
+		// Fix Queue Pointers
+		subscriber->out.len -= subscriber->outpos;
+		subscriber->snapshotend = (subscriber->snapshotend > subscriber->outpos) ? (subscriber->snapshotend - subscriber->outpos) : 0;
+		subscriber->outpos = 0;
+	}
+}
+
+/**
+ * Close Subscriber and free its Slot
+ * @param subscriber Subscriber
+ */
+void close_feed_subscriber(SceNetAdhocctlFeedSubscriber * subscriber)
+{
+	// Free Slot
+	if(subscriber->stream == -1) return;
+	
+	// Close Socket (removes it from the Event Poll)
+	close(subscriber->stream);
+	subscriber->stream = -1;
+	
+	// Free Queue
+	free(subscriber->out.data);
+	memset(&subscriber->out, 0, sizeof(subscriber->out));
+	subscriber->outpos = 0;
+	subscriber->snapshotend = 0;
+}
@@ -0,0 +1,81 @@
+/*
+ * This file is part of PRO ONLINE.
+
+ * PRO ONLINE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * PRO ONLINE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PRO ONLINE. If not, see <http://www.gnu.org/licenses/ .
+ */
+
+#ifndef _FEED_H_
+#define _FEED_H_
+
+#include <stdint.h>
+#include <user.h>
+
+// Feed Events (queued by the Loop Threads)
+#define FEED_EVENT_LOGIN 0
+#define FEED_EVENT_LOGOUT 1
+#define FEED_EVENT_JOIN 2
+#define FEED_EVENT_LEAVE 3
+
+// Feed Events (derived by the Feed Thread)
+#define FEED_EVENT_GROUP_CREATE 4
+#define FEED_EVENT_GROUP_DESTROY 5
+
+// Feed Event (copied into the Feed Queue as-is)
+typedef struct
+{
+	// Feed Event
+	uint32_t event;
+	
+	// User IP Address (identifies the User while it is connected)
+	uint32_t ip;
+	
+	// User MAC Address
+	SceNetEtherAddr mac;
+	
+	// User Nickname
+	SceNetAdhocctlNickname name;
+	
+	// Game Product Code
+	SceNetAdhocctlProductCode game;
+	
+	// Group Name (Join & Leave)
+	SceNetAdhocctlGroupName group;
+} SceNetAdhocctlFeedEvent;
+
+// Feed Thread running (Producers skip the Queue otherwise)
+extern int _feed_running;
+
+// Queue Feed Event (Arguments aren't evaluated while the Feed is off)
+#define feed_user(event, user) do { if(__atomic_load_n(&_feed_running, __ATOMIC_ACQUIRE)) queue_feed_event(event, user); } while(0)
+
+/**
+ * Start Feed Thread (serves Snapshot + Deltas to Subscribers)
+ * @param server Feed Listening Socket (owned by the Feed Thread from now on)
+ * @return 0 on Success or -1 on Error
+ */
+int start_feed(int server);
+
+/**
+ * Stop Feed Thread (sends the queued Events first)
+ */
+void stop_feed(void);
+
+/**
+ * Queue Feed Event (use feed_user)
+ * @param event Feed Event
+ * @param user User Node (logged in, Group set for Join & Leave)
+ */
+void queue_feed_event(int event, SceNetAdhocctlUserNode * user);
+
+#endif
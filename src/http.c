@@ -0,0 +1,577 @@
+/*
+ * This file is part of PRO ONLINE.
+
+ * PRO ONLINE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * PRO ONLINE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PRO ONLINE. If not, see <http://www.gnu.org/licenses/ .
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <metrics.h>
+#include <status.h>
+#include <loop.h>
+#include <http.h>
+
+// HTTP Request Handler (fills in the Response, returns the HTTP Status Code)
+typedef int (*SceNetAdhocctlHttpHandler)(SceNetAdhocctlHttpExchange * exchange);
+
+// HTTP Route
+typedef struct
+{
+	// Request Path
+	const char * path;
+	
+	// Content Type
+	const char * type;
+	
+	// Request Handler
+	SceNetAdhocctlHttpHandler handler;
+} SceNetAdhocctlHttpRoute;
+
+// HTTP Client Slots (Acceptor Thread only)
+static SceNetAdhocctlHttpClient _http_clients[SERVER_HTTP_CLIENTS];
+static int _http_initialized = 0;
+
+// Function Prototypes
+int handle_metrics(SceNetAdhocctlHttpExchange * exchange);
+void receive_http_request(SceNetAdhocctlHttpClient * client);
+void respond_http(SceNetAdhocctlHttpClient * client, int code, const char * type, const char * extra, SceNetAdhocctlHttpBuffer * body);
+void route_http_request(SceNetAdhocctlHttpClient * client);
+void flush_http_response(SceNetAdhocctlHttpClient * client);
+void close_http_client(SceNetAdhocctlHttpClient * client);
+const char * get_http_reason(int code);
+
+// HTTP Routes
+static const SceNetAdhocctlHttpRoute _http_routes[] = {
+	{ "/metrics", "text/plain; version=0.0.4", handle_metrics },
+	{ "/status.json", "application/json", serve_status_json },
+};
+
+/**
+ * Accept pending HTTP Clients
+ * @param server HTTP Listening Socket
+ */
+void accept_http_clients(int server)
+{
+	// Mark all Slots free
+	if(!_http_initialized)
+	{
+		// Free Slots
+		uint32_t i = 0; for(; i < SERVER_HTTP_CLIENTS; i++) _http_clients[i].stream = -1;
+		
+		// Slots initialized
+		_http_initialized = 1;
+	}
+	
+	// Drain Backlog (required for Edge-Triggered Notifications)
+	while(1)
+	{
+		// Accept HTTP Client
+		int stream = accept(server, NULL, NULL);
+		
+		// Backlog drained
+		if(stream == -1) return;
+		
+		// Find free Slot
+		SceNetAdhocctlHttpClient * client = NULL;
+		uint32_t i = 0; for(; i < SERVER_HTTP_CLIENTS && client == NULL; i++) if(_http_clients[i].stream == -1) client = &_http_clients[i];
+		
+		// All Slots busy
+		if(client == NULL)
+		{
+			// Refuse Client
+			close(stream);
+			
+			// Continue Loop
+			continue;
+		}
+		
+		// Switch Socket into Non-Blocking Mode
+		change_blocking_mode(stream, 1);
+		
+		// Initialize Client
+		client->stream = stream;
+		client->deadline = _loop_clock + SERVER_HTTP_TIMEOUT * 1000ULL;
+		client->requestlen = 0;
+		client->response = NULL;
+		client->responselen = 0;
+		client->responsepos = 0;
+		
+		// Watch Client Socket
+		watch_socket(stream, client);
+	}
+}
+
+/**
+ * Find HTTP Client by Event Tag
+ * @param tag Event Tag
+ * @return HTTP Client or NULL if the Tag belongs to something else
+ */
+SceNetAdhocctlHttpClient * find_http_client(void * tag)
+{
+	// Tag points into the Client Slots
+	if((SceNetAdhocctlHttpClient *)tag >= _http_clients && (SceNetAdhocctlHttpClient *)tag < _http_clients + SERVER_HTTP_CLIENTS) return (SceNetAdhocctlHttpClient *)tag;
+	
+	// Foreign Tag
+	return NULL;
+}
+
+/**
+ * Process HTTP Client Socket Events
+ * @param client HTTP Client
+ * @param events Ready Events
+ */
+void process_http_client(SceNetAdhocctlHttpClient * client, uint32_t events)
+{
+	// Closed earlier in this Batch
+	if(client->stream == -1) return;
+	
+	// Socket Error
+	if(events & EPOLLERR)
+	{
+		// Close Client
+		close_http_client(client);
+		
+		// Stop Processing
+		return;
+	}
+	
+	// Request still incomplete
+	if(client->response == NULL && (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP))) receive_http_request(client);
+	
+	// Response pending
+	if(client->stream != -1 && client->response != NULL) flush_http_response(client);
+}
+
+/**
+ * Close HTTP Clients past their Deadline
+ */
+void expire_http_clients(void)
+{
+	// Iterate Client Slots
+	uint32_t i = 0; for(; _http_initialized && i < SERVER_HTTP_CLIENTS; i++)
+	{
+		// Deadline passed
+		if(_http_clients[i].stream != -1 && _loop_clock >= _http_clients[i].deadline) close_http_client(&_http_clients[i]);
+	}
+}
+
+/**
+ * Close all HTTP Clients
+ */
+void close_http_clients(void)
+{
+	// Iterate Client Slots
+	uint32_t i = 0; for(; _http_initialized && i < SERVER_HTTP_CLIENTS; i++)
+	{
+		// Close Client
+		if(_http_clients[i].stream != -1) close_http_client(&_http_clients[i]);
+	}
+}
+
+/**
+ * Get HTTP Request Header Value
+ * @param header Request Header Lines
+ * @param name Header Name (case-insensitive)
+ * @param out Out Buffer
+ * @param size Size of Out Buffer
+ * @return 0 on Success or -1 if the Header is missing
+ */
+int get_http_header(const char * header, const char * name, char * out, uint32_t size)
+{
+	// Name Length
+	size_t namelen = strlen(name);
+	
+	// Iterate Header Lines
+	while(*header != 0)
+	{
+		// Line Length
+		size_t linelen = strcspn(header, "\r\n");
+		
+		// Header Name matches
+		if(linelen > namelen && header[namelen] == ':' && strncasecmp(header, name, namelen) == 0)
+		{
+			// Skip Name & Whitespace
+			const char * value = header + namelen + 1;
+			while(*value == ' ' || *value == '\t') value++;
+			
+			// Value Length (truncated to the Out Buffer)
+			size_t valuelen = linelen - (value - header);
+			if(valuelen > size - 1) valuelen = size - 1;
+			
+			// Copy Value
+			memcpy(out, value, valuelen);
+			out[valuelen] = 0;
+			
+			// Return Success
+			return 0;
+		}
+		
+		// Move to next Line
+		header += linelen;
+		while(*header == '\r' || *header == '\n') header++;
+	}
+	
+	// Header missing
+	return -1;
+}
+
+/**
+ * Get HTTP Query Parameter Value (not URL-decoded)
+ * @param query Query String
+ * @param name Parameter Name
+ * @param out Out Buffer
+ * @param size Size of Out Buffer
+ * @return 0 on Success or -1 if the Parameter is missing
+ */
+int get_http_query(const char * query, const char * name, char * out, uint32_t size)
+{
+	// Name Length
+	size_t namelen = strlen(name);
+	
+	// Iterate Parameters
+	while(*query != 0)
+	{
+		// Parameter Length
+		size_t paramlen = strcspn(query, "&");
+		
+		// Parameter Name matches
+		if(paramlen >= namelen && strncmp(query, name, namelen) == 0 && (paramlen == namelen || query[namelen] == '='))
+		{
+			// Value (empty without '=')
+			const char * value = (paramlen > namelen) ? (query + namelen + 1) : (query + namelen);
+			
+			// Value Length (truncated to the Out Buffer)
+			size_t valuelen = paramlen - (value - query);
+			if(valuelen > size - 1) valuelen = size - 1;
+			
+			// Copy Value
+			memcpy(out, value, valuelen);
+			out[valuelen] = 0;
+			
+			// Return Success
+			return 0;
+		}
+		
+		// Move to next Parameter
+		query += paramlen;
+		if(*query == '&') query++;
+	}
+	
+	// Parameter missing
+	return -1;
+}
+
+/**
+ * Append formatted Text to HTTP Buffer
+ * @param buffer HTTP Buffer
+ * @param format printf Format
+ */
+void append_http(SceNetAdhocctlHttpBuffer * buffer, const char * format, ...)
+{
+	// Buffer failed earlier
+	if(buffer->failed) return;
+	
+	// Format until the Text fits
+	while(1)
+	{
+		// Free Space
+		uint32_t space = buffer->size - buffer->len;
+		
+		// Format Text
+		va_list args;
+		va_start(args, format);
+		int length = vsnprintf(buffer->data + buffer->len, space, format, args);
+		va_end(args);
+		
+		// Format Error
+		if(length < 0)
+		{
+			// Mark Buffer
+			buffer->failed = 1;
+			
+			// Stop Appending
+			return;
+		}
+		
+		// Text fits (with Terminator)
+		if((uint32_t)length < space)
+		{
+			// Move Length
+			buffer->len += length;
+			
+			// Stop Appending
+			return;
+		}
+		
+		// New Buffer Size (doubled to keep Reallocations rare)
+		uint32_t size = (buffer->size > 0) ? (buffer->size * 2) : 4096;
+		while(size < buffer->len + length + 1) size *= 2;
+		
+		// Grow Buffer
+		char * data = (char *)realloc(buffer->data, size);
+		
+		// Out of Memory
+		if(data == NULL)
+		{
+			// Mark Buffer
+			buffer->failed = 1;
+			
+			// Stop Appending
+			return;
+		}
+		
+		// Replace Buffer
+		buffer->data = data;
+		buffer->size = size;
+	}
+}
+
+/**
+ * Handle Metrics Request
+ * @param exchange HTTP Exchange
+ * @return HTTP Status Code
+ */
+int handle_metrics(SceNetAdhocctlHttpExchange * exchange)
+{
+	// Render Metrics
+	render_metrics(&exchange->body);
+	
+	// Return OK
+	return 200;
+}
+
+/**
+ * Receive HTTP Request Header (routes it once complete)
+ * @param client HTTP Client
+ */
+void receive_http_request(SceNetAdhocctlHttpClient * client)
+{
+	// Drain Socket (required for Edge-Triggered Notifications)
+	while(1)
+	{
+		// Header too large
+		if(client->requestlen == sizeof(client->request) - 1)
+		{
+			// Refuse Request
+			respond_http(client, 431, "text/plain", "", NULL);
+			
+			// Stop Receiving
+			return;
+		}
+		
+		// Receive Data
+		int recvresult = recv(client->stream, client->request + client->requestlen, sizeof(client->request) - 1 - client->requestlen, 0);
+		
+		// No more Data available
+		if(recvresult == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+		
+		// Connection Closed or Failed
+		if(recvresult <= 0)
+		{
+			// Close Client
+			close_http_client(client);
+			
+			// Stop Receiving
+			return;
+		}
+		
+		// Move Request Length
+		client->requestlen += recvresult;
+		client->request[client->requestlen] = 0;
+		
+		// Header complete
+		if(strstr(client->request, "\r\n\r\n") != NULL || strstr(client->request, "\n\n") != NULL)
+		{
+			// Route Request
+			route_http_request(client);
+			
+			// Stop Receiving
+			return;
+		}
+	}
+}
+
+/**
+ * Route complete HTTP Request
+ * @param client HTTP Client
+ */
+void route_http_request(SceNetAdhocctlHttpClient * client)
+{
+	// Only GET is supported
+	if(strncmp(client->request, "GET ", 4) != 0)
+	{
+		// Refuse Method
+		respond_http(client, 405, "text/plain", "", NULL);
+		
+		// Stop Routing
+		return;
+	}
+	
+	// Request Path (ends at Query, Space or Line End)
+	char * path = client->request + 4;
+	size_t pathlen = strcspn(path, "? \r\n");
+	
+	// Query String (ends at Space or Line End)
+	char * query = path + pathlen;
+	if(*query == '?') query++;
+	size_t querylen = strcspn(query, " \r\n");
+	
+	// Header Lines (after the Request Line)
+	char * header = query + querylen;
+	header += strcspn(header, "\n");
+	if(*header == '\n') header++;
+	
+	// Terminate Query String (the Request Line isn't needed anymore)
+	query[querylen] = 0;
+	
+	// Iterate Routes
+	uint32_t i = 0; for(; i < sizeof(_http_routes) / sizeof(_http_routes[0]); i++)
+	{
+		// Path matches
+		if(strlen(_http_routes[i].path) == pathlen && strncmp(_http_routes[i].path, path, pathlen) == 0)
+		{
+			// Exchange
+			SceNetAdhocctlHttpExchange exchange;
+			memset(&exchange, 0, sizeof(exchange));
+			exchange.query = query;
+			exchange.header = header;
+			
+			// Handle Request
+			int code = _http_routes[i].handler(&exchange);
+			
+			// Send Response (or an Error if the Body didn't fit into Memory)
+			if(exchange.body.failed || code == 500) respond_http(client, 500, "text/plain", "", NULL);
+			else respond_http(client, code, _http_routes[i].type, exchange.extra, &exchange.body);
+			
+			// Free Body
+			free(exchange.body.data);
+			
+			// Stop Routing
+			return;
+		}
+	}
+	
+	// Unknown Path
+	respond_http(client, 404, "text/plain", "", NULL);
+}
+
+/**
+ * Queue HTTP Response (the Connection closes once it was sent)
+ * @param client HTTP Client
+ * @param code HTTP Status Code
+ * @param type Content Type
+ * @param extra Extra Header Lines (each ends with CRLF)
+ * @param body Response Body (NULL for the Reason Phrase)
+ */
+void respond_http(SceNetAdhocctlHttpClient * client, int code, const char * type, const char * extra, SceNetAdhocctlHttpBuffer * body)
+{
+	// Reason Phrase
+	const char * reason = get_http_reason(code);
+	
+	// Response Body
+	const char * data = (body != NULL) ? body->data : reason;
+	uint32_t len = (body != NULL) ? body->len : strlen(reason);
+	
+	// Response Header
+	char header[384];
+	int headerlen = snprintf(header, sizeof(header), "HTTP/1.0 %d %s\r\nContent-Type: %s\r\nContent-Length: %u\r\n%sConnection: close\r\n\r\n", code, reason, type, len, extra);
+	
+	// Allocate Response
+	client->response = (char *)malloc(headerlen + len);
+	
+	// Out of Memory
+	if(client->response == NULL)
+	{
+		// Close Client
+		close_http_client(client);
+		
+		// Stop Responding
+		return;
+	}
+	
+	// Copy Header & Body
+	memcpy(client->response, header, headerlen);
+	if(len > 0) memcpy(client->response + headerlen, data, len);
+	client->responselen = headerlen + len;
+	client->responsepos = 0;
+}
+
+/**
+ * Send queued HTTP Response (closes the Client when done)
+ * @param client HTTP Client
+ */
+void flush_http_response(SceNetAdhocctlHttpClient * client)
+{
+	// Send until done or the Socket is full
+	while(client->responsepos < client->responselen)
+	{
+		// Send Data
+		int sendresult = send(client->stream, client->response + client->responsepos, client->responselen - client->responsepos, MSG_NOSIGNAL | MSG_DONTWAIT);
+		
+		// Socket full (retried on Writability)
+		if(sendresult == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+		
+		// Connection Failed
+		if(sendresult <= 0) break;
+		
+		// Move Response Position
+		client->responsepos += sendresult;
+	}
+	
+	// Close Client
+	close_http_client(client);
+}
+
+/**
+ * Close HTTP Client and free its Slot
+ * @param client HTTP Client
+ */
+void close_http_client(SceNetAdhocctlHttpClient * client)
+{
+	// Close Socket (removes it from the Event Poll)
+	close(client->stream);
+	
+	// Free Response
+	free(client->response);
+	client->response = NULL;
+	
+	// Free Slot
+	client->stream = -1;
+}
+
+/**
+ * Get HTTP Reason Phrase
+ * @param code HTTP Status Code
+ * @return Reason Phrase
+ */
+const char * get_http_reason(int code)
+{
+	// Known Codes
+	switch(code)
+	{
+		case 200: return "OK";
+		case 304: return "Not Modified";
+		case 404: return "Not Found";
+		case 405: return "Method Not Allowed";
+		case 431: return "Request Header Fields Too Large";
+		default: return "Internal Server Error";
+	}
+}
@@ -0,0 +1,130 @@
+/*
+ * This file is part of PRO ONLINE.
+
+ * PRO ONLINE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * PRO ONLINE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PRO ONLINE. If not, see <http://www.gnu.org/licenses/ .
+ */
+
+#ifndef _HTTP_H_
+#define _HTTP_H_
+
+#include <stdint.h>
+#include <config.h>
+
+// HTTP Response Buffer (grown on Demand)
+typedef struct
+{
+	// Data
+	char * data;
+	
+	// Used & Allocated Size
+	uint32_t len;
+	uint32_t size;
+	
+	// Out of Memory
+	int failed;
+} SceNetAdhocctlHttpBuffer;
+
+// HTTP Exchange (what a Route Handler gets and fills in)
+typedef struct
+{
+	// Query String (empty if none)
+	const char * query;
+	
+	// Request Header Lines (after the Request Line)
+	const char * header;
+	
+	// Response Body
+	SceNetAdhocctlHttpBuffer body;
+	
+	// Extra Response Header Lines (each ends with CRLF)
+	char extra[128];
+} SceNetAdhocctlHttpExchange;
+
+// HTTP Client Connection (served by the Acceptor Loop, closed after one Response)
+typedef struct
+{
+	// TCP Socket (-1 for free Slots)
+	int stream;
+	
+	// Deadline (Loop Clock Milliseconds)
+	uint64_t deadline;
+	
+	// Request Header
+	char request[SERVER_HTTP_REQUEST];
+	uint32_t requestlen;
+	
+	// Response (NULL until the Request is complete)
+	char * response;
+	uint32_t responselen;
+	uint32_t responsepos;
+} SceNetAdhocctlHttpClient;
+
+/**
+ * Accept pending HTTP Clients
+ * @param server HTTP Listening Socket
+ */
+void accept_http_clients(int server);
+
+/**
+ * Find HTTP Client by Event Tag
+ * @param tag Event Tag
+ * @return HTTP Client or NULL if the Tag belongs to something else
+ */
+SceNetAdhocctlHttpClient * find_http_client(void * tag);
+
+/**
+ * Process HTTP Client Socket Events
+ * @param client HTTP Client
+ * @param events Ready Events
+ */
+void process_http_client(SceNetAdhocctlHttpClient * client, uint32_t events);
+
+/**
+ * Close HTTP Clients past their Deadline
+ */
+void expire_http_clients(void);
+
+/**
+ * Close all HTTP Clients
+ */
+void close_http_clients(void);
+
+/**
+ * Get HTTP Request Header Value
+ * @param header Request Header Lines
+ * @param name Header Name (case-insensitive)
+ * @param out Out Buffer
+ * @param size Size of Out Buffer
+ * @return 0 on Success or -1 if the Header is missing
+ */
+int get_http_header(const char * header, const char * name, char * out, uint32_t size);
+
+/**
+ * Get HTTP Query Parameter Value (not URL-decoded)
+ * @param query Query String
+ * @param name Parameter Name
+ * @param out Out Buffer
+ * @param size Size of Out Buffer
+ * @return 0 on Success or -1 if the Parameter is missing
+ */
+int get_http_query(const char * query, const char * name, char * out, uint32_t size);
+
+/**
+ * Append formatted Text to HTTP Buffer
+ * @param buffer HTTP Buffer
+ * @param format printf Format
+ */
+void append_http(SceNetAdhocctlHttpBuffer * buffer, const char * format, ...) __attribute__((format(printf, 2, 3)));
+
+#endif
@@ -0,0 +1,522 @@
+/*
+ * This file is part of PRO ONLINE.
+
+ * PRO ONLINE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * PRO ONLINE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PRO ONLINE. If not, see <http://www.gnu.org/licenses/ .
+ */
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <signal.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <log.h>
+
+// Log Ring Slot (Sequence tells Producers and the Log Thread who owns the Slot)
+typedef struct
+{
+	// Slot Sequence
+	uint64_t sequence;
+	
+	// Log Record
+	SceNetAdhocctlLogRecord record;
+} SceNetAdhocctlLogSlot;
+
+// Log Ring (bounded Multi-Producer Single-Consumer Queue)
+static SceNetAdhocctlLogSlot _log_ring[SERVER_LOG_RING];
+
+// Next Write Position (Producers)
+static uint64_t _log_head = 0;
+
+// Next Read Position (Log Thread)
+static uint64_t _log_tail = 0;
+
+// Records dropped because the Ring was full
+static uint32_t _log_dropped = 0;
+
+// Log Thread
+static pthread_t _log_thread;
+static int _log_running = 0;
+
+// Log Thread Wakeup (signalled by Producers while the Log Thread sleeps, and by the Stop Request)
+static int _log_wakeup = -1;
+static int _log_sleeping = 0;
+
+// Level & Event Names
+static const char * _log_level_name[] = { "DEBUG", "INFO", "WARNING", "ERROR" };
+static const char * _log_event_name[] = { "message", "connect", "drop", "login", "login_invalid", "logout", "join", "join_twice", "join_invalid", "leave", "leave_invalid", "scan", "scan_invalid", "chat", "chat_invalid", "opcode_invalid", "tx_overflow", "crosslink" };
+
+// Function Prototypes
+void * log_main(void * arg);
+SceNetAdhocctlLogSlot * acquire_log_slot(void);
+void commit_log_slot(SceNetAdhocctlLogSlot * slot);
+void wake_logger(void);
+uint32_t drain_log(void);
+void write_log_record(FILE * out, SceNetAdhocctlLogRecord * record);
+
+/**
+ * Start Log Thread (Records get written synchronously until then)
+ * @return 0 on Success or -1 on Error
+ */
+int start_logger(void)
+{
+	// Hand every Slot to the Producers
+	uint32_t i = 0; for(; i < SERVER_LOG_RING; i++) _log_ring[i].sequence = i;
+	_log_head = 0;
+	_log_tail = 0;
+	
+	// Create Wakeup Event
+	_log_wakeup = eventfd(0, EFD_CLOEXEC);
+	if(_log_wakeup == -1)
+	{
+		// Notify User
+		log_text(LOG_LEVEL_ERROR, "%s: failed to create Log Wakeup Event.", __func__);
+		
+		// Return Error
+		return -1;
+	}
+	
+	// Keep Signals on the Acceptor Thread
+	sigset_t mask, oldmask;
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGINT);
+	sigaddset(&mask, SIGTERM);
+	sigaddset(&mask, SIGHUP);
+	pthread_sigmask(SIG_BLOCK, &mask, &oldmask);
+	
+	// Create Log Thread
+	_log_running = 1;
+	int result = pthread_create(&_log_thread, NULL, log_main, NULL);
+	
+	// Restore Signal Mask
+	pthread_sigmask(SIG_SETMASK, &oldmask, NULL);
+	
+	// Failed to create Log Thread (keep logging synchronously)
+	if(result != 0)
+	{
+		// Not running
+		_log_running = 0;
+		
+		// Close Wakeup Event
+		close(_log_wakeup);
+		_log_wakeup = -1;
+		
+		// Notify User
+		log_text(LOG_LEVEL_ERROR, "%s: failed to create Log Thread.", __func__);
+		
+		// Return Error
+		return -1;
+	}
+	
+	// Return Success
+	return 0;
+}
+
+/**
+ * Stop Log Thread (writes the buffered Records first)
+ */
+void stop_logger(void)
+{
+	// Log Thread not running
+	if(!_log_running) return;
+	
+	// Stop Log Thread (it drains the Ring once more)
+	__atomic_store_n(&_log_running, 0, __ATOMIC_RELEASE);
+	
+	// Wake Log Thread
+	wake_logger();
+	
+	// Wait for Log Thread
+	pthread_join(_log_thread, NULL);
+	
+	// Close Wakeup Event
+	close(_log_wakeup);
+	_log_wakeup = -1;
+}
+
+/**
+ * Write User Event Record (use log_user)
+ * @param level Log Level
+ * @param event Log Event
+ * @param user User Node (NULL if none)
+ * @param game Game Product Code (NULL if none)
+ * @param group Group Name (NULL if none)
+ * @param group2 Previous Group Name (NULL if none)
+ * @param count Event Counter
+ * @param text Free Text (NULL if none)
+ */
+void write_user_log(int level, int event, SceNetAdhocctlUserNode * user, const SceNetAdhocctlProductCode * game, const SceNetAdhocctlGroupName * group, const SceNetAdhocctlGroupName * group2, int32_t count, const char * text)
+{
+	// Ring Slot (NULL while the Log Thread isn't running)
+	SceNetAdhocctlLogSlot * slot = NULL;
+	
+	// Synchronous Fallback Record
+	SceNetAdhocctlLogRecord local;
+	
+	// Log Thread running
+	if(__atomic_load_n(&_log_running, __ATOMIC_ACQUIRE))
+	{
+		// Grab Slot
+		slot = acquire_log_slot();
+		
+		// Ring full (never block the Event Loop)
+		if(slot == NULL) return;
+	}
+	
+	// Record
+	SceNetAdhocctlLogRecord * record = (slot != NULL) ? &slot->record : &local;
+	
+	// Wall Clock Time
+	struct timespec now;
+	clock_gettime(CLOCK_REALTIME_COARSE, &now);
+	record->time = (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+	
+	// Event
+	record->level = level;
+	record->event = event;
+	record->count = count;
+	
+	// User Identity
+	if(user != NULL)
+	{
+		record->ip = user->info->resolver.ip;
+		record->mac = user->info->resolver.mac;
+		record->name = user->info->resolver.name;
+	}
+	
+	// Anonymous Event
+	else
+	{
+		record->ip = 0;
+		memset(&record->mac, 0, sizeof(record->mac));
+		memset(&record->name, 0, sizeof(record->name));
+	}
+	
+	// Game & Groups
+	if(game != NULL) record->game = *game;
+	else memset(&record->game, 0, sizeof(record->game));
+	if(group != NULL) record->group = *group;
+	else memset(&record->group, 0, sizeof(record->group));
+	if(group2 != NULL) record->group2 = *group2;
+	else memset(&record->group2, 0, sizeof(record->group2));
+	
+	// Free Text
+	record->text[0] = 0;
+	if(text != NULL) strncat(record->text, text, sizeof(record->text) - 1);
+	
+	// Hand Record to the Log Thread
+	if(slot != NULL) commit_log_slot(slot);
+	
+	// Write Record right away
+	else
+	{
+		write_log_record(stdout, record);
+		fflush(stdout);
+	}
+}
+
+/**
+ * Write Text Message Record (use log_text)
+ * @param level Log Level
+ * @param format printf Format
+ */
+void write_text_log(int level, const char * format, ...)
+{
+	// Format Message (Text Messages are rare, so this happens on the calling Thread)
+	char text[sizeof(((SceNetAdhocctlLogRecord *)0)->text)];
+	va_list args;
+	va_start(args, format);
+	vsnprintf(text, sizeof(text), format, args);
+	va_end(args);
+	
+	// Write Record
+	write_user_log(level, LOG_EVENT_TEXT, NULL, NULL, NULL, NULL, 0, text);
+}
+
+/**
+ * Log Thread
+ * @param arg Unused
+ * @return NULL
+ */
+void * log_main(void * arg)
+{
+	// Drain Ring until stopped
+	while(1)
+	{
+		// Stop Request (checked before the Drain, so the last Records still get written)
+		int stopping = !__atomic_load_n(&_log_running, __ATOMIC_ACQUIRE);
+		
+		// Write buffered Records
+		uint32_t written = drain_log();
+		
+		// Report dropped Records
+		uint32_t dropped = __atomic_exchange_n(&_log_dropped, 0, __ATOMIC_RELAXED);
+		if(dropped > 0) fprintf(stdout, "Dropped %u Log Records (Log Ring full).\n", dropped);
+		
+		// Push Output to the Console
+		if(written > 0 || dropped > 0) fflush(stdout);
+		
+		// Stopped and drained
+		else if(stopping) break;
+		
+		// Idle Ring
+		else
+		{
+			// Announce Sleep (Producers wake the Thread from now on)
+			__atomic_store_n(&_log_sleeping, 1, __ATOMIC_SEQ_CST);
+			
+			// Sleep unless a Record or the Stop Request slipped in meanwhile
+			uint64_t events = 0;
+			SceNetAdhocctlLogSlot * slot = &_log_ring[_log_tail & (SERVER_LOG_RING - 1)];
+			if(__atomic_load_n(&slot->sequence, __ATOMIC_SEQ_CST) != _log_tail + 1 && __atomic_load_n(&_log_running, __ATOMIC_SEQ_CST)) read(_log_wakeup, &events, sizeof(events));
+			
+			// Awake
+			__atomic_store_n(&_log_sleeping, 0, __ATOMIC_RELAXED);
+		}
+	}
+	
+	// Exit Thread
+	return NULL;
+}
+
+/**
+ * Acquire free Log Ring Slot (Producers)
+ * @return Slot or NULL if the Ring is full
+ */
+SceNetAdhocctlLogSlot * acquire_log_slot(void)
+{
+	// Current Write Position
+	uint64_t position = __atomic_load_n(&_log_head, __ATOMIC_RELAXED);
+	
+	// Claim Slot
+	while(1)
+	{
+		// Slot
+		SceNetAdhocctlLogSlot * slot = &_log_ring[position & (SERVER_LOG_RING - 1)];
+		
+		// Slot Sequence
+		int64_t difference = (int64_t)__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) - (int64_t)position;
+		
+		// Free Slot (claim it unless another Producer was faster)
+		if(difference == 0)
+		{
+			if(__atomic_compare_exchange_n(&_log_head, &position, position + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) return slot;
+		}
+		
+		// Ring full
+		else if(difference < 0)
+		{
+			// Count dropped Record
+			__atomic_add_fetch(&_log_dropped, 1, __ATOMIC_RELAXED);
+			
+			// Return Error
+			return NULL;
+		}
+		
+		// Another Producer claimed the Slot
+		else position = __atomic_load_n(&_log_head, __ATOMIC_RELAXED);
+	}
+}
+
+/**
+ * Publish filled Log Ring Slot (Producers)
+ * @param slot Slot
+ */
+void commit_log_slot(SceNetAdhocctlLogSlot * slot)
+{
+	// Hand Slot to the Log Thread
+	__atomic_store_n(&slot->sequence, __atomic_load_n(&slot->sequence, __ATOMIC_RELAXED) + 1, __ATOMIC_SEQ_CST);
+	
+	// Wake sleeping Log Thread (only the first Producer after it fell asleep pays the System Call)
+	if(__atomic_load_n(&_log_sleeping, __ATOMIC_SEQ_CST) && __atomic_exchange_n(&_log_sleeping, 0, __ATOMIC_SEQ_CST)) wake_logger();
+}
+
+/**
+ * Wake Log Thread
+ */
+void wake_logger(void)
+{
+	// Signal Wakeup Event
+	uint64_t event = 1;
+	write(_log_wakeup, &event, sizeof(event));
+}
+
+/**
+ * Write all published Log Records (Log Thread)
+ * @return Number of written Records
+ */
+uint32_t drain_log(void)
+{
+	// Written Records
+	uint32_t written = 0;
+	
+	// Iterate published Slots
+	while(1)
+	{
+		// Slot
+		SceNetAdhocctlLogSlot * slot = &_log_ring[_log_tail & (SERVER_LOG_RING - 1)];
+		
+		// Slot not published yet
+		if(__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) != _log_tail + 1) break;
+		
+		// Write Record
+		write_log_record(stdout, &slot->record);
+		
+		// Hand Slot back to the Producers (for the next Lap)
+		__atomic_store_n(&slot->sequence, _log_tail + SERVER_LOG_RING, __ATOMIC_RELEASE);
+		
+		// Next Slot
+		_log_tail++;
+		written++;
+	}
+	
+	// Return Record Count
+	return written;
+}
+
+/**
+ * Format and write Log Record as Text or JSON Line
+ * @param out Output Stream
+ * @param record Log Record
+ */
+void write_log_record(FILE * out, SceNetAdhocctlLogRecord * record)
+{
+	// Time String
+	char timestr[32];
+	time_t seconds = (time_t)(record->time / 1000);
+	struct tm tm;
+	localtime_r(&seconds, &tm);
+	size_t timelen = strftime(timestr, sizeof(timestr), "%Y-%m-%d %H:%M:%S", &tm);
+	snprintf(timestr + timelen, sizeof(timestr) - timelen, ".%03u", (uint32_t)(record->time % 1000));
+	
+	// Safe Strings
+	char name[ADHOCCTL_NICKNAME_LEN + 1];
+	strncpy(name, (const char *)record->name.data, ADHOCCTL_NICKNAME_LEN);
+	name[ADHOCCTL_NICKNAME_LEN] = 0;
+	char game[PRODUCT_CODE_LENGTH + 1];
+	strncpy(game, record->game.data, PRODUCT_CODE_LENGTH);
+	game[PRODUCT_CODE_LENGTH] = 0;
+	char group[ADHOCCTL_GROUPNAME_LEN + 1];
+	strncpy(group, (const char *)record->group.data, ADHOCCTL_GROUPNAME_LEN);
+	group[ADHOCCTL_GROUPNAME_LEN] = 0;
+	char group2[ADHOCCTL_GROUPNAME_LEN + 1];
+	strncpy(group2, (const char *)record->group2.data, ADHOCCTL_GROUPNAME_LEN);
+	group2[ADHOCCTL_GROUPNAME_LEN] = 0;
+	
+	// IP & MAC String
+	uint8_t * ipa = (uint8_t *)&record->ip;
+	char ip[16];
+	snprintf(ip, sizeof(ip), "%u.%u.%u.%u", ipa[0], ipa[1], ipa[2], ipa[3]);
+	char mac[18];
+	snprintf(mac, sizeof(mac), "%02X:%02X:%02X:%02X:%02X:%02X", record->mac.data[0], record->mac.data[1], record->mac.data[2], record->mac.data[3], record->mac.data[4], record->mac.data[5]);
+	
+	// User Identity
+	char user[ADHOCCTL_NICKNAME_LEN + 64];
+	snprintf(user, sizeof(user), "%s (MAC: %s - IP: %s)", name, mac, ip);
+	
+	// Message
+	char message[512];
+	switch(record->event)
+	{
+		case LOG_EVENT_CONNECT: snprintf(message, sizeof(message), "New Connection from %s.", ip); break;
+		case LOG_EVENT_DROP: snprintf(message, sizeof(message), "Dropped Connection to %s.", ip); break;
+		case LOG_EVENT_LOGIN: snprintf(message, sizeof(message), "%s started playing %s.", user, game); break;
+		case LOG_EVENT_LOGIN_INVALID: snprintf(message, sizeof(message), "Invalid Login Packet Contents from %s.", ip); break;
+		case LOG_EVENT_LOGOUT: snprintf(message, sizeof(message), "%s stopped playing %s.", user, game); break;
+		case LOG_EVENT_JOIN: snprintf(message, sizeof(message), "%s joined %s group %s.", user, game, group); break;
+		case LOG_EVENT_JOIN_TWICE: snprintf(message, sizeof(message), "%s attempted to join %s group %s without disconnecting from %s first.", user, game, group, group2); break;
+		case LOG_EVENT_JOIN_INVALID: snprintf(message, sizeof(message), "%s attempted to join invalid %s group %s.", user, game, group); break;
+		case LOG_EVENT_LEAVE: snprintf(message, sizeof(message), "%s left %s group %s.", user, game, group); break;
+		case LOG_EVENT_LEAVE_INVALID: snprintf(message, sizeof(message), "%s attempted to leave %s group without joining one first.", user, game); break;
+		case LOG_EVENT_SCAN: snprintf(message, sizeof(message), "%s requested information on %d %s groups.", user, record->count, game); break;
+		case LOG_EVENT_SCAN_INVALID: snprintf(message, sizeof(message), "%s attempted to scan for %s groups without disconnecting from %s first.", user, game, group); break;
+		case LOG_EVENT_CHAT: snprintf(message, sizeof(message), "%s sent \"%s\" to %d players in %s group %s.", user, record->text, record->count, game, group); break;
+		case LOG_EVENT_CHAT_INVALID: snprintf(message, sizeof(message), "%s attempted to send a text message without joining a %s group first.", user, game); break;
+		case LOG_EVENT_OPCODE_INVALID:
+			if(name[0] == 0) snprintf(message, sizeof(message), "Invalid Opcode 0x%02X in Waiting State from %s.", record->count, ip);
+			else snprintf(message, sizeof(message), "Invalid Opcode 0x%02X in Logged-In State from %s.", record->count, user);
+			break;
+		case LOG_EVENT_TX_OVERFLOW: snprintf(message, sizeof(message), "Dropping %s (TX Queue Overflow).", ip); break;
+		case LOG_EVENT_CROSSLINK: snprintf(message, sizeof(message), "Crosslinked %s to %s.", record->text, game); break;
+		default: snprintf(message, sizeof(message), "%s", record->text); break;
+	}
+	
+	// Text Line
+	if(!SERVER_LOG_JSON)
+	{
+		fprintf(out, "%s %-7s %s\n", timestr, _log_level_name[record->level], message);
+		return;
+	}
+	
+	// JSON Line (Time, Level & Event)
+	char escaped[1024];
+	fprintf(out, "{\"time\":\"%s\",\"level\":\"%s\",\"event\":\"%s\"", timestr, _log_level_name[record->level], _log_event_name[record->event]);
+	
+	// User Identity
+	if(record->ip != 0) fprintf(out, ",\"ip\":\"%s\"", ip);
+	if(name[0] != 0) fprintf(out, ",\"name\":\"%s\",\"mac\":\"%s\"", strcpyjson(escaped, name, sizeof(escaped)), mac);
+	
+	// Game & Groups
+	if(game[0] != 0) fprintf(out, ",\"game\":\"%s\"", strcpyjson(escaped, game, sizeof(escaped)));
+	if(group[0] != 0) fprintf(out, ",\"group\":\"%s\"", strcpyjson(escaped, group, sizeof(escaped)));
+	if(group2[0] != 0) fprintf(out, ",\"previous_group\":\"%s\"", strcpyjson(escaped, group2, sizeof(escaped)));
+	
+	// Event Counter
+	if(record->event == LOG_EVENT_SCAN || record->event == LOG_EVENT_CHAT || record->event == LOG_EVENT_OPCODE_INVALID) fprintf(out, ",\"count\":%d", record->count);
+	
+	// Free Text
+	if(record->event != LOG_EVENT_TEXT && record->text[0] != 0) fprintf(out, ",\"text\":\"%s\"", strcpyjson(escaped, record->text, sizeof(escaped)));
+	
+	// Message
+	fprintf(out, ",\"message\":\"%s\"}\n", strcpyjson(escaped, message, sizeof(escaped)));
+}
+
+/**
+ * Escape JSON String Sequences
+ * @param out Out Buffer
+ * @param in In Buffer
+ * @param size Size of Out Buffer
+ * @return Reference to Out Buffer
+ */
+const char * strcpyjson(char * out, const char * in, uint32_t size)
+{
+	// Written Size Pointer
+	uint32_t written = 0;
+	
+	// Iterate In-Buffer Symbols
+	for(; *in != 0; in++)
+	{
+		// Escape Sequence
+		char sequence[8];
+		uint8_t symbol = (uint8_t)*in;
+		if(symbol == '"' || symbol == '\\') snprintf(sequence, sizeof(sequence), "\\%c", symbol);
+		else if(symbol < 0x20) snprintf(sequence, sizeof(sequence), "\\u%04X", symbol);
+		else snprintf(sequence, sizeof(sequence), "%c", symbol);
+		
+		// Truncate required
+		uint32_t length = strlen(sequence);
+		if(written + length >= size) break;
+		
+		// Write Sequence
+		memcpy(out + written, sequence, length);
+		written += length;
+	}
+	
+	// Terminate String
+	out[written] = 0;
+	
+	// Return Reference
+	return out;
+}
@@ -0,0 +1,136 @@
+/*
+ * This file is part of PRO ONLINE.
+
+ * PRO ONLINE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * PRO ONLINE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PRO ONLINE. If not, see <http://www.gnu.org/licenses/ .
+ */
+#ifndef _LOG_H_
+#define _LOG_H_
+
+#include <stdint.h>
+#include <config.h>
+#include <user.h>
+
+// Log Levels
+#define LOG_LEVEL_DEBUG 0
+#define LOG_LEVEL_INFO 1
+#define LOG_LEVEL_WARNING 2
+#define LOG_LEVEL_ERROR 3
+
+// Log Events (formatted by the Log Thread)
+#define LOG_EVENT_TEXT 0
+#define LOG_EVENT_CONNECT 1
+#define LOG_EVENT_DROP 2
+#define LOG_EVENT_LOGIN 3
+#define LOG_EVENT_LOGIN_INVALID 4
+#define LOG_EVENT_LOGOUT 5
+#define LOG_EVENT_JOIN 6
+#define LOG_EVENT_JOIN_TWICE 7
+#define LOG_EVENT_JOIN_INVALID 8
+#define LOG_EVENT_LEAVE 9
+#define LOG_EVENT_LEAVE_INVALID 10
+#define LOG_EVENT_SCAN 11
+#define LOG_EVENT_SCAN_INVALID 12
+#define LOG_EVENT_CHAT 13
+#define LOG_EVENT_CHAT_INVALID 14
+#define LOG_EVENT_OPCODE_INVALID 15
+#define LOG_EVENT_TX_OVERFLOW 16
+#define LOG_EVENT_CROSSLINK 17
+
+// Log Record (copied into the Log Ring as-is)
+typedef struct
+{
+	// Wall Clock Time (Milliseconds since the Epoch)
+	uint64_t time;
+	
+	// Log Level
+	uint16_t level;
+	
+	// Log Event
+	uint16_t event;
+	
+	// User IP Address
+	uint32_t ip;
+	
+	// Event Counter (Groups, Recipients or Opcode)
+	int32_t count;
+	
+	// User MAC Address
+	SceNetEtherAddr mac;
+	
+	// User Nickname
+	SceNetAdhocctlNickname name;
+	
+	// Game Product Code
+	SceNetAdhocctlProductCode game;
+	
+	// Group Name
+	SceNetAdhocctlGroupName group;
+	
+	// Previous Group Name
+	SceNetAdhocctlGroupName group2;
+	
+	// Free Text (Message or Chat Text)
+	char text[160];
+} SceNetAdhocctlLogRecord;
+
+// Level Check (SERVER_LOG_LEVEL is a Constant, so disabled Levels compile away)
+#define log_enabled(level) ((level) >= SERVER_LOG_LEVEL)
+
+// Log User Event (Arguments aren't evaluated for disabled Levels)
+#define log_user(level, event, user, game, group, group2, count, text) do { if(log_enabled(level)) write_user_log(level, event, user, game, group, group2, count, text); } while(0)
+
+// Log Text Message (Arguments aren't evaluated for disabled Levels)
+#define log_text(level, ...) do { if(log_enabled(level)) write_text_log(level, __VA_ARGS__); } while(0)
+
+/**
+ * Start Log Thread (Records get written synchronously until then)
+ * @return 0 on Success or -1 on Error
+ */
+int start_logger(void);
+
+/**
+ * Stop Log Thread (writes the buffered Records first)
+ */
+void stop_logger(void);
+
+/**
+ * Write User Event Record (use log_user)
+ * @param level Log Level
+ * @param event Log Event
+ * @param user User Node (NULL if none)
+ * @param game Game Product Code (NULL if none)
+ * @param group Group Name (NULL if none)
+ * @param group2 Previous Group Name (NULL if none)
+ * @param count Event Counter
+ * @param text Free Text (NULL if none)
+ */
+void write_user_log(int level, int event, SceNetAdhocctlUserNode * user, const SceNetAdhocctlProductCode * game, const SceNetAdhocctlGroupName * group, const SceNetAdhocctlGroupName * group2, int32_t count, const char * text);
+
+/**
+ * Escape JSON String Sequences
+ * @param out Out Buffer
+ * @param in In Buffer
+ * @param size Size of Out Buffer
+ * @return Reference to Out Buffer
+ */
+const char * strcpyjson(char * out, const char * in, uint32_t size);
+
+/**
+ * Write Text Message Record (use log_text)
+ * @param level Log Level
+ * @param format printf Format
+ */
+void write_text_log(int level, const char * format, ...) __attribute__((format(printf, 2, 3)));
+
+#endif
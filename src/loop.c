@@ -0,0 +1,672 @@
+/*
+ * This file is part of PRO ONLINE.
+
+ * PRO ONLINE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * PRO ONLINE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PRO ONLINE. If not, see <http://www.gnu.org/licenses/ .
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <netinet/in.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <config.h>
+#include <user.h>
+#include <status.h>
+#include <catalog.h>
+#include <log.h>
+#include <http.h>
+#include <metrics.h>
+#include <worker.h>
+#include <loop.h>
+#include <trace.h>
+#include <settings.h>
+#include <uring.h>
+
+// Server Status
+volatile int _status = 0;
+
+// Loop Clock of the calling Thread
+__thread uint64_t _loop_clock = 0;
+
+// Event Poll of the calling Thread
+static __thread int _loop_epoll = -1;
+
+// Event Source Tags (Non-User Event Sources)
+static int _event_listener = 0;
+static int _event_http = 0;
+static int _event_housekeeping = 0;
+static int _event_wakeup = 0;
+static int _event_status = 0;
+
+// Packet Handler (returns 0 on Success or -1 if the User was logged out)
+typedef int (*SceNetAdhocctlPacketHandler)(SceNetAdhocctlUserNode * user, const uint8_t * packet);
+
+// Packet Dispatch Entry
+typedef struct
+{
+	// Required User State
+	int state;
+	
+	// Fixed Packet Size
+	uint32_t size;
+	
+	// Packet Handler
+	SceNetAdhocctlPacketHandler handler;
+} SceNetAdhocctlPacketType;
+
+// Function Prototypes
+void accept_users(int server);
+void receive_user_data(SceNetAdhocctlUserNode * user);
+int handle_ping(SceNetAdhocctlUserNode * user, const uint8_t * packet);
+int handle_login(SceNetAdhocctlUserNode * user, const uint8_t * packet);
+int handle_connect(SceNetAdhocctlUserNode * user, const uint8_t * packet);
+int handle_disconnect(SceNetAdhocctlUserNode * user, const uint8_t * packet);
+int handle_scan(SceNetAdhocctlUserNode * user, const uint8_t * packet);
+int handle_chat(SceNetAdhocctlUserNode * user, const uint8_t * packet);
+int next_user_timeout(void);
+void timeout_users(void);
+
+// Packet Dispatch Table (indexed by Opcode)
+static const SceNetAdhocctlPacketType _packet_types[] = {
+	[OPCODE_PING] = { USER_STATE_LOGGED_IN, 1, handle_ping },
+	[OPCODE_LOGIN] = { USER_STATE_WAITING, sizeof(SceNetAdhocctlLoginPacketC2S), handle_login },
+	[OPCODE_CONNECT] = { USER_STATE_LOGGED_IN, sizeof(SceNetAdhocctlConnectPacketC2S), handle_connect },
+	[OPCODE_DISCONNECT] = { USER_STATE_LOGGED_IN, 1, handle_disconnect },
+	[OPCODE_SCAN] = { USER_STATE_LOGGED_IN, 1, handle_scan },
+	[OPCODE_CHAT] = { USER_STATE_LOGGED_IN, sizeof(SceNetAdhocctlChatPacketC2S), handle_chat },
+};
+
+/**
+ * Run Event Loop until Shutdown
+ * @param server Server Listening Socket (-1 for Worker Loops)
+ * @param http HTTP Listening Socket (-1 if disabled or for Worker Loops)
+ * @param worker Worker (NULL for the Acceptor Loop)
+ * @return OS Error Code
+ */
+int run_event_loop(int server, int http, SceNetAdhocctlWorker * worker)
+{
+	// Create Event Poll
+	int epoll = epoll_create1(0);
+	
+	// Create Housekeeping Timer (Acceptor only, User Timeouts are tracked by the Idle List)
+	int timer = (server != -1) ? timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK) : -1;
+	
+	// Event Sources unavailable
+	if(epoll == -1 || (server != -1 && timer == -1))
+	{
+		// Notify User
+		log_text(LOG_LEVEL_ERROR, "%s: epoll_create1 returned %d, timerfd_create returned %d.", __func__, epoll, timer);
+		
+		// Close Event Sources
+		if(epoll != -1) close(epoll);
+		if(timer != -1) close(timer);
+		
+		// Return Error
+		return -1;
+	}
+	
+	// Save Event Poll for this Thread
+	_loop_epoll = epoll;
+	
+	// Move User Sockets to an I/O Ring (stays on the Event Poll if the Kernel lacks Ring Features)
+	if(_settings.uring) start_uring(epoll, server);
+	
+	// Count Metrics on own Counters (shares the Fallback Counters if out of Memory)
+	if(worker == NULL) register_metrics("acceptor");
+	else
+	{
+		// Name Counters after the Worker
+		char name[16];
+		snprintf(name, sizeof(name), "worker%u", (uint32_t)(worker - _workers));
+		register_metrics(name);
+	}
+	
+	// Initialize Loop Clock
+	update_loop_clock();
+	
+	// Event Template
+	struct epoll_event event;
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	
+	// Acceptor Event Sources
+	if(server != -1)
+	{
+		// Fire Housekeeping Timer every Second
+		struct itimerspec interval;
+		memset(&interval, 0, sizeof(interval));
+		interval.it_value.tv_sec = 1;
+		interval.it_interval.tv_sec = 1;
+		timerfd_settime(timer, 0, &interval, NULL);
+		
+		// Watch Housekeeping Timer
+		event.data.ptr = &_event_housekeeping;
+		epoll_ctl(epoll, EPOLL_CTL_ADD, timer, &event);
+		
+		// Watch Listening Socket (the I/O Ring accepts Logins itself)
+		if(!_uring_active)
+		{
+			event.data.ptr = &_event_listener;
+			epoll_ctl(epoll, EPOLL_CTL_ADD, server, &event);
+		}
+		
+		// Watch Status Flush Timer
+		if(_status_timer != -1)
+		{
+			event.data.ptr = &_event_status;
+			epoll_ctl(epoll, EPOLL_CTL_ADD, _status_timer, &event);
+		}
+		
+		// Watch HTTP Listening Socket
+		if(http != -1)
+		{
+			event.data.ptr = &_event_http;
+			epoll_ctl(epoll, EPOLL_CTL_ADD, http, &event);
+		}
+	}
+	
+	// Watch Wakeup Event
+	if(worker != NULL)
+	{
+		event.data.ptr = &_event_wakeup;
+		epoll_ctl(epoll, EPOLL_CTL_ADD, worker->wakeup, &event);
+	}
+	
+	// Handling Loop
+	while(_status == 1)
+	{
+		// Ready Events
+		struct epoll_event events[SERVER_EVENT_BATCH];
+		
+		// Ready Event Count
+		int count = 0;
+		
+		// Wait for Events until the next User Timeout (interrupted by Shutdown Signals, the I/O Ring polls the Event Poll)
+		if(_uring_active) wait_uring(next_user_timeout());
+		else count = epoll_wait(epoll, events, SERVER_EVENT_BATCH, next_user_timeout());
+		
+		// Read Loop Clock (shared by everything in this Iteration)
+		uint64_t start = update_loop_clock();
+		
+		// Lock Worker Database (Status Rendering reads it from the Acceptor)
+		if(worker != NULL) pthread_mutex_lock(&worker->lock);
+		
+		// Process Ring Completions, then collect the Event Poll Events (without waiting)
+		if(_uring_active && process_uring(server)) count = epoll_wait(epoll, events, SERVER_EVENT_BATCH, 0);
+		
+		// Housekeeping Flag
+		int housekeeping = 0;
+		
+		// Iterate Ready Events
+		int i = 0; for(; i < count; i++)
+		{
+			// Login Requests
+			if(events[i].data.ptr == &_event_listener) accept_users(server);
+			
+			// HTTP Requests
+			else if(events[i].data.ptr == &_event_http) accept_http_clients(http);
+			
+			// Housekeeping Timer
+			else if(events[i].data.ptr == &_event_housekeeping)
+			{
+				// Acknowledge Timer Expiration
+				uint64_t expirations = 0;
+				read(timer, &expirations, sizeof(expirations));
+				
+				// Delay Housekeeping until all Events were processed
+				housekeeping = 1;
+			}
+			
+			// Status Flush Timer (hands pending Status Changes to the Status Writer)
+			else if(events[i].data.ptr == &_event_status) flush_status();
+			
+			// Handoffs or Shutdown
+			else if(events[i].data.ptr == &_event_wakeup)
+			{
+				// Acknowledge Wakeup
+				uint64_t wakeups = 0;
+				read(worker->wakeup, &wakeups, sizeof(wakeups));
+				
+				// Adopt handed-over Users
+				adopt_users(worker);
+			}
+			
+			// HTTP Client Socket
+			else if(find_http_client(events[i].data.ptr) != NULL) process_http_client((SceNetAdhocctlHttpClient *)events[i].data.ptr, events[i].events);
+			
+			// User Socket
+			else
+			{
+				// User Node
+				SceNetAdhocctlUserNode * user = (SceNetAdhocctlUserNode *)events[i].data.ptr;
+				
+				// Socket became writable
+				if(events[i].events & EPOLLOUT) flush_user_txbuf(user);
+				
+				// Receive Data from User (also picks up Hangups and Errors)
+				if(events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) receive_user_data(user);
+			}
+		}
+		
+		// Logout Timed-Out Users (after the Batch, it might have heard from them)
+		timeout_users();
+		
+		// Housekeeping
+		if(housekeeping)
+		{
+			// Close stalled HTTP Clients (Acceptor only)
+			if(server != -1) expire_http_clients();
+			
+			// Reload Product Catalog on Request (Acceptor only)
+			if(server != -1 && _catalog_reload)
+			{
+				// Clear Request
+				_catalog_reload = 0;
+				
+				// Start Background Reload
+				reload_catalog();
+			}
+		}
+		
+		// Prepare Sends of this Iteration (submitted together by the next Wait)
+		if(_uring_active) flush_uring(server);
+		
+		// Unlock Worker Database
+		if(worker != NULL) pthread_mutex_unlock(&worker->lock);
+		
+		// Count Iteration Duration
+		observe_loop_duration(start);
+	}
+	
+	// Close HTTP Clients (Acceptor only)
+	if(server != -1) close_http_clients();
+	
+	// Stop I/O Ring
+	if(_uring_active) stop_uring();
+	
+	// Close Event Sources
+	if(timer != -1) close(timer);
+	close(epoll);
+	
+	// Forget Event Poll
+	_loop_epoll = -1;
+	
+	// Return Success
+	return 0;
+}
+
+/**
+ * Watch User Socket in the Event Loop of the calling Thread
+ * @param user User Node
+ */
+void watch_user(SceNetAdhocctlUserNode * user)
+{
+	// Receive through the I/O Ring
+	if(_uring_active) watch_uring_user(user);
+	
+	// Watch User Socket (the User Node is the Event Tag)
+	else watch_socket(user->stream, user);
+}
+
+/**
+ * Watch Stream Socket in the Event Loop of the calling Thread
+ * @param fd Socket
+ * @param tag Event Tag
+ */
+void watch_socket(int fd, void * tag)
+{
+	// Edge-Triggered (drained until EAGAIN) - Writability flushes the TX Queue
+	struct epoll_event event;
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+	event.data.ptr = tag;
+	
+	// Add Socket to Event Poll
+	epoll_ctl(_loop_epoll, EPOLL_CTL_ADD, fd, &event);
+}
+
+/**
+ * Stop watching User Socket in the Event Loop of the calling Thread
+ * @param user User Node
+ */
+void unwatch_user(SceNetAdhocctlUserNode * user)
+{
+	// Cancel Ring Operations
+	if(_uring_active) unwatch_uring_user(user);
+	
+	// Remove Socket from Event Poll
+	else epoll_ctl(_loop_epoll, EPOLL_CTL_DEL, user->stream, NULL);
+}
+
+/**
+ * Accept pending Login Requests
+ * @param server Server Listening Socket
+ */
+void accept_users(int server)
+{
+	// Login Result
+	int loginresult = 0;
+	
+	// Login Processing Loop
+	do
+	{
+		// Prepare Address Structure
+		struct sockaddr_in addr;
+		socklen_t addrlen = sizeof(addr);
+		memset(&addr, 0, sizeof(addr));
+		
+		// Accept Login Requests
+		// loginresult = accept4(server, (struct sockaddr *)&addr, &addrlen, SOCK_NONBLOCK);
+		
+		// Alternative Accept Approach (some Linux Kernel don't support the accept4 Syscall... wtf?)
+		loginresult = accept(server, (struct sockaddr *)&addr, &addrlen);
+		if(loginresult != -1)
+		{
+			// Switch Socket into Non-Blocking Mode
+			change_blocking_mode(loginresult, 1);
+			
+			// Login User (Stream)
+			SceNetAdhocctlUserNode * user = login_user_stream(loginresult, addr.sin_addr.s_addr);
+			
+			// Watch User Socket
+			if(user != NULL) watch_user(user);
+		}
+	} while(loginresult != -1);
+}
+
+/**
+ * Receive and Process all available Data from User
+ * @param user User Node
+ */
+void receive_user_data(SceNetAdhocctlUserNode * user)
+{
+	// Drain Socket (required for Edge-Triggered Notifications)
+	while(1)
+	{
+		// Free Space behind the Ring Tail (wraps around at most once)
+		uint32_t tail = user->rxtail & (USER_RXBUF_SIZE - 1);
+		uint32_t space = USER_RXBUF_SIZE - (uint16_t)(user->rxtail - user->rxhead);
+		struct iovec iov[2];
+		iov[0].iov_base = user->info->rx + tail;
+		iov[0].iov_len = USER_RXBUF_SIZE - tail;
+		if(iov[0].iov_len > space) iov[0].iov_len = space;
+		iov[1].iov_base = user->info->rx;
+		iov[1].iov_len = space - iov[0].iov_len;
+		
+		// Receive Data from User
+		int recvresult = readv(user->stream, iov, (iov[1].iov_len > 0) ? 2 : 1);
+		
+		// No more Data available
+		if(recvresult == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+		
+		// Connection Closed, Failed or Timed Out
+		if(recvresult <= 0 || get_user_state(user) == USER_STATE_TIMED_OUT)
+		{
+			// Count Timeout
+			if(get_user_state(user) == USER_STATE_TIMED_OUT) count_metric(timeouts, 1);
+			
+			// Logout User
+			logout_user(user);
+			
+			// Stop Processing
+			return;
+		}
+		
+		// Move Ring Tail
+		user->rxtail += recvresult;
+		
+		// Update Death Clock
+		touch_user(user);
+		
+		// Process all complete Packets (stop if the User was logged out)
+		if(process_user_packets(user) == -1) return;
+	}
+}
+
+/**
+ * Process all complete Packets in the User RX Ring
+ * @param user User Node
+ * @return 0 on Success or -1 if the User was logged out (or handed to a Worker Thread)
+ */
+int process_user_packets(SceNetAdhocctlUserNode * user)
+{
+	// Process Packets until the RX Ring runs dry
+	while(1)
+	{
+		// Buffered Data
+		uint32_t fill = (uint16_t)(user->rxtail - user->rxhead);
+		
+		// Empty RX Ring
+		if(fill == 0) return 0;
+		
+		// Packet Offset & Opcode
+		uint32_t offset = user->rxhead & (USER_RXBUF_SIZE - 1);
+		uint8_t opcode = user->info->rx[offset];
+		
+		// User State
+		int state = get_user_state(user);
+		
+		// Packet Type
+		const SceNetAdhocctlPacketType * type = NULL;
+		if(opcode < sizeof(_packet_types) / sizeof(_packet_types[0]) && _packet_types[opcode].handler != NULL && _packet_types[opcode].state == state) type = &_packet_types[opcode];
+		
+		// Invalid Opcode or Timed Out
+		if(type == NULL)
+		{
+			// Count Drop
+			if(state == USER_STATE_TIMED_OUT) count_metric(timeouts, 1);
+			else count_metric(badopcodes, 1);
+			
+			// Notify User (Timed-Out Users are dropped silently)
+			if(state != USER_STATE_TIMED_OUT) log_user(LOG_LEVEL_WARNING, LOG_EVENT_OPCODE_INVALID, user, (user->game != NULL) ? &user->game->game : NULL, NULL, NULL, opcode, NULL);
+			
+			// Logout User
+			logout_user(user);
+			
+			// Return Logout
+			return -1;
+		}
+		
+		// Not enough Data available
+		if(fill < type->size) return 0;
+		
+		// Packet lies contiguous in the Ring
+		const uint8_t * packet = user->info->rx + offset;
+		
+		// Packet wraps around the Ring End (reassemble it on the Stack)
+		uint8_t wrapped[USER_RXBUF_SIZE];
+		if(offset + type->size > USER_RXBUF_SIZE)
+		{
+			memcpy(wrapped, user->info->rx + offset, USER_RXBUF_SIZE - offset);
+			memcpy(wrapped + USER_RXBUF_SIZE - offset, user->info->rx, offset + type->size - USER_RXBUF_SIZE);
+			packet = wrapped;
+		}
+		
+		// Consume Packet (before the Handler, which might free the User)
+		user->rxhead += type->size;
+		
+		// Count Packet
+		count_metric(rxpackets[opcode], 1);
+		count_metric(rxbytes[opcode], type->size);
+		
+		// Record Packet
+		trace_user(TRACE_RECORD_PACKET, user, packet, type->size);
+		
+		// Dispatch Packet
+		if(type->handler(user, packet) == -1) return -1;
+	}
+}
+
+/**
+ * Handle Ping Packet
+ * @param user User Node
+ * @param packet Packet
+ * @return 0 on Success
+ */
+int handle_ping(SceNetAdhocctlUserNode * user, const uint8_t * packet)
+{
+	// Death Clock was already updated on Receive
+	return 0;
+}
+
+/**
+ * Handle Login Packet
+ * @param user User Node
+ * @param packet Packet
+ * @return 0 on Success or -1 if the User was logged out (or handed to a Worker Thread)
+ */
+int handle_login(SceNetAdhocctlUserNode * user, const uint8_t * packet)
+{
+	// Clone Packet (the Ring Space is reused once the User was handed off)
+	SceNetAdhocctlLoginPacketC2S login = *(const SceNetAdhocctlLoginPacketC2S *)packet;
+	
+	// Login User (Data)
+	return login_user_data(user, &login);
+}
+
+/**
+ * Handle Group Connect Packet
+ * @param user User Node
+ * @param packet Packet
+ * @return 0 on Success or -1 if the User was logged out
+ */
+int handle_connect(SceNetAdhocctlUserNode * user, const uint8_t * packet)
+{
+	// Clone Group Name
+	SceNetAdhocctlGroupName group = ((const SceNetAdhocctlConnectPacketC2S *)packet)->group;
+	
+	// Change Game Group
+	return connect_user(user, &group);
+}
+
+/**
+ * Handle Group Disconnect Packet
+ * @param user User Node
+ * @param packet Packet
+ * @return 0 on Success or -1 if the User was logged out
+ */
+int handle_disconnect(SceNetAdhocctlUserNode * user, const uint8_t * packet)
+{
+	// Leave Game Group
+	return disconnect_user(user);
+}
+
+/**
+ * Handle Network Scan Packet
+ * @param user User Node
+ * @param packet Packet
+ * @return 0 on Success or -1 if the User was logged out
+ */
+int handle_scan(SceNetAdhocctlUserNode * user, const uint8_t * packet)
+{
+	// Send Network List
+	return send_scan_results(user);
+}
+
+/**
+ * Handle Chat Text Packet
+ * @param user User Node
+ * @param packet Packet
+ * @return 0 on Success or -1 if the User was logged out
+ */
+int handle_chat(SceNetAdhocctlUserNode * user, const uint8_t * packet)
+{
+	// Clone Buffer for Message
+	char message[64];
+	memset(message, 0, sizeof(message));
+	strncpy(message, ((const SceNetAdhocctlChatPacketC2S *)packet)->message, sizeof(message) - 1);
+	
+	// Spread Chat Message
+	return spread_message(user, message);
+}
+
+/**
+ * Read Loop Clock of the calling Thread
+ * @return Monotonic Time (Nanoseconds)
+ */
+uint64_t update_loop_clock(void)
+{
+	// Monotonic Time (immune to Wall Clock Jumps)
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	
+	// Convert to Milliseconds
+	_loop_clock = (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+	
+	// Return Nanoseconds
+	return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+/**
+ * Get Time until the next User Timeout
+ * @return Milliseconds (for epoll_wait) or -1 if no User is connected
+ */
+int next_user_timeout(void)
+{
+	// No Users
+	if(_db_user_idle == NULL) return -1;
+	
+	// Deadline of the least recently heard from User
+	uint64_t deadline = _db_user_idle->last_recv + _settings.timeout * 1000ULL;
+	
+	// Deadline passed
+	if(deadline <= _loop_clock) return 0;
+	
+	// Time until Deadline (at most the User Timeout)
+	return (int)(deadline - _loop_clock);
+}
+
+/**
+ * Logout Timed-Out Users (only touches expired Users)
+ */
+void timeout_users(void)
+{
+	// Logout least recently heard from Users until the first live one
+	while(_db_user_idle != NULL && get_user_state(_db_user_idle) == USER_STATE_TIMED_OUT)
+	{
+		// Count Timeout
+		count_metric(timeouts, 1);
+		
+		// Logout User
+		logout_user(_db_user_idle);
+	}
+}
+
+/**
+ * Change Socket Blocking Mode
+ * @param fd Socket
+ * @param nonblocking 1 for Nonblocking, 0 for Blocking
+ */
+void change_blocking_mode(int fd, int nonblocking)
+{
+	// Change to Non-Blocking Mode
+	if(nonblocking) fcntl(fd, F_SETFL, O_NONBLOCK);
+
+	// Change to Blocking Mode
+	else
+	{
+		// Get Flags
+		int flags = fcntl(fd, F_GETFL);
+
+		// Remove Non-Blocking Flag
+		fcntl(fd, F_SETFL, flags & ~O_NONBLOCK);
+	}
+}
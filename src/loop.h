@@ -0,0 +1,79 @@
+/*
+ * This file is part of PRO ONLINE.
+
+ * PRO ONLINE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * PRO ONLINE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PRO ONLINE. If not, see <http://www.gnu.org/licenses/ .
+ */
+
+#ifndef _LOOP_H_
+#define _LOOP_H_
+
+#include <stdint.h>
+#include <user.h>
+#include <worker.h>
+
+// Server Status
+extern volatile int _status;
+
+// Loop Clock of the calling Thread (Monotonic Milliseconds, read once per Loop Iteration)
+extern __thread uint64_t _loop_clock;
+
+/**
+ * Run Event Loop until Shutdown
+ * @param server Server Listening Socket (-1 for Worker Loops)
+ * @param http HTTP Listening Socket (-1 if disabled or for Worker Loops)
+ * @param worker Worker (NULL for the Acceptor Loop)
+ * @return OS Error Code
+ */
+int run_event_loop(int server, int http, SceNetAdhocctlWorker * worker);
+
+/**
+ * Read Loop Clock of the calling Thread
+ * @return Monotonic Time (Nanoseconds)
+ */
+uint64_t update_loop_clock(void);
+
+/**
+ * Watch Stream Socket in the Event Loop of the calling Thread
+ * @param fd Socket
+ * @param tag Event Tag
+ */
+void watch_socket(int fd, void * tag);
+
+/**
+ * Watch User Socket in the Event Loop of the calling Thread
+ * @param user User Node
+ */
+void watch_user(SceNetAdhocctlUserNode * user);
+
+/**
+ * Stop watching User Socket in the Event Loop of the calling Thread
+ * @param user User Node
+ */
+void unwatch_user(SceNetAdhocctlUserNode * user);
+
+/**
+ * Process all complete Packets in the User RX Buffer
+ * @param user User Node
+ * @return 0 on Success or -1 if the User was logged out (or handed to a Worker Thread)
+ */
+int process_user_packets(SceNetAdhocctlUserNode * user);
+
+/**
+ * Change Socket Blocking Mode
+ * @param fd Socket
+ * @param nonblocking 1 for Nonblocking, 0 for Blocking
+ */
+void change_blocking_mode(int fd, int nonblocking);
+
+#endif
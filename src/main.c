@@ -23,24 +23,31 @@
 #include <malloc.h>
 #endif
 
+#include <unistd.h>
+#include <pthread.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
-#include <fcntl.h>
+#include <arpa/inet.h>
 #include <errno.h>
 #include <config.h>
 #include <user.h>
 #include <status.h>
-
-// Server Status
-int _status = 0;
+#include <catalog.h>
+#include <worker.h>
+#include <loop.h>
+#include <log.h>
+#include <metrics.h>
+#include <feed.h>
+#include <trace.h>
+#include <settings.h>
 
 // Function Prototypes
 void interrupt(int sig);
+void reload(int sig);
 void enable_address_reuse(int fd);
-void change_blocking_mode(int fd, int nonblocking);
-int create_listen_socket(uint16_t port);
-int server_loop(int server);
+int create_listen_socket(uint32_t address, uint16_t port);
+int server_loop(int server, int http);
 
 /**
  * Server Entry Point
@@ -52,9 +59,25 @@ int main(int argc, char * argv[])
 {
 	// Result
 	int result = 0;
+	
+	// Load Settings (Config File & Command Line)
+	int settings = load_settings(argc, argv);
+	
+	// Help requested or invalid Settings
+	if(settings != 0) return (settings == 1) ? 0 : 1;
 
-	// Don't buffer output to console
-	setbuf(stdout, NULL);
+	// Start Log Thread (Console Output happens there)
+	start_logger();
+	
+	// Fit the User Maximum into the Descriptor Limit
+	if(apply_descriptor_limit() == -1)
+	{
+		// Stop Log Thread
+		stop_logger();
+		
+		// Return Error
+		return 1;
+	}
 
 	// Create Signal Receiver for CTRL + C
 	signal(SIGINT, interrupt);
@@ -62,22 +85,34 @@ int main(int argc, char * argv[])
 	// Create Signal Receiver for kill / killall
 	signal(SIGTERM, interrupt);
 	
+	// Create Signal Receiver for Product Catalog Reloads
+	signal(SIGHUP, reload);
+	
 	// Create Listening Socket
-	int server = create_listen_socket(SERVER_PORT);
+	int server = create_listen_socket(INADDR_ANY, _settings.port);
 	
 	// Created Listening Socket
 	if(server != -1)
 	{
 		// Notify User
-		printf("Listening for Connections on TCP Port %u.\n", SERVER_PORT);
+		log_text(LOG_LEVEL_INFO, "Listening for up to %u Connections on TCP Port %u.", _settings.usermax, _settings.port);
+		
+		// Create HTTP Listening Socket (the Server runs without Metrics & Status API if it fails)
+		int http = (_settings.httpport != 0) ? create_listen_socket(_settings.httpaddress, _settings.httpport) : -1;
+		
+		// Notify User
+		if(http != -1) log_text(LOG_LEVEL_INFO, "Serving Metrics & Status on HTTP Address %s Port %u.", inet_ntoa((struct in_addr){ _settings.httpaddress }), _settings.httpport);
 		
 		// Enter Server Loop
-		result = server_loop(server);
+		result = server_loop(server, http);
 		
 		// Notify User
-		printf("Shutdown complete.\n");
+		log_text(LOG_LEVEL_INFO, "Shutdown complete.");
 	}
 	
+	// Stop Log Thread (writes the remaining Records)
+	stop_logger();
+	
 	// Return Result
 	return result;
 }
@@ -88,13 +123,20 @@ int main(int argc, char * argv[])
  */
 void interrupt(int sig)
 {
-	// Notify User
-	printf("Shutting down... please wait.\n");
-	
-	// Trigger Shutdown
+	// Trigger Shutdown (the Acceptor Loop notifies the User once it stops)
 	_status = 0;
 }
 
+/**
+ * Product Catalog Reload Request Handler
+ * @param sig Captured Signal
+ */
+void reload(int sig)
+{
+	// Request Reload (the Acceptor picks it up during Housekeeping)
+	_catalog_reload = 1;
+}
+
 /**
  * Enable Address Reuse on Socket
  * @param fd Socket
@@ -108,33 +150,13 @@ void enable_address_reuse(int fd)
 	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
 }
 
-/**
- * Change Socket Blocking Mode
- * @param fd Socket
- * @param nonblocking 1 for Nonblocking, 0 for Blocking
- */
-void change_blocking_mode(int fd, int nonblocking)
-{
-	// Change to Non-Blocking Mode
-	if(nonblocking) fcntl(fd, F_SETFL, O_NONBLOCK);
-
-	// Change to Blocking Mode
-	else
-	{
-		// Get Flags
-		int flags = fcntl(fd, F_GETFL);
-
-		// Remove Non-Blocking Flag
-		fcntl(fd, F_SETFL, flags & ~O_NONBLOCK);
-	}
-}
-
 /**
  * Create Port-Bound Listening Socket
+ * @param address IPv4 Address (Network Byte Order)
  * @param port TCP Port
  * @return Socket Descriptor
  */
-int create_listen_socket(uint16_t port)
+int create_listen_socket(uint32_t address, uint16_t port)
 {
 	// Create Socket
 	int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
@@ -152,7 +174,7 @@ int create_listen_socket(uint16_t port)
 		struct sockaddr_in local;
 		memset(&local, 0, sizeof(local));
 		local.sin_family = AF_INET;
-		local.sin_addr.s_addr = INADDR_ANY;
+		local.sin_addr.s_addr = address;
 		local.sin_port = htons(port);
 		
 		// Bind Local Address to Socket
@@ -162,21 +184,21 @@ int create_listen_socket(uint16_t port)
 		if(bindresult != -1)
 		{
 			// Switch Socket into Listening Mode
-			listen(fd, SERVER_LISTEN_BACKLOG);
+			listen(fd, _settings.backlog);
 			
 			// Return Socket
 			return fd;
 		}
 		
 		// Notify User
-		else printf("%s: bind returned %d.\n", __func__, bindresult);
+		else log_text(LOG_LEVEL_ERROR, "%s: bind returned %d.", __func__, bindresult);
 		
 		// Close Socket
 		close(fd);
 	}
 	
 	// Notify User
-	else printf("%s: socket returned %d.\n", __func__, fd);
+	else log_text(LOG_LEVEL_ERROR, "%s: socket returned %d.", __func__, fd);
 	
 	// Return Error
 	return -1;
@@ -185,209 +207,106 @@ int create_listen_socket(uint16_t port)
 /**
  * Server Main Loop
  * @param server Server Listening Socket
+ * @param http HTTP Listening Socket (-1 if disabled)
  * @return OS Error Code
  */
-int server_loop(int server)
+int server_loop(int server, int http)
 {
 	// Set Running Status
 	_status = 1;
 	
-	// Create Empty Status Logfile
-	update_status();
+	// Start Status Writer (creates an Empty Status Logfile)
+	if(start_status_writer() == -1)
+	{
+		// Close Listening Sockets
+		if(http != -1) close(http);
+		close(server);
+		
+		// Return Error
+		return -1;
+	}
 	
-	// Handling Loop
-	while(_status == 1)
+	// Allocate Node Pools
+	if(init_database() == -1)
 	{
-		// Login Block
-		{
-			// Login Result
-			int loginresult = 0;
-			
-			// Login Processing Loop
-			do
-			{
-				// Prepare Address Structure
-				struct sockaddr_in addr;
-				socklen_t addrlen = sizeof(addr);
-				memset(&addr, 0, sizeof(addr));
-				
-				// Accept Login Requests
-				// loginresult = accept4(server, (struct sockaddr *)&addr, &addrlen, SOCK_NONBLOCK);
-				
-				// Alternative Accept Approach (some Linux Kernel don't support the accept4 Syscall... wtf?)
-				loginresult = accept(server, (struct sockaddr *)&addr, &addrlen);
-				if(loginresult != -1)
-				{
-					// Switch Socket into Non-Blocking Mode
-					change_blocking_mode(loginresult, 1);
-				}
-				
-				// Login User (Stream)
-				if(loginresult != -1) login_user_stream(loginresult, addr.sin_addr.s_addr);
-			} while(loginresult != -1);
-		}
+		// Notify User
+		log_text(LOG_LEVEL_ERROR, "%s: out of memory for %u users.", __func__, _settings.usermax);
 		
-		// Receive Data from Users
-		SceNetAdhocctlUserNode * user = _db_user;
-		while(user != NULL)
-		{
-			// Next User (for safe delete)
-			SceNetAdhocctlUserNode * next = user->next;
-			
-			// Receive Data from User
-			int recvresult = recv(user->stream, user->rx + user->rxpos, sizeof(user->rx) - user->rxpos, 0);
-			
-			// Connection Closed or Timed Out
-			if(recvresult == 0 || (recvresult == -1 && errno != EAGAIN && errno != EWOULDBLOCK) || get_user_state(user) == USER_STATE_TIMED_OUT)
-			{
-				// Logout User
-				logout_user(user);
-			}
-			
-			// Received Data (or leftovers in RX-Buffer)
-			else if(recvresult > 0 || user->rxpos > 0)
-			{
-				// New Incoming Data
-				if(recvresult > 0)
-				{
-					// Move RX Pointer
-					user->rxpos += recvresult;
-					
-					// Update Death Clock
-					user->last_recv = time(NULL);
-				}
-				
-				// Waiting for Login Packet
-				if(get_user_state(user) == USER_STATE_WAITING)
-				{
-					// Valid Opcode
-					if(user->rx[0] == OPCODE_LOGIN)
-					{
-						// Enough Data available
-						if(user->rxpos >= sizeof(SceNetAdhocctlLoginPacketC2S))
-						{
-							// Clone Packet
-							SceNetAdhocctlLoginPacketC2S packet = *(SceNetAdhocctlLoginPacketC2S *)user->rx;
-							
-							// Remove Packet from RX Buffer
-							clear_user_rxbuf(user, sizeof(SceNetAdhocctlLoginPacketC2S));
-							
-							// Login User (Data)
-							login_user_data(user, &packet);
-						}
-					}
-					
-					// Invalid Opcode
-					else
-					{
-						// Notify User
-						uint8_t * ip = (uint8_t *)&user->resolver.ip;
-						printf("Invalid Opcode 0x%02X in Waiting State from %u.%u.%u.%u.\n", user->rx[0], ip[0], ip[1], ip[2], ip[3]);
-						
-						// Logout User
-						logout_user(user);
-					}
-				}
-				
-				// Logged-In User
-				else if(get_user_state(user) == USER_STATE_LOGGED_IN)
-				{
-					// Ping Packet
-					if(user->rx[0] == OPCODE_PING)
-					{
-						// Delete Packet from RX Buffer
-						clear_user_rxbuf(user, 1);
-					}
-					
-					// Group Connect Packet
-					else if(user->rx[0] == OPCODE_CONNECT)
-					{
-						// Enough Data available
-						if(user->rxpos >= sizeof(SceNetAdhocctlConnectPacketC2S))
-						{
-							// Cast Packet
-							SceNetAdhocctlConnectPacketC2S * packet = (SceNetAdhocctlConnectPacketC2S *)user->rx;
-							
-							// Clone Group Name
-							SceNetAdhocctlGroupName group = packet->group;
-							
-							// Remove Packet from RX Buffer
-							clear_user_rxbuf(user, sizeof(SceNetAdhocctlConnectPacketC2S));
-							
-							// Change Game Group
-							connect_user(user, &group);
-						}
-					}
-					
-					// Group Disconnect Packet
-					else if(user->rx[0] == OPCODE_DISCONNECT)
-					{
-						// Remove Packet from RX Buffer
-						clear_user_rxbuf(user, 1);
-						
-						// Leave Game Group
-						disconnect_user(user);
-					}
-					
-					// Network Scan Packet
-					else if(user->rx[0] == OPCODE_SCAN)
-					{
-						// Remove Packet from RX Buffer
-						clear_user_rxbuf(user, 1);
-						
-						// Send Network List
-						send_scan_results(user);
-					}
-					
-					// Chat Text Packet
-					else if(user->rx[0] == OPCODE_CHAT)
-					{
-						// Enough Data available
-						if(user->rxpos >= sizeof(SceNetAdhocctlChatPacketC2S))
-						{
-							// Cast Packet
-							SceNetAdhocctlChatPacketC2S * packet = (SceNetAdhocctlChatPacketC2S *)user->rx;
-							
-							// Clone Buffer for Message
-							char message[64];
-							memset(message, 0, sizeof(message));
-							strncpy(message, packet->message, sizeof(message) - 1);
-							
-							// Remove Packet from RX Buffer
-							clear_user_rxbuf(user, sizeof(SceNetAdhocctlChatPacketC2S));
-							
-							// Spread Chat Message
-							spread_message(user, message);
-						}
-					}
-					
-					// Invalid Opcode
-					else
-					{
-						// Notify User
-						uint8_t * ip = (uint8_t *)&user->resolver.ip;
-						printf("Invalid Opcode 0x%02X in Logged-In State from %s (MAC: %02X:%02X:%02X:%02X:%02X:%02X - IP: %u.%u.%u.%u).\n", user->rx[0], (char *)user->resolver.name.data, user->resolver.mac.data[0], user->resolver.mac.data[1], user->resolver.mac.data[2], user->resolver.mac.data[3], user->resolver.mac.data[4], user->resolver.mac.data[5], ip[0], ip[1], ip[2], ip[3]);
-
-						// Logout User
-						logout_user(user);
-					}
-				}
-			}
-			
-			// Move Pointer
-			user = next;
-		}
+		// Stop Status Writer
+		stop_status_writer();
+		
+		// Close Listening Sockets
+		if(http != -1) close(http);
+		close(server);
+		
+		// Return Error
+		return -1;
+	}
+	
+	// Load Product Catalog (Logins fall back to the raw Product Code without it)
+	load_catalog();
+	
+	// Start Unknown Product Writer (Logins work without it, they just don't save new Products)
+	start_product_writer();
+	
+	// Create Membership Feed Listening Socket (the Server runs without Feed if it fails)
+	int feed = (_settings.feedport != 0) ? create_listen_socket(_settings.feedaddress, _settings.feedport) : -1;
+	
+	// Start Membership Feed (takes the Listening Socket)
+	if(feed != -1 && start_feed(feed) == 0) log_text(LOG_LEVEL_INFO, "Serving Membership Feed on Address %s Port %u.", inet_ntoa((struct in_addr){ _settings.feedaddress }), _settings.feedport);
+	
+	// Start Traffic Recording (the Server runs without Trace if it fails)
+	if(_settings.trace[0] != 0 && start_trace(_settings.trace) == 0) log_text(LOG_LEVEL_INFO, "Recording Traffic Trace to %s.", _settings.trace);
+	
+	// Start Worker Threads (Sharded Mode)
+	int result = start_workers(_settings.workers);
+	
+	// Started Worker Threads
+	if(result == 0)
+	{
+		// Notify User
+		if(_settings.workers > 0) log_text(LOG_LEVEL_INFO, "Sharding Games across %u Worker Threads.", _settings.workers);
+		
+		// Enter Acceptor Loop
+		result = run_event_loop(server, http, NULL);
 		
-		// Prevent needless CPU Overload (1ms Sleep)
-		usleep(1000);
+		// Notify User
+		log_text(LOG_LEVEL_INFO, "Shutting down... please wait.");
+		
+		// Stop Worker Threads (logs out their Users)
+		stop_workers();
 	}
 	
 	// Free User Database Memory
 	free_database();
 	
+	// Write final Status
+	stop_status_writer();
+	
+	// Commit queued Unknown Products
+	stop_product_writer();
+	
+	// Send remaining Membership Events (after the last Logout)
+	stop_feed();
+	
+	// Write remaining Trace Records (after the last Logout)
+	stop_trace();
+	
+	// Free Product Catalog
+	free_catalog();
+	
+	// Release Node Pools
+	destroy_database();
+	
+	// Free Metric Counters
+	free_metrics();
+	
+	// Close HTTP Socket
+	if(http != -1) close(http);
+	
 	// Close Server Socket
 	close(server);
 	
-	// Return Success
-	return 0;
+	// Return Result
+	return result;
 }
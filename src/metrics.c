@@ -0,0 +1,237 @@
+/*
+ * This file is part of PRO ONLINE.
+
+ * PRO ONLINE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * PRO ONLINE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PRO ONLINE. If not, see <http://www.gnu.org/licenses/ .
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <metrics.h>
+
+// Fallback Counters (Threads without own Counters, like Shutdown Code on the Main Thread)
+SceNetAdhocctlMetrics _metrics_fallback = { NULL, "other" };
+
+// Metric Counters of the calling Thread
+__thread SceNetAdhocctlMetrics * _metrics = &_metrics_fallback;
+
+// Registered Counters (never freed while Loop Threads run, so the Metrics Page can read them)
+static SceNetAdhocctlMetrics * _metrics_list = &_metrics_fallback;
+static pthread_mutex_t _metrics_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Loop Duration Bucket Bounds (Nanoseconds) & Labels
+static const uint64_t _metrics_loop_bound[METRICS_LOOP_BUCKETS - 1] = { 10000, 50000, 100000, 500000, 1000000, 5000000, 10000000, 50000000, 100000000 };
+static const char * _metrics_loop_label[METRICS_LOOP_BUCKETS] = { "1e-05", "5e-05", "0.0001", "0.0005", "0.001", "0.005", "0.01", "0.05", "0.1", "+Inf" };
+
+// Client Opcode Names
+static const char * _metrics_opcode_name[OPCODE_CHAT + 1] = {
+	[OPCODE_PING] = "ping",
+	[OPCODE_LOGIN] = "login",
+	[OPCODE_CONNECT] = "connect",
+	[OPCODE_DISCONNECT] = "disconnect",
+	[OPCODE_SCAN] = "scan",
+	[OPCODE_CHAT] = "chat",
+};
+
+// Server Opcode Names
+static const char * _metrics_tx_opcode_name[OPCODE_CHAT + 1] = {
+	[OPCODE_CONNECT] = "connect",
+	[OPCODE_DISCONNECT] = "disconnect",
+	[OPCODE_SCAN] = "scan",
+	[OPCODE_SCAN_COMPLETE] = "scan_complete",
+	[OPCODE_CONNECT_BSSID] = "connect_bssid",
+	[OPCODE_CHAT] = "chat",
+};
+
+// Function Prototypes
+uint64_t sum_metric(size_t offset);
+void render_metric(SceNetAdhocctlHttpBuffer * out, const char * name, const char * type, const char * help, size_t offset);
+
+/**
+ * Register Metric Counters for the calling Thread
+ * @param name Thread Name
+ * @return 0 on Success or -1 if the Thread keeps sharing the Fallback Counters
+ */
+int register_metrics(const char * name)
+{
+	// Allocate Counters (cleared)
+	SceNetAdhocctlMetrics * metrics = (SceNetAdhocctlMetrics *)calloc(1, sizeof(SceNetAdhocctlMetrics));
+	
+	// Out of Memory
+	if(metrics == NULL) return -1;
+	
+	// Set Thread Name
+	strncpy(metrics->name, name, sizeof(metrics->name) - 1);
+	
+	// Link into Counter List
+	pthread_mutex_lock(&_metrics_lock);
+	metrics->next = _metrics_list;
+	_metrics_list = metrics;
+	pthread_mutex_unlock(&_metrics_lock);
+	
+	// Use Counters on this Thread
+	_metrics = metrics;
+	
+	// Return Success
+	return 0;
+}
+
+/**
+ * Count Loop Iteration Duration
+ * @param start Monotonic Iteration Start (Nanoseconds)
+ */
+void observe_loop_duration(uint64_t start)
+{
+	// Monotonic Time
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	
+	// Iteration Duration
+	uint64_t duration = (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec - start;
+	
+	// Find Bucket (the last one catches everything)
+	uint32_t bucket = 0;
+	while(bucket < METRICS_LOOP_BUCKETS - 1 && duration > _metrics_loop_bound[bucket]) bucket++;
+	
+	// Count Iteration
+	count_metric(loopbuckets[bucket], 1);
+	count_metric(loopcount, 1);
+	count_metric(loopnanoseconds, duration);
+}
+
+/**
+ * Sum Counter over all Threads
+ * @param offset Counter Offset in SceNetAdhocctlMetrics
+ * @return Sum (Gauges are summed as signed Values)
+ */
+uint64_t sum_metric(size_t offset)
+{
+	// Sum
+	uint64_t sum = 0;
+	
+	// Iterate Counters (the List Lock is held by the Caller)
+	SceNetAdhocctlMetrics * metrics = _metrics_list;
+	for(; metrics != NULL; metrics = metrics->next)
+	{
+		// Add Counter
+		sum += __atomic_load_n((uint64_t *)((uint8_t *)metrics + offset), __ATOMIC_RELAXED);
+	}
+	
+	// Return Sum
+	return sum;
+}
+
+/**
+ * Render Metric summed over all Threads
+ * @param out Output Buffer
+ * @param name Metric Name
+ * @param type Metric Type
+ * @param help Metric Description
+ * @param offset Counter Offset in SceNetAdhocctlMetrics
+ */
+void render_metric(SceNetAdhocctlHttpBuffer * out, const char * name, const char * type, const char * help, size_t offset)
+{
+	// Write Header & Value (Gauges may be negative per Thread, but never in Sum)
+	append_http(out, "# HELP %s %s\n# TYPE %s %s\n%s %lld\n", name, help, name, type, name, (long long)sum_metric(offset));
+}
+
+/**
+ * Render Metrics in Prometheus Text Format
+ * @param out Output Buffer
+ */
+void render_metrics(SceNetAdhocctlHttpBuffer * out)
+{
+	// Lock Counter List
+	pthread_mutex_lock(&_metrics_lock);
+	
+	// Packets & Bytes by Opcode
+	append_http(out, "# HELP adhocctl_rx_packets_total Packets received by Opcode.\n# TYPE adhocctl_rx_packets_total counter\n");
+	uint32_t opcode = 0; for(; opcode <= OPCODE_CHAT; opcode++) if(_metrics_opcode_name[opcode] != NULL) append_http(out, "adhocctl_rx_packets_total{opcode=\"%s\"} %llu\n", _metrics_opcode_name[opcode], (unsigned long long)sum_metric(offsetof(SceNetAdhocctlMetrics, rxpackets) + opcode * sizeof(uint64_t)));
+	append_http(out, "# HELP adhocctl_rx_bytes_total Bytes received by Opcode.\n# TYPE adhocctl_rx_bytes_total counter\n");
+	for(opcode = 0; opcode <= OPCODE_CHAT; opcode++) if(_metrics_opcode_name[opcode] != NULL) append_http(out, "adhocctl_rx_bytes_total{opcode=\"%s\"} %llu\n", _metrics_opcode_name[opcode], (unsigned long long)sum_metric(offsetof(SceNetAdhocctlMetrics, rxbytes) + opcode * sizeof(uint64_t)));
+	
+	append_http(out, "# HELP adhocctl_tx_packets_total Packets sent or queued for Users by Opcode.\n# TYPE adhocctl_tx_packets_total counter\n");
+	for(opcode = 0; opcode <= OPCODE_CHAT; opcode++) if(_metrics_tx_opcode_name[opcode] != NULL) append_http(out, "adhocctl_tx_packets_total{opcode=\"%s\"} %llu\n", _metrics_tx_opcode_name[opcode], (unsigned long long)sum_metric(offsetof(SceNetAdhocctlMetrics, txpackets) + opcode * sizeof(uint64_t)));
+	append_http(out, "# HELP adhocctl_tx_bytes_total Bytes sent or queued for Users by Opcode.\n# TYPE adhocctl_tx_bytes_total counter\n");
+	for(opcode = 0; opcode <= OPCODE_CHAT; opcode++) if(_metrics_tx_opcode_name[opcode] != NULL) append_http(out, "adhocctl_tx_bytes_total{opcode=\"%s\"} %llu\n", _metrics_tx_opcode_name[opcode], (unsigned long long)sum_metric(offsetof(SceNetAdhocctlMetrics, txbytes) + opcode * sizeof(uint64_t)));
+	
+	// Counters
+	render_metric(out, "adhocctl_tx_short_writes_total", "counter", "Sends the Socket didn't take completely.", offsetof(SceNetAdhocctlMetrics, txshort));
+	render_metric(out, "adhocctl_tx_overflows_total", "counter", "Users dropped for a TX Queue Overflow.", offsetof(SceNetAdhocctlMetrics, txoverflow));
+	render_metric(out, "adhocctl_logins_total", "counter", "Completed Logins.", offsetof(SceNetAdhocctlMetrics, logins));
+	render_metric(out, "adhocctl_logouts_total", "counter", "Logouts of logged-in Users.", offsetof(SceNetAdhocctlMetrics, logouts));
+	render_metric(out, "adhocctl_drops_total", "counter", "Connections closed before the Login.", offsetof(SceNetAdhocctlMetrics, drops));
+	render_metric(out, "adhocctl_timeouts_total", "counter", "Users timed out.", offsetof(SceNetAdhocctlMetrics, timeouts));
+	render_metric(out, "adhocctl_invalid_opcodes_total", "counter", "Users dropped for an invalid Opcode.", offsetof(SceNetAdhocctlMetrics, badopcodes));
+	
+	// Gauges
+	append_http(out, "# HELP adhocctl_users Connected Users.\n# TYPE adhocctl_users gauge\nadhocctl_users %u\n", __atomic_load_n(&_db_user_count, __ATOMIC_RELAXED));
+	render_metric(out, "adhocctl_games", "gauge", "Games with Players.", offsetof(SceNetAdhocctlMetrics, games));
+	render_metric(out, "adhocctl_groups", "gauge", "Groups with Players.", offsetof(SceNetAdhocctlMetrics, groups));
+	
+	// Loop Duration Histogram by Thread
+	append_http(out, "# HELP adhocctl_loop_duration_seconds Event Loop Iteration Duration.\n# TYPE adhocctl_loop_duration_seconds histogram\n");
+	SceNetAdhocctlMetrics * metrics = _metrics_list;
+	for(; metrics != NULL; metrics = metrics->next)
+	{
+		// Skip Threads without Loop
+		if(metrics == &_metrics_fallback) continue;
+		
+		// Cumulative Buckets
+		uint64_t cumulative = 0;
+		uint32_t bucket = 0; for(; bucket < METRICS_LOOP_BUCKETS; bucket++)
+		{
+			// Add Bucket
+			cumulative += __atomic_load_n(&metrics->loopbuckets[bucket], __ATOMIC_RELAXED);
+			
+			// Write Bucket
+			append_http(out, "adhocctl_loop_duration_seconds_bucket{thread=\"%s\",le=\"%s\"} %llu\n", metrics->name, _metrics_loop_label[bucket], (unsigned long long)cumulative);
+		}
+		
+		// Write Sum & Count
+		append_http(out, "adhocctl_loop_duration_seconds_sum{thread=\"%s\"} %.9f\n", metrics->name, __atomic_load_n(&metrics->loopnanoseconds, __ATOMIC_RELAXED) / 1e9);
+		append_http(out, "adhocctl_loop_duration_seconds_count{thread=\"%s\"} %llu\n", metrics->name, (unsigned long long)__atomic_load_n(&metrics->loopcount, __ATOMIC_RELAXED));
+	}
+	
+	// Unlock Counter List
+	pthread_mutex_unlock(&_metrics_lock);
+}
+
+/**
+ * Free Metric Counters (after all Loop Threads stopped)
+ */
+void free_metrics(void)
+{
+	// Lock Counter List
+	pthread_mutex_lock(&_metrics_lock);
+	
+	// Free registered Counters
+	while(_metrics_list != &_metrics_fallback)
+	{
+		// Unlink Counters
+		SceNetAdhocctlMetrics * metrics = _metrics_list;
+		_metrics_list = metrics->next;
+		
+		// Free Counters
+		free(metrics);
+	}
+	
+	// Unlock Counter List
+	pthread_mutex_unlock(&_metrics_lock);
+	
+	// Fall back on this Thread
+	_metrics = &_metrics_fallback;
+}
@@ -0,0 +1,109 @@
+/*
+ * This file is part of PRO ONLINE.
+
+ * PRO ONLINE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * PRO ONLINE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PRO ONLINE. If not, see <http://www.gnu.org/licenses/ .
+ */
+
+#ifndef _METRICS_H_
+#define _METRICS_H_
+
+#include <stdint.h>
+#include <user.h>
+#include <http.h>
+
+// Loop Duration Histogram Buckets (+Inf included)
+#define METRICS_LOOP_BUCKETS 10
+
+// Metric Counters of one Thread (only that Thread writes them, the Metrics Page reads them)
+typedef struct SceNetAdhocctlMetrics {
+	// Next Element
+	struct SceNetAdhocctlMetrics * next;
+	
+	// Thread Name
+	char name[16];
+	
+	// Received Packets & Bytes by Opcode
+	uint64_t rxpackets[OPCODE_CHAT + 1];
+	uint64_t rxbytes[OPCODE_CHAT + 1];
+	
+	// Sent Packets & Bytes by Opcode (sent or queued through send_user_data)
+	uint64_t txpackets[OPCODE_CHAT + 1];
+	uint64_t txbytes[OPCODE_CHAT + 1];
+	
+	// Sends the Socket didn't take completely (the Rest got queued)
+	uint64_t txshort;
+	
+	// Users dropped for a TX Queue Overflow
+	uint64_t txoverflow;
+	
+	// Logins & Logouts
+	uint64_t logins;
+	uint64_t logouts;
+	
+	// Connections dropped before the Login
+	uint64_t drops;
+	
+	// Users timed out
+	uint64_t timeouts;
+	
+	// Users dropped for an invalid Opcode
+	uint64_t badopcodes;
+	
+	// Games & Groups created minus freed on this Thread
+	int64_t games;
+	int64_t groups;
+	
+	// Loop Iteration Duration Histogram (Buckets aren't cumulative here)
+	uint64_t loopbuckets[METRICS_LOOP_BUCKETS];
+	uint64_t loopcount;
+	uint64_t loopnanoseconds;
+} SceNetAdhocctlMetrics;
+
+// Metric Counters of the calling Thread
+extern __thread SceNetAdhocctlMetrics * _metrics;
+
+// Fallback Counters (shared by Threads without own Counters)
+extern SceNetAdhocctlMetrics _metrics_fallback;
+
+// Count Metric (Single Writer, so a relaxed Store is enough and no locked Instruction is needed, except on the shared Fallback Counters)
+#define count_metric(field, amount) do { if(_metrics == &_metrics_fallback) __atomic_add_fetch(&_metrics->field, (amount), __ATOMIC_RELAXED); else __atomic_store_n(&_metrics->field, _metrics->field + (amount), __ATOMIC_RELAXED); } while(0)
+
+// Count sent Packets of one Opcode
+#define count_tx_metric(opcode, packets, bytes) do { count_metric(txpackets[opcode], packets); count_metric(txbytes[opcode], bytes); } while(0)
+
+/**
+ * Register Metric Counters for the calling Thread
+ * @param name Thread Name
+ * @return 0 on Success or -1 if the Thread keeps sharing the Fallback Counters
+ */
+int register_metrics(const char * name);
+
+/**
+ * Count Loop Iteration Duration
+ * @param start Monotonic Iteration Start (Nanoseconds)
+ */
+void observe_loop_duration(uint64_t start);
+
+/**
+ * Render Metrics in Prometheus Text Format
+ * @param out Output Buffer
+ */
+void render_metrics(SceNetAdhocctlHttpBuffer * out);
+
+/**
+ * Free Metric Counters (after all Loop Threads stopped)
+ */
+void free_metrics(void);
+
+#endif
@@ -0,0 +1,262 @@
+/*
+ * This file is part of PRO ONLINE.
+
+ * PRO ONLINE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * PRO ONLINE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PRO ONLINE. If not, see <http://www.gnu.org/licenses/ .
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pool.h>
+
+// Thread Caches (indexed by Pool Slot)
+static __thread SceNetAdhocctlPoolCache _pool_cache[POOL_SLOTS];
+
+// Used Cache Slots (Bitmask) & last Pool Generation
+static uint32_t _pool_slots = 0;
+static uint32_t _pool_generation = 0;
+static pthread_mutex_t _pool_slot_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Function Prototypes
+SceNetAdhocctlPoolCache * get_pool_cache(SceNetAdhocctlPool * pool);
+void spill_pool_cache(SceNetAdhocctlPool * pool, SceNetAdhocctlPoolCache * cache, uint32_t count);
+
+/**
+ * Create Object Pool
+ * @param pool Pool
+ * @param size Object Size
+ * @param capacity Object Capacity (Thread Caches may hold up to POOL_CACHE_MAXIMUM of them each)
+ * @return 0 on Success or -1 if out of Memory or Cache Slots
+ */
+int create_pool(SceNetAdhocctlPool * pool, uint32_t size, uint32_t capacity)
+{
+	// Clear Pool
+	memset(pool, 0, sizeof(SceNetAdhocctlPool));
+	
+	// Round Object Size up to Pointer Alignment (free Objects hold the Free List Link)
+	size = (size + sizeof(void *) - 1) & ~(uint32_t)(sizeof(void *) - 1);
+	
+	// Allocate Cache-Line aligned Slab (untouched Pages stay unbacked until used)
+	void * memory = NULL;
+	if(posix_memalign(&memory, 64, (size_t)capacity * size) != 0) return -1;
+	
+	// Find free Cache Slot
+	pthread_mutex_lock(&_pool_slot_lock);
+	uint32_t slot = 0;
+	while(slot < POOL_SLOTS && (_pool_slots & (1U << slot))) slot++;
+	
+	// Claim Cache Slot (a new Generation invalidates Caches left over from an earlier Pool in this Slot)
+	if(slot < POOL_SLOTS)
+	{
+		_pool_slots |= 1U << slot;
+		pool->generation = ++_pool_generation;
+	}
+	pthread_mutex_unlock(&_pool_slot_lock);
+	
+	// Out of Cache Slots
+	if(slot == POOL_SLOTS)
+	{
+		// Free Slab
+		free(memory);
+		
+		// Return Error
+		return -1;
+	}
+	
+	// Save Slab & Cache Slot
+	pool->memory = (uint8_t *)memory;
+	pool->slot = slot;
+	
+	// Save Geometry
+	pool->size = size;
+	pool->capacity = capacity;
+	
+	// Initialize Lock
+	pthread_mutex_init(&pool->lock, NULL);
+	
+	// Return Success
+	return 0;
+}
+
+/**
+ * Destroy Object Pool
+ * @param pool Pool
+ */
+void destroy_pool(SceNetAdhocctlPool * pool)
+{
+	// Pool exists
+	if(pool->memory != NULL)
+	{
+		// Release Cache Slot (Caches still pointing into the Slab fail the Generation Check)
+		pthread_mutex_lock(&_pool_slot_lock);
+		_pool_slots &= ~(1U << pool->slot);
+		pthread_mutex_unlock(&_pool_slot_lock);
+		
+		// Destroy Lock
+		pthread_mutex_destroy(&pool->lock);
+		
+		// Free Slab
+		free(pool->memory);
+		
+		// Clear Pool
+		memset(pool, 0, sizeof(SceNetAdhocctlPool));
+	}
+}
+
+/**
+ * Allocate Object from Pool
+ * @param pool Pool
+ * @return Zeroed Object or NULL if the Pool is exhausted
+ */
+void * alloc_pool(SceNetAdhocctlPool * pool)
+{
+	// Thread Cache
+	SceNetAdhocctlPoolCache * cache = get_pool_cache(pool);
+	
+	// Cache empty
+	if(cache->free == NULL)
+	{
+		// Lock Pool
+		pthread_mutex_lock(&pool->lock);
+		
+		// Refill half of the Cache
+		while(cache->count < POOL_CACHE_MAXIMUM / 2)
+		{
+			// Take first released Object
+			void * object = pool->free;
+			if(object != NULL) pool->free = *(void **)object;
+			
+			// Take next fresh Object (Slab Pages get touched on first Use only)
+			else if(pool->fresh < pool->capacity) object = pool->memory + (size_t)(pool->fresh++) * pool->size;
+			
+			// Pool exhausted
+			else break;
+			
+			// Cache Object
+			*(void **)object = cache->free;
+			cache->free = object;
+			cache->count++;
+			
+			// Count Object
+			pool->used++;
+		}
+		
+		// Unlock Pool
+		pthread_mutex_unlock(&pool->lock);
+	}
+	
+	// Take first cached Object
+	void * object = cache->free;
+	if(object == NULL) return NULL;
+	cache->free = *(void **)object;
+	cache->count--;
+	
+	// Clear Object
+	memset(object, 0, pool->size);
+	
+	// Return Object
+	return object;
+}
+
+/**
+ * Release Object to Pool
+ * @param pool Pool
+ * @param object Object (NULL is ignored)
+ */
+void free_pool(SceNetAdhocctlPool * pool, void * object)
+{
+	// Invalid Object
+	if(object == NULL) return;
+	
+	// Thread Cache (Objects may come from the Cache of another Thread)
+	SceNetAdhocctlPoolCache * cache = get_pool_cache(pool);
+	
+	// Cache Object
+	*(void **)object = cache->free;
+	cache->free = object;
+	cache->count++;
+	
+	// Cache full (spill half, so alternating Allocations and Releases don't hit the Lock every Time)
+	if(cache->count > POOL_CACHE_MAXIMUM) spill_pool_cache(pool, cache, POOL_CACHE_MAXIMUM / 2);
+}
+
+/**
+ * Return the Thread Cache of the calling Thread to the Pool (call before the Thread exits)
+ * @param pool Pool
+ */
+void flush_pool_cache(SceNetAdhocctlPool * pool)
+{
+	// Pool exists
+	if(pool->memory != NULL)
+	{
+		// Thread Cache
+		SceNetAdhocctlPoolCache * cache = get_pool_cache(pool);
+		
+		// Spill every cached Object
+		if(cache->count > 0) spill_pool_cache(pool, cache, cache->count);
+	}
+}
+
+/**
+ * Get Thread Cache of a Pool
+ * @param pool Pool
+ * @return Thread Cache (emptied if it belonged to a destroyed Pool)
+ */
+SceNetAdhocctlPoolCache * get_pool_cache(SceNetAdhocctlPool * pool)
+{
+	// Thread Cache
+	SceNetAdhocctlPoolCache * cache = &_pool_cache[pool->slot];
+	
+	// Cache of an earlier Pool (its Objects died with that Slab)
+	if(cache->generation != pool->generation)
+	{
+		// Reset Cache
+		cache->free = NULL;
+		cache->count = 0;
+		cache->generation = pool->generation;
+	}
+	
+	// Return Thread Cache
+	return cache;
+}
+
+/**
+ * Move cached Objects back to the Pool
+ * @param pool Pool
+ * @param cache Thread Cache
+ * @param count Number of Objects
+ */
+void spill_pool_cache(SceNetAdhocctlPool * pool, SceNetAdhocctlPoolCache * cache, uint32_t count)
+{
+	// Lock Pool
+	pthread_mutex_lock(&pool->lock);
+	
+	// Move Objects
+	uint32_t i = 0; for(; i < count; i++)
+	{
+		// Take first cached Object
+		void * object = cache->free;
+		cache->free = *(void **)object;
+		cache->count--;
+		
+		// Link Object
+		*(void **)object = pool->free;
+		pool->free = object;
+		
+		// Uncount Object
+		pool->used--;
+	}
+	
+	// Unlock Pool
+	pthread_mutex_unlock(&pool->lock);
+}
@@ -0,0 +1,107 @@
+/*
+ * This file is part of PRO ONLINE.
+
+ * PRO ONLINE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * PRO ONLINE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PRO ONLINE. If not, see <http://www.gnu.org/licenses/ .
+ */
+
+#ifndef _POOL_H_
+#define _POOL_H_
+
+#include <stdint.h>
+#include <pthread.h>
+
+// Objects a Thread caches per Pool (Refills and Spills move half of them through the Pool Lock at once)
+#define POOL_CACHE_MAXIMUM 64
+
+// Pools alive at the same Time (each one owns a Cache Slot in every Thread)
+#define POOL_SLOTS 8
+
+// Thread Cache of one Pool
+typedef struct
+{
+	// Free List (Singly-Linked through the cached Objects)
+	void * free;
+	
+	// Cached Objects
+	uint32_t count;
+	
+	// Pool Generation the Cache belongs to (Caches of destroyed Pools get dropped)
+	uint32_t generation;
+} SceNetAdhocctlPoolCache;
+
+// Fixed-Size Object Pool (one Slab, allocated at Startup)
+typedef struct
+{
+	// Slab Memory
+	uint8_t * memory;
+	
+	// Free List (Singly-Linked through the released Objects)
+	void * free;
+	
+	// Objects handed out from the Slab so far (in Slab Order)
+	uint32_t fresh;
+	
+	// Object Size
+	uint32_t size;
+	
+	// Object Capacity
+	uint32_t capacity;
+	
+	// Objects handed out to Threads (in Use or cached)
+	uint32_t used;
+	
+	// Thread Cache Slot & Pool Generation
+	uint32_t slot;
+	uint32_t generation;
+	
+	// Pool Lock (guards the shared Free List, Threads only take it to refill or spill their Cache)
+	pthread_mutex_t lock;
+} SceNetAdhocctlPool;
+
+/**
+ * Create Object Pool
+ * @param pool Pool
+ * @param size Object Size
+ * @param capacity Object Capacity (Thread Caches may hold up to POOL_CACHE_MAXIMUM of them each)
+ * @return 0 on Success or -1 if out of Memory or Cache Slots
+ */
+int create_pool(SceNetAdhocctlPool * pool, uint32_t size, uint32_t capacity);
+
+/**
+ * Destroy Object Pool
+ * @param pool Pool
+ */
+void destroy_pool(SceNetAdhocctlPool * pool);
+
+/**
+ * Allocate Object from Pool
+ * @param pool Pool
+ * @return Zeroed Object or NULL if the Pool is exhausted
+ */
+void * alloc_pool(SceNetAdhocctlPool * pool);
+
+/**
+ * Release Object to Pool
+ * @param pool Pool
+ * @param object Object (NULL is ignored)
+ */
+void free_pool(SceNetAdhocctlPool * pool, void * object);
+
+/**
+ * Return the Thread Cache of the calling Thread to the Pool (call before the Thread exits)
+ * @param pool Pool
+ */
+void flush_pool_cache(SceNetAdhocctlPool * pool);
+
+#endif
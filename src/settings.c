@@ -0,0 +1,465 @@
+/*
+ * This file is part of PRO ONLINE.
+
+ * PRO ONLINE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * PRO ONLINE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PRO ONLINE. If not, see <http://www.gnu.org/licenses/ .
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <getopt.h>
+#include <sys/resource.h>
+#include <arpa/inet.h>
+#include <settings.h>
+#include <config.h>
+#include <log.h>
+
+// Worker Thread Limit
+#define SETTINGS_WORKERS_MAXIMUM 256
+
+// User Limit (keeps the Pool Slabs and Hash Indexes addressable)
+#define SETTINGS_USERS_MAXIMUM 16777216
+
+// Descriptors reserved besides the User Sockets (Listeners, Event Polls, Log, Database, Status & Trace Files)
+#define SETTINGS_RESERVED_DESCRIPTORS 64
+
+// Runtime Settings
+SceNetAdhocctlSettings _settings = {
+	SERVER_PORT,
+	SERVER_HTTP_PORT,
+	0,
+	SERVER_FEED_PORT,
+	0,
+	SERVER_LISTEN_BACKLOG,
+	SERVER_USER_MAXIMUM,
+	SERVER_USER_TIMEOUT,
+	SERVER_STATUS_INTERVAL,
+	SERVER_WORKER_THREADS,
+	SERVER_IO_URING,
+	SERVER_DATABASE,
+	SERVER_STATUS_XMLOUT,
+	SERVER_TRACE_FILE
+};
+
+// Settings (Long Option Names are the Config File Keys)
+static const struct option _settings_options[] = {
+	{ "config", required_argument, NULL, 'c' },
+	{ "port", required_argument, NULL, 'p' },
+	{ "backlog", required_argument, NULL, 'b' },
+	{ "users", required_argument, NULL, 'u' },
+	{ "timeout", required_argument, NULL, 't' },
+	{ "workers", required_argument, NULL, 'w' },
+	{ "uring", required_argument, NULL, 'U' },
+	{ "http-port", required_argument, NULL, 'H' },
+	{ "http-address", required_argument, NULL, 'A' },
+	{ "feed-port", required_argument, NULL, 'F' },
+	{ "feed-address", required_argument, NULL, 'a' },
+	{ "database", required_argument, NULL, 'd' },
+	{ "status", required_argument, NULL, 's' },
+	{ "status-interval", required_argument, NULL, 'i' },
+	{ "trace", required_argument, NULL, 'r' },
+	{ "help", no_argument, NULL, 'h' },
+	{ NULL, 0, NULL, 0 }
+};
+
+// Number Setting
+typedef struct
+{
+	// Setting Name
+	const char * name;
+	
+	// Setting Value
+	uint32_t * value;
+	
+	// Allowed Range
+	uint32_t minimum;
+	uint32_t maximum;
+} SceNetAdhocctlNumberSetting;
+
+// Path Setting
+typedef struct
+{
+	// Setting Name
+	const char * name;
+	
+	// Setting Value (SETTINGS_PATH_LEN Bytes)
+	char * value;
+	
+	// Empty Path disables the Feature
+	int optional;
+} SceNetAdhocctlPathSetting;
+
+// Address Setting
+typedef struct
+{
+	// Setting Name
+	const char * name;
+	
+	// Setting Value (IPv4, Network Byte Order)
+	uint32_t * value;
+	
+	// Default Value (dotted IPv4)
+	const char * fallback;
+} SceNetAdhocctlAddressSetting;
+
+// Number Settings
+static const SceNetAdhocctlNumberSetting _settings_numbers[] = {
+	{ "port", &_settings.port, 1, 65535 },
+	{ "http-port", &_settings.httpport, 0, 65535 },
+	{ "feed-port", &_settings.feedport, 0, 65535 },
+	{ "backlog", &_settings.backlog, 1, 65535 },
+	{ "users", &_settings.usermax, 1, SETTINGS_USERS_MAXIMUM },
+	{ "timeout", &_settings.timeout, 1, 86400 },
+	{ "status-interval", &_settings.statusinterval, 0, 3600000 },
+	{ "workers", &_settings.workers, 0, SETTINGS_WORKERS_MAXIMUM },
+	{ "uring", &_settings.uring, 0, 1 },
+	{ NULL, NULL, 0, 0 }
+};
+
+// Path Settings
+static const SceNetAdhocctlPathSetting _settings_paths[] = {
+	{ "database", _settings.database, 0 },
+	{ "status", _settings.status, 0 },
+	{ "trace", _settings.trace, 1 },
+	{ NULL, NULL, 0 }
+};
+
+// Address Settings
+static const SceNetAdhocctlAddressSetting _settings_addresses[] = {
+	{ "http-address", &_settings.httpaddress, SERVER_HTTP_ADDRESS },
+	{ "feed-address", &_settings.feedaddress, SERVER_FEED_ADDRESS },
+	{ NULL, NULL, NULL }
+};
+
+// Short Options (same Letters as above)
+static const char * _settings_short = "c:p:b:u:t:w:U:H:A:F:a:d:s:i:r:h";
+
+// Function Prototypes
+void print_settings_usage(const char * program);
+int read_settings_file(const char * path, int required);
+int apply_setting(const char * name, const char * value);
+int parse_setting_number(const char * value, uint32_t minimum, uint32_t maximum, uint32_t * out);
+
+/**
+ * Load Settings from Config File and Command Line (Command Line wins)
+ * @param argc Number of Arguments
+ * @param argv Arguments
+ * @return 0 on Success, 1 if the Server should exit right away (Help) or -1 on Error
+ */
+int load_settings(int argc, char * argv[])
+{
+	// Config File (the Default one is optional)
+	const char * config = SERVER_CONFIG_FILE;
+	int required = 0;
+	
+	// Default Addresses (config.h holds them as Text)
+	const SceNetAdhocctlAddressSetting * address = _settings_addresses;
+	for(; address->name != NULL; address++) inet_pton(AF_INET, address->fallback, address->value);
+	
+	// First Pass - find Config File (other Options are checked in the second Pass)
+	opterr = 0;
+	int option = 0;
+	while((option = getopt_long(argc, argv, _settings_short, _settings_options, NULL)) != -1)
+	{
+		// Config File given
+		if(option == 'c')
+		{
+			config = optarg;
+			required = 1;
+		}
+	}
+	
+	// Read Config File
+	if(read_settings_file(config, required) == -1) return -1;
+	
+	// Second Pass - Command Line overrides the Config File (optind 0 makes glibc restart the Scan)
+	opterr = 1;
+	optind = 0;
+	while((option = getopt_long(argc, argv, _settings_short, _settings_options, NULL)) != -1)
+	{
+		// Config File (read already)
+		if(option == 'c') continue;
+		
+		// Help
+		if(option == 'h')
+		{
+			print_settings_usage(argv[0]);
+			return 1;
+		}
+		
+		// Unknown Option or missing Value (getopt printed the Reason)
+		if(option == '?')
+		{
+			print_settings_usage(argv[0]);
+			return -1;
+		}
+		
+		// Find Setting Name
+		const struct option * setting = _settings_options;
+		while(setting->name != NULL && setting->val != option) setting++;
+		
+		// Apply Setting
+		if(setting->name == NULL || apply_setting(setting->name, optarg) == -1) return -1;
+	}
+	
+	// Stray Arguments
+	if(optind < argc)
+	{
+		fprintf(stderr, "%s: unexpected argument '%s'\n", argv[0], argv[optind]);
+		print_settings_usage(argv[0]);
+		return -1;
+	}
+	
+	// Return Success
+	return 0;
+}
+
+/**
+ * Raise the Descriptor Limit for the User Maximum (lowers the User Maximum if the Hard Limit is too low)
+ * @return 0 on Success or -1 if not even the Listening Sockets fit
+ */
+int apply_descriptor_limit(void)
+{
+	// Descriptors besides the User Sockets (every Worker holds an Event Poll, a Wakeup Event and an I/O Ring)
+	uint64_t reserved = SETTINGS_RESERVED_DESCRIPTORS + SERVER_HTTP_CLIENTS + SERVER_FEED_SUBSCRIBERS + _settings.workers * 3;
+	
+	// Required Descriptors
+	uint64_t required = reserved + _settings.usermax;
+	
+	// Current Limit
+	struct rlimit limit;
+	if(getrlimit(RLIMIT_NOFILE, &limit) == -1)
+	{
+		// Notify User
+		log_text(LOG_LEVEL_WARNING, "%s: getrlimit failed (%s), the Descriptor Limit is unchecked.", __func__, strerror(errno));
+		
+		// Return Success (nothing to check against)
+		return 0;
+	}
+	
+	// Limit too low
+	if(limit.rlim_cur != RLIM_INFINITY && limit.rlim_cur < required)
+	{
+		// Raise Soft Limit (up to the Hard Limit)
+		rlim_t previous = limit.rlim_cur;
+		limit.rlim_cur = (limit.rlim_max == RLIM_INFINITY || limit.rlim_max >= required) ? required : limit.rlim_max;
+		if(setrlimit(RLIMIT_NOFILE, &limit) == -1) limit.rlim_cur = previous;
+		
+		// Notify User
+		if(limit.rlim_cur > previous) log_text(LOG_LEVEL_INFO, "Raised the Descriptor Limit from %llu to %llu.", (unsigned long long)previous, (unsigned long long)limit.rlim_cur);
+	}
+	
+	// Limit still too low
+	if(limit.rlim_cur != RLIM_INFINITY && limit.rlim_cur < required)
+	{
+		// Not even the reserved Descriptors fit
+		if(limit.rlim_cur <= reserved)
+		{
+			// Notify User
+			log_text(LOG_LEVEL_ERROR, "%s: the Descriptor Limit of %llu doesn't leave Room for any User.", __func__, (unsigned long long)limit.rlim_cur);
+			
+			// Return Error
+			return -1;
+		}
+		
+		// Notify User
+		log_text(LOG_LEVEL_WARNING, "The Descriptor Limit of %llu only fits %llu of %u Users, raise the Hard Limit (ulimit -Hn) to allow more.", (unsigned long long)limit.rlim_cur, (unsigned long long)(limit.rlim_cur - reserved), _settings.usermax);
+		
+		// Lower User Maximum
+		_settings.usermax = (uint32_t)(limit.rlim_cur - reserved);
+	}
+	
+	// Return Success
+	return 0;
+}
+
+/**
+ * Print Command Line Usage
+ * @param program Program Name
+ */
+void print_settings_usage(const char * program)
+{
+	fprintf(stderr, "Usage: %s [options]\n", program);
+	fprintf(stderr, "  -c, --config FILE     Config File with \"key = value\" Lines, Keys are the long Options (default %s)\n", SERVER_CONFIG_FILE);
+	fprintf(stderr, "  -p, --port PORT       Listening Port (default %u)\n", SERVER_PORT);
+	fprintf(stderr, "  -b, --backlog COUNT   Listener Connection Backlog (default %u)\n", SERVER_LISTEN_BACKLOG);
+	fprintf(stderr, "  -u, --users COUNT     User Maximum (default %u)\n", SERVER_USER_MAXIMUM);
+	fprintf(stderr, "  -t, --timeout SECONDS User Timeout (default %u)\n", SERVER_USER_TIMEOUT);
+	fprintf(stderr, "  -w, --workers COUNT   Worker Threads, 0 keeps everything on one Thread (default %u)\n", SERVER_WORKER_THREADS);
+	fprintf(stderr, "  -U, --uring 0|1       Receive & send User Data through io_uring, falls back to epoll if unavailable (default %u)\n", SERVER_IO_URING);
+	fprintf(stderr, "  -H, --http-port PORT  Metrics & Status JSON Port, 0 disables it (default %u)\n", SERVER_HTTP_PORT);
+	fprintf(stderr, "  -A, --http-address IP Metrics & Status JSON Address, 0.0.0.0 serves every Interface (default %s)\n", SERVER_HTTP_ADDRESS);
+	fprintf(stderr, "  -F, --feed-port PORT  Membership Feed Port (unauthenticated, streams Nicknames & MACs), 0 disables it (default %u)\n", SERVER_FEED_PORT);
+	fprintf(stderr, "  -a, --feed-address IP Membership Feed Address, 0.0.0.0 serves every Interface (default %s)\n", SERVER_FEED_ADDRESS);
+	fprintf(stderr, "  -d, --database FILE   SQLite3 Database (default %s)\n", SERVER_DATABASE);
+	fprintf(stderr, "  -s, --status FILE     Status Logfile (default %s)\n", SERVER_STATUS_XMLOUT);
+	fprintf(stderr, "  -i, --status-interval MS Minimum Time between Status Logfile Rewrites and status.json Recaptures (default %u)\n", SERVER_STATUS_INTERVAL);
+	fprintf(stderr, "  -r, --trace FILE      Record a Traffic Trace for tools/replay (default off)\n");
+	fprintf(stderr, "  -h, --help            Show this Help\n");
+}
+
+/**
+ * Read Settings from Config File
+ * @param path Config File
+ * @param required 1 if a missing File is an Error
+ * @return 0 on Success or -1 on Error
+ */
+int read_settings_file(const char * path, int required)
+{
+	// Open Config File
+	FILE * file = fopen(path, "r");
+	
+	// Config File unavailable
+	if(file == NULL)
+	{
+		// Optional Default File
+		if(!required && errno == ENOENT) return 0;
+		
+		// Notify User
+		fprintf(stderr, "Failed to open Config File %s: %s\n", path, strerror(errno));
+		
+		// Return Error
+		return -1;
+	}
+	
+	// Read Lines
+	char line[512];
+	uint32_t number = 0;
+	while(fgets(line, sizeof(line), file) != NULL)
+	{
+		// Count Line
+		number++;
+		
+		// Cut Comment & Line Break
+		line[strcspn(line, "#\r\n")] = 0;
+		
+		// Skip leading Whitespace
+		char * key = line;
+		while(isspace((unsigned char)*key)) key++;
+		
+		// Empty Line
+		if(*key == 0) continue;
+		
+		// Split Key & Value
+		char * value = strchr(key, '=');
+		if(value == NULL)
+		{
+			fprintf(stderr, "%s:%u: expected \"key = value\"\n", path, number);
+			fclose(file);
+			return -1;
+		}
+		*value++ = 0;
+		
+		// Trim Key
+		char * end = key + strlen(key);
+		while(end > key && isspace((unsigned char)end[-1])) *--end = 0;
+		
+		// Trim Value
+		while(isspace((unsigned char)*value)) value++;
+		end = value + strlen(value);
+		while(end > value && isspace((unsigned char)end[-1])) *--end = 0;
+		
+		// Command Line only Settings
+		if(strcmp(key, "config") == 0 || strcmp(key, "help") == 0)
+		{
+			fprintf(stderr, "%s:%u: '%s' is only available on the Command Line\n", path, number, key);
+			fclose(file);
+			return -1;
+		}
+		
+		// Apply Setting
+		if(apply_setting(key, value) == -1)
+		{
+			fprintf(stderr, "  (%s, Line %u)\n", path, number);
+			fclose(file);
+			return -1;
+		}
+	}
+	
+	// Close Config File
+	fclose(file);
+	
+	// Return Success
+	return 0;
+}
+
+/**
+ * Apply Setting
+ * @param name Setting Name (Long Option Name)
+ * @param value Setting Value
+ * @return 0 on Success or -1 if the Name or Value is invalid
+ */
+int apply_setting(const char * name, const char * value)
+{
+	// Find Number Setting
+	const SceNetAdhocctlNumberSetting * number = _settings_numbers;
+	while(number->name != NULL && strcmp(number->name, name) != 0) number++;
+	
+	// Parse Number Setting
+	if(number->name != NULL && parse_setting_number(value, number->minimum, number->maximum, number->value) == 0) return 0;
+	
+	// Find Address Setting
+	const SceNetAdhocctlAddressSetting * address = _settings_addresses;
+	while(address->name != NULL && strcmp(address->name, name) != 0) address++;
+	
+	// Parse Address Setting (dotted IPv4)
+	if(address->name != NULL && inet_pton(AF_INET, value, address->value) == 1) return 0;
+	
+	// Find Path Setting
+	const SceNetAdhocctlPathSetting * path = _settings_paths;
+	while(path->name != NULL && strcmp(path->name, name) != 0) path++;
+	
+	// Save Path Setting
+	if(path->name != NULL && (value[0] != 0 || path->optional) && strlen(value) < SETTINGS_PATH_LEN)
+	{
+		// Copy Path
+		strcpy(path->value, value);
+		
+		// Return Success
+		return 0;
+	}
+	
+	// Notify User
+	fprintf(stderr, "Invalid Setting %s = '%s'\n", name, value);
+	
+	// Return Error (unknown Name or invalid Value)
+	return -1;
+}
+
+/**
+ * Parse Number Setting
+ * @param value Setting Value
+ * @param minimum Minimum Value
+ * @param maximum Maximum Value
+ * @param out Out Number
+ * @return 0 on Success or -1 if the Value isn't a Number in Range
+ */
+int parse_setting_number(const char * value, uint32_t minimum, uint32_t maximum, uint32_t * out)
+{
+	// Parse Decimal Number
+	char * end = NULL;
+	errno = 0;
+	unsigned long long number = strtoull(value, &end, 10);
+	
+	// Not a Number (or out of Range)
+	if(value[0] == 0 || value[0] == '-' || *end != 0 || errno != 0 || number < minimum || number > maximum) return -1;
+	
+	// Save Number
+	*out = (uint32_t)number;
+	
+	// Return Success
+	return 0;
+}
@@ -0,0 +1,89 @@
+/*
+ * This file is part of PRO ONLINE.
+
+ * PRO ONLINE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * PRO ONLINE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PRO ONLINE. If not, see <http://www.gnu.org/licenses/ .
+ */
+
+#ifndef _SETTINGS_H_
+#define _SETTINGS_H_
+
+#include <stdint.h>
+
+// Settings Path Length Limit
+#define SETTINGS_PATH_LEN 256
+
+// Runtime Settings (Defaults from config.h, overridden by the Config File and the Command Line)
+typedef struct
+{
+	// Listening Port
+	uint32_t port;
+	
+	// HTTP Port for Metrics & Status JSON (0 disables it)
+	uint32_t httpport;
+	
+	// HTTP Listening Address (IPv4, Network Byte Order)
+	uint32_t httpaddress;
+	
+	// Membership Feed Port (0 disables it)
+	uint32_t feedport;
+	
+	// Membership Feed Listening Address (IPv4, Network Byte Order)
+	uint32_t feedaddress;
+	
+	// Listener Connection Backlog
+	uint32_t backlog;
+	
+	// User Maximum (sizes the Node Pools and Hash Indexes)
+	uint32_t usermax;
+	
+	// User Timeout (in seconds)
+	uint32_t timeout;
+	
+	// Status Interval (Minimum Milliseconds between Logfile Rewrites and status.json Recaptures)
+	uint32_t statusinterval;
+	
+	// Worker Threads (0 keeps everything on one Thread)
+	uint32_t workers;
+	
+	// I/O Backend (1 moves User Sockets to io_uring, Threads fall back to epoll if it's unavailable)
+	uint32_t uring;
+	
+	// SQLite3 Database
+	char database[SETTINGS_PATH_LEN];
+	
+	// Status Logfile
+	char status[SETTINGS_PATH_LEN];
+	
+	// Traffic Trace (empty disables it)
+	char trace[SETTINGS_PATH_LEN];
+} SceNetAdhocctlSettings;
+
+// Runtime Settings (read-only once the Server runs)
+extern SceNetAdhocctlSettings _settings;
+
+/**
+ * Load Settings from Config File and Command Line (Command Line wins)
+ * @param argc Number of Arguments
+ * @param argv Arguments
+ * @return 0 on Success, 1 if the Server should exit right away (Help) or -1 on Error
+ */
+int load_settings(int argc, char * argv[]);
+
+/**
+ * Raise the Descriptor Limit for the User Maximum (lowers the User Maximum if the Hard Limit is too low)
+ * @return 0 on Success or -1 if not even the Listening Sockets fit
+ */
+int apply_descriptor_limit(void);
+
+#endif
@@ -15,23 +15,557 @@
  * along with PRO ONLINE. If not, see <http://www.gnu.org/licenses/ .
  */
 
+#include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <signal.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
 #include <user.h>
 #include <status.h>
+#include <worker.h>
+#include <catalog.h>
 #include <config.h>
-#include <sqlite3.h>
+#include <log.h>
+#include <settings.h>
+#include <loop.h>
+
+// Snapshot Game Entry (followed by its Groups in the Group Array)
+typedef struct
+{
+	// Product Code
+	SceNetAdhocctlProductCode game;
+	
+	// Player Count
+	uint32_t playercount;
+	
+	// Group Count
+	uint32_t groupcount;
+} SceNetAdhocctlStatusGame;
+
+// Snapshot Group Entry (followed by its Players in the User Array)
+typedef struct
+{
+	// Group Name
+	SceNetAdhocctlGroupName group;
+	
+	// Player Count
+	uint32_t playercount;
+} SceNetAdhocctlStatusGroup;
+
+// Status Snapshot (flat Copy of the Game Lists, Arrays grow on Demand)
+typedef struct
+{
+	// Total User Count
+	uint32_t totalcount;
+	
+	// Games
+	SceNetAdhocctlStatusGame * game;
+	uint32_t gamecount;
+	uint32_t gamesize;
+	
+	// Groups
+	SceNetAdhocctlStatusGroup * group;
+	uint32_t groupcount;
+	uint32_t groupsize;
+	
+	// Grouped Users
+	SceNetAdhocctlNickname * user;
+	uint32_t usercount;
+	uint32_t usersize;
+} SceNetAdhocctlStatusSnapshot;
+
+// Status Dirty Flag
+static int _status_dirty = 0;
+
+// Status Flush Timer (armed one-shot for the End of the Status Interval, watched by the Acceptor Loop, -1 while the Writer isn't running)
+int _status_timer = -1;
+
+// Status Version (bumped on every Change, the JSON ETag)
+static uint64_t _status_version = 0;
+
+// JSON Snapshot (Acceptor Thread, recaptured when the Version moved)
+static SceNetAdhocctlStatusSnapshot _status_json;
+static uint64_t _status_json_version = 0;
+static int _status_json_valid = 0;
+
+// Last JSON Snapshot Time (Acceptor Thread, Loop Clock)
+static uint64_t _status_json_captured = 0;
+
+// First JSON Snapshot Time (Acceptor Thread, part of the ETag, as the Version restarts with the Process)
+static time_t _status_json_epoch = 0;
+
+// Last Snapshot Time (Acceptor Thread, Loop Clock)
+static uint64_t _status_captured = 0;
+
+// Status Writer Thread
+static pthread_t _status_thread;
+static int _status_running = 0;
+
+// Status Writer Lock & Condition (guard the pending Snapshot)
+static pthread_mutex_t _status_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t _status_cond = PTHREAD_COND_INITIALIZER;
+
+// Snapshot Buffers (captured by the Acceptor, pending for the Writer, rendered by the Writer)
+static SceNetAdhocctlStatusSnapshot _status_snapshot[3];
+static SceNetAdhocctlStatusSnapshot * _status_capture = &_status_snapshot[0];
+static SceNetAdhocctlStatusSnapshot * _status_pending = &_status_snapshot[1];
+static SceNetAdhocctlStatusSnapshot * _status_render = &_status_snapshot[2];
+static int _status_queued = 0;
 
 // Function Prototypes
+void * status_main(void * arg);
+void queue_status(void);
+void arm_status_timer(uint64_t now);
+int capture_status(SceNetAdhocctlStatusSnapshot * snapshot);
+int capture_status_games(SceNetAdhocctlStatusSnapshot * snapshot, SceNetAdhocctlGameNode * game);
+int grow_status_array(void ** array, uint32_t * size, uint32_t count, uint32_t entrysize);
+void write_status(SceNetAdhocctlStatusSnapshot * snapshot);
+void write_status_games(FILE * log, SceNetAdhocctlCatalog * catalog, SceNetAdhocctlStatusSnapshot * snapshot);
+void write_status_json(SceNetAdhocctlHttpBuffer * out, SceNetAdhocctlCatalog * catalog, SceNetAdhocctlStatusSnapshot * snapshot, const SceNetAdhocctlProductCode * product);
+void free_status_snapshot(SceNetAdhocctlStatusSnapshot * snapshot);
 const char * strcpyxml(char * out, const char * in, uint32_t size);
 
 /**
- * Update Status Logfile
+ * Start Status Writer Thread (queues the initial empty Status)
+ * @return 0 on Success or -1 on Error
+ */
+int start_status_writer(void)
+{
+	// Create Status Flush Timer
+	_status_timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+	
+	// Timer unavailable
+	if(_status_timer == -1)
+	{
+		// Notify User
+		log_text(LOG_LEVEL_ERROR, "%s: timerfd_create returned -1.", __func__);
+		
+		// Return Error
+		return -1;
+	}
+	
+	// Keep Signals on the Acceptor Thread
+	sigset_t mask, oldmask;
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGINT);
+	sigaddset(&mask, SIGTERM);
+	sigaddset(&mask, SIGHUP);
+	pthread_sigmask(SIG_BLOCK, &mask, &oldmask);
+	
+	// Create Writer Thread
+	_status_running = 1;
+	int result = pthread_create(&_status_thread, NULL, status_main, NULL);
+	
+	// Restore Signal Mask
+	pthread_sigmask(SIG_SETMASK, &oldmask, NULL);
+	
+	// Failed to create Writer Thread
+	if(result != 0)
+	{
+		// Notify User
+		log_text(LOG_LEVEL_ERROR, "%s: failed to create Status Writer Thread.", __func__);
+		
+		// Not running
+		_status_running = 0;
+		
+		// Close Status Flush Timer
+		close(_status_timer);
+		_status_timer = -1;
+		
+		// Return Error
+		return -1;
+	}
+	
+	// Create Empty Status Logfile
+	queue_status();
+	
+	// Return Success
+	return 0;
+}
+
+/**
+ * Stop Status Writer Thread (writes the final Status first)
+ */
+void stop_status_writer(void)
+{
+	// Writer not running
+	if(!_status_running) return;
+	
+	// Queue final Status
+	if(__atomic_exchange_n(&_status_dirty, 0, __ATOMIC_RELAXED)) queue_status();
+	
+	// Stop Writer (after it rendered the pending Snapshot)
+	pthread_mutex_lock(&_status_lock);
+	_status_running = 0;
+	pthread_cond_signal(&_status_cond);
+	pthread_mutex_unlock(&_status_lock);
+	
+	// Wait for Writer
+	pthread_join(_status_thread, NULL);
+	
+	// Close Status Flush Timer
+	close(_status_timer);
+	_status_timer = -1;
+	
+	// Free Snapshot Buffers
+	int i = 0; for(; i < 3; i++) free_status_snapshot(&_status_snapshot[i]);
+	
+	// Free JSON Snapshot
+	free_status_snapshot(&_status_json);
+	_status_json_valid = 0;
+}
+
+/**
+ * Update Status Logfile (marks it for the next Flush)
  */
 void update_status(void)
 {
+	// First Change since the last Flush (later ones only read the Flag)
+	if(!__atomic_load_n(&_status_dirty, __ATOMIC_RELAXED) && !__atomic_exchange_n(&_status_dirty, 1, __ATOMIC_RELAXED))
+	{
+		// Schedule Flush for the End of the Status Interval
+		arm_status_timer(_loop_clock);
+	}
+	
+	// Move Status Version
+	__atomic_add_fetch(&_status_version, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * Write pending Status Changes (at most once per Status Interval)
+ */
+void flush_status(void)
+{
+	// Acknowledge Timer Expiration
+	uint64_t expirations = 0;
+	read(_status_timer, &expirations, sizeof(expirations));
+	
+	// Current Time
+	uint64_t now = _loop_clock;
+	
+	// Rate Limit reached (a Change raced the last Flush, write it once the Interval ends)
+	if(now - __atomic_load_n(&_status_captured, __ATOMIC_RELAXED) < _settings.statusinterval)
+	{
+		// Reschedule Flush
+		if(__atomic_load_n(&_status_dirty, __ATOMIC_RELAXED)) arm_status_timer(now);
+		
+		// Wait for the Timer
+		return;
+	}
+	
+	// Remember Snapshot Time (before clearing the Flag, so Changes from here on wait for the next Interval)
+	__atomic_store_n(&_status_captured, now, __ATOMIC_RELAXED);
+	
+	// Status is Dirty
+	if(__atomic_exchange_n(&_status_dirty, 0, __ATOMIC_RELAXED))
+	{
+		// Hand Snapshot to Writer
+		queue_status();
+	}
+}
+
+/**
+ * Arm Status Flush Timer for the End of the current Status Interval
+ * @param now Loop Clock of the calling Thread
+ */
+void arm_status_timer(uint64_t now)
+{
+	// Writer not running (Benchmarks & Shutdown)
+	if(_status_timer == -1) return;
+	
+	// Remaining Interval (Milliseconds)
+	uint64_t elapsed = now - __atomic_load_n(&_status_captured, __ATOMIC_RELAXED);
+	uint64_t remaining = (elapsed < _settings.statusinterval) ? (_settings.statusinterval - elapsed) : 0;
+	
+	// One-Shot Expiration (a zero Value would disarm the Timer)
+	struct itimerspec expiration;
+	memset(&expiration, 0, sizeof(expiration));
+	expiration.it_value.tv_sec = remaining / 1000;
+	expiration.it_value.tv_nsec = (remaining % 1000) * 1000000 + 1;
+	
+	// Arm Timer
+	timerfd_settime(_status_timer, 0, &expiration, NULL);
+}
+
+/**
+ * Serve Status as JSON (Acceptor Thread, optional ?product= Filter, ETag Revalidation, recaptured at most once per Status Interval)
+ * @param exchange HTTP Exchange
+ * @return HTTP Status Code
+ */
+int serve_status_json(SceNetAdhocctlHttpExchange * exchange)
+{
+	// Current Version (read before capturing, so a racing Change forces another Capture)
+	uint64_t version = __atomic_load_n(&_status_version, __ATOMIC_RELAXED);
+	
+	// Current Time
+	uint64_t now = _loop_clock;
+	
+	// Recapture outdated Snapshot (at most once per Status Interval, capturing locks every Worker)
+	if(!_status_json_valid || (_status_json_version != version && now - _status_json_captured >= _settings.statusinterval))
+	{
+		// Capture Snapshot
+		if(capture_status(&_status_json) == -1)
+		{
+			// Drop broken Snapshot
+			_status_json_valid = 0;
+			
+			// Return Error
+			return 500;
+		}
+		
+		// Remember Version & Snapshot Time
+		_status_json_version = version;
+		_status_json_captured = now;
+		if(_status_json_epoch == 0) _status_json_epoch = time(NULL);
+		_status_json_valid = 1;
+	}
+	
+	// Entity Tag of the served Snapshot (the Filter is part of the URL, so one Version Tag fits every Filter, the Epoch keeps Tags of earlier Runs from matching)
+	char etag[48];
+	snprintf(etag, sizeof(etag), "\"%llx-%llx\"", (unsigned long long)_status_json_epoch, (unsigned long long)_status_json_version);
+	snprintf(exchange->extra, sizeof(exchange->extra), "ETag: %s\r\nCache-Control: no-cache\r\n", etag);
+	
+	// Client has this Version already
+	char match[256];
+	if(get_http_header(exchange->header, "If-None-Match", match, sizeof(match)) == 0 && (strstr(match, etag) != NULL || strcmp(match, "*") == 0)) return 304;
+	
+	// Acquire Product Catalog (Display Names & Crosslinks)
+	SceNetAdhocctlCatalog * catalog = acquire_catalog();
+	
+	// Product Filter
+	SceNetAdhocctlProductCode filter;
+	SceNetAdhocctlProductCode * product = NULL;
+	char value[PRODUCT_CODE_LENGTH + 1];
+	if(get_http_query(exchange->query, "product", value, sizeof(value)) == 0)
+	{
+		// Copy Product Code
+		memset(&filter, 0, sizeof(filter));
+		strncpy(filter.data, value, PRODUCT_CODE_LENGTH);
+		product = &filter;
+		
+		// Crosslinked Products are played under their Target
+		const SceNetAdhocctlCatalogEntry * entry = find_catalog_entry(catalog, product);
+		if(entry != NULL && entry->crosslinked) filter = entry->link;
+	}
+	
+	// Write JSON
+	write_status_json(&exchange->body, catalog, &_status_json, product);
+	
+	// Release Product Catalog
+	release_catalog(catalog);
+	
+	// Return OK
+	return 200;
+}
+
+/**
+ * Drop the JSON Snapshot (Acceptor Thread, the next Request recaptures regardless of the Interval)
+ */
+void expire_status_json(void)
+{
+	// Invalidate Snapshot (its Arrays get reused by the next Capture)
+	_status_json_valid = 0;
+}
+
+/**
+ * Capture Status Snapshot and hand it to the Writer Thread
+ */
+void queue_status(void)
+{
+	// Capture Snapshot (retry on the next Flush if out of Memory)
+	if(capture_status(_status_capture) == -1)
+	{
+		// Keep Status Dirty
+		update_status();
+		
+		// Stop here
+		return;
+	}
+	
+	// Lock Writer
+	pthread_mutex_lock(&_status_lock);
+	
+	// Replace pending Snapshot (an unrendered older one gets dropped)
+	SceNetAdhocctlStatusSnapshot * snapshot = _status_pending;
+	_status_pending = _status_capture;
+	_status_capture = snapshot;
+	_status_queued = 1;
+	
+	// Wake Writer
+	pthread_cond_signal(&_status_cond);
+	
+	// Unlock Writer
+	pthread_mutex_unlock(&_status_lock);
+}
+
+/**
+ * Status Writer Thread
+ * @param arg Unused
+ * @return NULL
+ */
+void * status_main(void * arg)
+{
+	// Lock Writer
+	pthread_mutex_lock(&_status_lock);
+	
+	// Render Snapshots until stopped and drained
+	while(1)
+	{
+		// Wait for Snapshot
+		while(!_status_queued && _status_running) pthread_cond_wait(&_status_cond, &_status_lock);
+		
+		// Stopped without pending Snapshot
+		if(!_status_queued) break;
+		
+		// Take pending Snapshot
+		SceNetAdhocctlStatusSnapshot * snapshot = _status_render;
+		_status_render = _status_pending;
+		_status_pending = snapshot;
+		_status_queued = 0;
+		
+		// Unlock Writer
+		pthread_mutex_unlock(&_status_lock);
+		
+		// Write Logfile
+		write_status(_status_render);
+		
+		// Lock Writer
+		pthread_mutex_lock(&_status_lock);
+	}
+	
+	// Unlock Writer
+	pthread_mutex_unlock(&_status_lock);
+	
+	// Drop cached Catalog Reference
+	drop_catalog_cache();
+	
+	// Exit Thread
+	return NULL;
+}
+
+/**
+ * Capture consistent Status Snapshot of all Threads
+ * @param snapshot Snapshot
+ * @return 0 on Success or -1 if out of Memory
+ */
+int capture_status(SceNetAdhocctlStatusSnapshot * snapshot)
+{
+	// Clear Snapshot
+	snapshot->gamecount = 0;
+	snapshot->groupcount = 0;
+	snapshot->usercount = 0;
+	
+	// Lock all Worker Databases (one Snapshot across all Shards)
+	uint32_t i = 0; for(; i < _worker_count; i++) pthread_mutex_lock(&_workers[i].lock);
+	
+	// Total User Count
+	snapshot->totalcount = __atomic_load_n(&_db_user_count, __ATOMIC_RELAXED);
+	
+	// Capture Games of this Thread
+	int result = capture_status_games(snapshot, _db_game);
+	
+	// Capture Games of the Worker Threads
+	for(i = 0; i < _worker_count && result == 0; i++)
+	{
+		// Capture Games of this Worker
+		if(_workers[i].db_game != NULL) result = capture_status_games(snapshot, *_workers[i].db_game);
+	}
+	
+	// Unlock all Worker Databases
+	for(i = 0; i < _worker_count; i++) pthread_mutex_unlock(&_workers[i].lock);
+	
+	// Return Result
+	return result;
+}
+
+/**
+ * Capture Game List into Status Snapshot
+ * @param snapshot Snapshot
+ * @param game Game List
+ * @return 0 on Success or -1 if out of Memory
+ */
+int capture_status_games(SceNetAdhocctlStatusSnapshot * snapshot, SceNetAdhocctlGameNode * game)
+{
+	// Iterate Games
+	for(; game != NULL; game = game->next)
+	{
+		// Grow Game Array
+		if(grow_status_array((void **)&snapshot->game, &snapshot->gamesize, snapshot->gamecount + 1, sizeof(SceNetAdhocctlStatusGame)) == -1) return -1;
+		
+		// Copy Game
+		SceNetAdhocctlStatusGame * entry = &snapshot->game[snapshot->gamecount++];
+		entry->game = game->game;
+		entry->playercount = game->playercount;
+		entry->groupcount = game->groupcount;
+		
+		// Grow Group Array
+		if(grow_status_array((void **)&snapshot->group, &snapshot->groupsize, snapshot->groupcount + game->groupcount, sizeof(SceNetAdhocctlStatusGroup)) == -1) return -1;
+		
+		// Iterate Game Groups
+		SceNetAdhocctlGroupNode * group = game->group; for(; group != NULL; group = group->next)
+		{
+			// Copy Group
+			SceNetAdhocctlStatusGroup * groupentry = &snapshot->group[snapshot->groupcount++];
+			groupentry->group = group->group;
+			groupentry->playercount = group->playercount;
+			
+			// Grow User Array
+			if(grow_status_array((void **)&snapshot->user, &snapshot->usersize, snapshot->usercount + group->playercount, sizeof(SceNetAdhocctlNickname)) == -1) return -1;
+			
+			// Copy Users
+			SceNetAdhocctlUserNode * user = group->player; for(; user != NULL; user = user->group_next) snapshot->user[snapshot->usercount++] = user->info->resolver.name;
+		}
+	}
+	
+	// Return Success
+	return 0;
+}
+
+/**
+ * Grow Snapshot Array (doubles its Capacity)
+ * @param array Array Pointer
+ * @param size Capacity in Entries
+ * @param count Required Entries
+ * @param entrysize Size of one Entry
+ * @return 0 on Success or -1 if out of Memory
+ */
+int grow_status_array(void ** array, uint32_t * size, uint32_t count, uint32_t entrysize)
+{
+	// Enough Space
+	if(count <= *size) return 0;
+	
+	// New Capacity
+	uint32_t newsize = (*size == 0) ? 64 : *size;
+	while(newsize < count) newsize *= 2;
+	
+	// Resize Array
+	void * newarray = realloc(*array, newsize * entrysize);
+	
+	// Out of Memory
+	if(newarray == NULL) return -1;
+	
+	// Save Array
+	*array = newarray;
+	*size = newsize;
+	
+	// Return Success
+	return 0;
+}
+
+/**
+ * Write Status Logfile (renders into a temporary File and renames it into Place)
+ * @param snapshot Snapshot
+ */
+void write_status(SceNetAdhocctlStatusSnapshot * snapshot)
+{
+	// Temporary Logfile Path
+	char path[SETTINGS_PATH_LEN + 4];
+	snprintf(path, sizeof(path), "%s.tmp", _settings.status);
+	
 	// Open Logfile
-	FILE * log = fopen(SERVER_STATUS_XMLOUT, "w");
+	FILE * log = fopen(path, "w");
 	
 	// Opened Logfile
 	if(log != NULL)
@@ -43,112 +577,213 @@ void update_status(void)
 		fprintf(log, "<?xml-stylesheet type=\"text/xsl\" href=\"status.xsl\"?>\n");
 		
 		// Output Root Tag + User Count
-		fprintf(log, "<prometheus usercount=\"%u\">\n", _db_user_count);
+		fprintf(log, "<prometheus usercount=\"%u\">\n", snapshot->totalcount);
+		
+		// Acquire Product Catalog (Display Names)
+		SceNetAdhocctlCatalog * catalog = acquire_catalog();
+		
+		// Write Games
+		write_status_games(log, catalog, snapshot);
+		
+		// Release Product Catalog
+		release_catalog(catalog);
+		
+		// Output Closing Root Tag
+		fprintf(log, "</prometheus>");
+		
+		// Close Logfile
+		int result = fclose(log);
+		
+		// Publish Logfile
+		if(result == 0) rename(path, _settings.status);
+		
+		// Drop broken Logfile
+		else remove(path);
+	}
+}
+
+/**
+ * Write Game Tags
+ * @param log Logfile
+ * @param catalog Product Catalog (NULL if none is loaded)
+ * @param snapshot Snapshot
+ */
+void write_status_games(FILE * log, SceNetAdhocctlCatalog * catalog, SceNetAdhocctlStatusSnapshot * snapshot)
+{
+	// Group & User Cursor
+	SceNetAdhocctlStatusGroup * group = snapshot->group;
+	SceNetAdhocctlNickname * user = snapshot->user;
+	
+	// Iterate Games
+	uint32_t i = 0; for(; i < snapshot->gamecount; i++)
+	{
+		// Game
+		SceNetAdhocctlStatusGame * game = &snapshot->game[i];
+		
+		// Safe Product ID
+		char productid[PRODUCT_CODE_LENGTH + 1];
+		strncpy(productid, game->game.data, PRODUCT_CODE_LENGTH);
+		productid[PRODUCT_CODE_LENGTH] = 0;
+		
+		// Known Product
+		const SceNetAdhocctlCatalogEntry * entry = find_catalog_entry(catalog, &game->game);
 		
-		// Database Handle
-		sqlite3 * db = NULL;
+		// Display Name (Product Code for unknown Products)
+		char displayname[128];
+		strcpyxml(displayname, (entry != NULL) ? entry->name : productid, sizeof(displayname));
 		
-		// Open Database
-		if(sqlite3_open(SERVER_DATABASE, &db) == SQLITE_OK)
+		// Output Game Tag + Game Name
+		fprintf(log, "\t<game name=\"%s\" usercount=\"%u\">\n", displayname, game->playercount);
+		
+		// Activate User Count
+		uint32_t activecount = 0;
+		
+		// Iterate Game Groups
+		uint32_t j = 0; for(; j < game->groupcount; j++, group++)
 		{
-			// Iterate Games
-			SceNetAdhocctlGameNode * game = _db_game; for(; game != NULL; game = game->next)
+			// Safe Group Name
+			char groupname[ADHOCCTL_GROUPNAME_LEN + 1];
+			strncpy(groupname, (const char *)group->group.data, ADHOCCTL_GROUPNAME_LEN);
+			groupname[ADHOCCTL_GROUPNAME_LEN] = 0;
+			
+			// Output Group Tag + Group Name + User Count
+			fprintf(log, "\t\t<group name=\"%s\" usercount=\"%u\">\n", strcpyxml(displayname, groupname, sizeof(displayname)), group->playercount);
+			
+			// Iterate Users
+			uint32_t k = 0; for(; k < group->playercount; k++, user++)
 			{
-				// Safe Product ID
-				char productid[PRODUCT_CODE_LENGTH + 1];
-				strncpy(productid, game->game.data, PRODUCT_CODE_LENGTH);
-				productid[PRODUCT_CODE_LENGTH] = 0;
-				
-				// Display Name
-				char displayname[128];
-				memset(displayname, 0, sizeof(displayname));
+				// Safe Username
+				char username[ADHOCCTL_NICKNAME_LEN + 1];
+				strncpy(username, (const char *)user->data, ADHOCCTL_NICKNAME_LEN);
+				username[ADHOCCTL_NICKNAME_LEN] = 0;
 				
-				// SQL Statement
-				const char * sql = "SELECT name FROM productids WHERE id=?;";
-				
-				// Prepared SQL Statement
-				sqlite3_stmt * statement = NULL;
-				
-				// Prepare SQL Statement
-				if(sqlite3_prepare_v2(db, sql, strlen(sql) + 1, &statement, NULL) == SQLITE_OK)
-				{
-					// Bind SQL Statement Data
-					if(sqlite3_bind_text(statement, 1, productid, strlen(productid), SQLITE_STATIC) == SQLITE_OK)
-					{
-						// Found Matching Row
-						if(sqlite3_step(statement) == SQLITE_ROW)
-						{
-							// Fetch Game Name from Database
-							const char * gamename = (const char *)sqlite3_column_text(statement, 0);
-							
-							// Copy Game Name
-							strcpyxml(displayname, gamename, sizeof(displayname));
-						}
-						
-						// Game not in Database
-						else
-						{
-							// Use Product Code as Name
-							strcpyxml(displayname, productid, sizeof(displayname));
-						}
-					}
-					
-					// Destroy Prepared SQL Statement
-					sqlite3_finalize(statement);
-				}
-				
-				// Output Game Tag + Game Name
-				fprintf(log, "\t<game name=\"%s\" usercount=\"%u\">\n", displayname, game->playercount);
-				
-				// Activate User Count
-				uint32_t activecount = 0;
-				
-				// Iterate Game Groups
-				SceNetAdhocctlGroupNode * group = game->group; for(; group != NULL; group = group->next)
-				{
-					// Safe Group Name
-					char groupname[ADHOCCTL_GROUPNAME_LEN + 1];
-					strncpy(groupname, (const char *)group->group.data, ADHOCCTL_GROUPNAME_LEN);
-					groupname[ADHOCCTL_GROUPNAME_LEN] = 0;
-					
-					// Output Group Tag + Group Name + User Count
-					fprintf(log, "\t\t<group name=\"%s\" usercount=\"%u\">\n", strcpyxml(displayname, groupname, sizeof(displayname)), group->playercount);
-					
-					// Iterate Users
-					SceNetAdhocctlUserNode * user = group->player; for(; user != NULL; user = user->group_next)
-					{
-						// Output User Tag + Username
-						fprintf(log, "\t\t\t<user>%s</user>\n", strcpyxml(displayname, (const char *)user->resolver.name.data, sizeof(displayname)));
-					}
-					
-					// Output Closing Group Tag
-					fprintf(log, "\t\t</group>\n");
-					
-					// Increase Active Game User Count
-					activecount += group->playercount;
-				}
-				
-				// Output Idle Game Group
-				if(game->playercount > activecount)
-				{
-					// Output Group Tag + Group Name + Idle User Count
-					fprintf(log, "\t\t<group name=\"Groupless\" usercount=\"%u\" />\n", game->playercount - activecount);
-				}
-				
-				// Output Closing Game Tag
-				fprintf(log, "\t</game>\n");
+				// Output User Tag + Username
+				fprintf(log, "\t\t\t<user>%s</user>\n", strcpyxml(displayname, username, sizeof(displayname)));
 			}
 			
-			// Close Database
-			sqlite3_close(db);
+			// Output Closing Group Tag
+			fprintf(log, "\t\t</group>\n");
+			
+			// Increase Active Game User Count
+			activecount += group->playercount;
 		}
 		
-		// Output Closing Root Tag
-		fprintf(log, "</prometheus>");
+		// Output Idle Game Group
+		if(game->playercount > activecount)
+		{
+			// Output Group Tag + Group Name + Idle User Count
+			fprintf(log, "\t\t<group name=\"Groupless\" usercount=\"%u\" />\n", game->playercount - activecount);
+		}
 		
-		// Close Logfile
-		fclose(log);
+		// Output Closing Game Tag
+		fprintf(log, "\t</game>\n");
+	}
+}
+
+/**
+ * Write Status JSON (Game -> Group -> User Tree)
+ * @param out Output Buffer
+ * @param catalog Product Catalog (NULL if none is loaded)
+ * @param snapshot Snapshot
+ * @param product Product Filter (NULL for all Games)
+ */
+void write_status_json(SceNetAdhocctlHttpBuffer * out, SceNetAdhocctlCatalog * catalog, SceNetAdhocctlStatusSnapshot * snapshot, const SceNetAdhocctlProductCode * product)
+{
+	// Escaped Text
+	char escaped[6 * 128 + 1];
+	
+	// Output Root Object + User Count
+	append_http(out, "{\"usercount\":%u,\"games\":[", snapshot->totalcount);
+	
+	// Group & User Cursor
+	SceNetAdhocctlStatusGroup * group = snapshot->group;
+	SceNetAdhocctlNickname * user = snapshot->user;
+	
+	// Written Games
+	uint32_t written = 0;
+	
+	// Iterate Games
+	uint32_t i = 0; for(; i < snapshot->gamecount; i++)
+	{
+		// Game
+		SceNetAdhocctlStatusGame * game = &snapshot->game[i];
+		
+		// Filtered Game (skip its Groups & Users)
+		if(product != NULL && memcmp(product->data, game->game.data, PRODUCT_CODE_LENGTH) != 0)
+		{
+			// Move Cursors
+			uint32_t j = 0; for(; j < game->groupcount; j++, group++) user += group->playercount;
+			
+			// Next Game
+			continue;
+		}
+		
+		// Safe Product ID
+		char productid[PRODUCT_CODE_LENGTH + 1];
+		strncpy(productid, game->game.data, PRODUCT_CODE_LENGTH);
+		productid[PRODUCT_CODE_LENGTH] = 0;
+		
+		// Known Product
+		const SceNetAdhocctlCatalogEntry * entry = find_catalog_entry(catalog, &game->game);
+		
+		// Output Game Object (Product Code, Display Name & User Count)
+		append_http(out, "%s{\"product\":\"%s\",", (written++ > 0) ? "," : "", strcpyjson(escaped, productid, sizeof(escaped)));
+		append_http(out, "\"name\":\"%s\",\"usercount\":%u,\"groups\":[", strcpyjson(escaped, (entry != NULL) ? entry->name : productid, sizeof(escaped)), game->playercount);
+		
+		// Activate User Count
+		uint32_t activecount = 0;
+		
+		// Iterate Game Groups
+		uint32_t j = 0; for(; j < game->groupcount; j++, group++)
+		{
+			// Safe Group Name
+			char groupname[ADHOCCTL_GROUPNAME_LEN + 1];
+			strncpy(groupname, (const char *)group->group.data, ADHOCCTL_GROUPNAME_LEN);
+			groupname[ADHOCCTL_GROUPNAME_LEN] = 0;
+			
+			// Output Group Object (Group Name & User Count)
+			append_http(out, "%s{\"name\":\"%s\",\"usercount\":%u,\"users\":[", (j > 0) ? "," : "", strcpyjson(escaped, groupname, sizeof(escaped)), group->playercount);
+			
+			// Iterate Users
+			uint32_t k = 0; for(; k < group->playercount; k++, user++)
+			{
+				// Safe Username
+				char username[ADHOCCTL_NICKNAME_LEN + 1];
+				strncpy(username, (const char *)user->data, ADHOCCTL_NICKNAME_LEN);
+				username[ADHOCCTL_NICKNAME_LEN] = 0;
+				
+				// Output Username
+				append_http(out, "%s\"%s\"", (k > 0) ? "," : "", strcpyjson(escaped, username, sizeof(escaped)));
+			}
+			
+			// Output Closing Group Object
+			append_http(out, "]}");
+			
+			// Increase Active Game User Count
+			activecount += group->playercount;
+		}
+		
+		// Output Closing Game Object + Idle User Count
+		append_http(out, "],\"groupless\":%u}", game->playercount - activecount);
 	}
+	
+	// Output Closing Root Object
+	append_http(out, "]}\n");
+}
+
+/**
+ * Free Snapshot Arrays
+ * @param snapshot Snapshot
+ */
+void free_status_snapshot(SceNetAdhocctlStatusSnapshot * snapshot)
+{
+	// Free Arrays
+	free(snapshot->game);
+	free(snapshot->group);
+	free(snapshot->user);
+	
+	// Clear Snapshot
+	memset(snapshot, 0, sizeof(*snapshot));
 }
 
 /**
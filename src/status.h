@@ -18,10 +18,43 @@
 #ifndef _STATUS_H_
 #define _STATUS_H_
 
+#include <http.h>
+
+// Status Flush Timer (armed one-shot for the End of the Status Interval, watched by the Acceptor Loop, -1 while the Writer isn't running)
+extern int _status_timer;
+
+/**
+ * Start Status Writer Thread (queues the initial empty Status)
+ * @return 0 on Success or -1 on Error
+ */
+int start_status_writer(void);
+
 /**
- * Update Status Logfile
+ * Stop Status Writer Thread (writes the final Status first)
+ */
+void stop_status_writer(void);
+
+/**
+ * Update Status Logfile (marks it for the next Flush)
  */
 void update_status(void);
 
+/**
+ * Write pending Status Changes (at most once per Status Interval, call when the Status Flush Timer fired)
+ */
+void flush_status(void);
+
+/**
+ * Serve Status as JSON (Acceptor Thread, optional ?product= Filter, ETag Revalidation, recaptured at most once per Status Interval)
+ * @param exchange HTTP Exchange
+ * @return HTTP Status Code
+ */
+int serve_status_json(SceNetAdhocctlHttpExchange * exchange);
+
+/**
+ * Drop the JSON Snapshot (Acceptor Thread, the next Request recaptures regardless of the Interval)
+ */
+void expire_status_json(void);
+
 #endif
 
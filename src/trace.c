@@ -0,0 +1,351 @@
+/*
+ * This file is part of PRO ONLINE.
+
+ * PRO ONLINE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * PRO ONLINE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PRO ONLINE. If not, see <http://www.gnu.org/licenses/ .
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <user.h>
+#include <trace.h>
+#include <config.h>
+#include <log.h>
+
+// Trace Chunk (pending Bytes that wake the Recorder Thread before the Flush Interval)
+#define TRACE_CHUNK 65536
+
+// Trace Recorder running
+int _trace_running = 0;
+
+// Trace Recorder Thread
+static pthread_t _trace_thread;
+
+// Trace Lock & Condition (guard the pending Records, the Clock and the Connection Counter)
+static pthread_mutex_t _trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t _trace_cond = PTHREAD_COND_INITIALIZER;
+
+// Trace File
+static FILE * _trace_file = NULL;
+
+// Pending Records (swapped with the Recorder Buffer)
+static uint8_t * _trace_pending = NULL;
+static uint32_t _trace_pending_len = 0;
+static uint32_t _trace_pending_size = 0;
+
+// Time of the last Record (Monotonic Microseconds)
+static uint64_t _trace_clock = 0;
+
+// Last Connection Number
+static uint32_t _trace_connections = 0;
+
+// Records dropped because the Recorder fell behind
+static uint32_t _trace_dropped = 0;
+
+// Function Prototypes
+void * trace_main(void * arg);
+int append_trace(uint8_t type, uint32_t connection, const void * data, uint32_t size, uint64_t now);
+
+/**
+ * Start Trace Recorder Thread
+ * @param path Trace File (overwritten)
+ * @return 0 on Success or -1 on Error
+ */
+int start_trace(const char * path)
+{
+	// Open Trace File
+	_trace_file = fopen(path, "wb");
+	
+	// Failed to open Trace File
+	if(_trace_file == NULL)
+	{
+		// Notify User
+		log_text(LOG_LEVEL_ERROR, "%s: failed to open %s (%s).", __func__, path, strerror(errno));
+		
+		// Return Error
+		return -1;
+	}
+	
+	// Wall Clock Time
+	struct timespec wall;
+	clock_gettime(CLOCK_REALTIME, &wall);
+	
+	// File Header
+	SceNetAdhocctlTraceHeader header;
+	memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+	header.version = TRACE_VERSION;
+	header.started = (uint64_t)wall.tv_sec * 1000 + wall.tv_nsec / 1000000;
+	
+	// Trace Clock starts with the Header
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	_trace_clock = (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+	
+	// Write File Header
+	if(fwrite(&header, sizeof(header), 1, _trace_file) != 1)
+	{
+		// Notify User
+		log_text(LOG_LEVEL_ERROR, "%s: failed to write %s.", __func__, path);
+		
+		// Close Trace File
+		fclose(_trace_file);
+		_trace_file = NULL;
+		
+		// Return Error
+		return -1;
+	}
+	
+	// Keep Signals on the Acceptor Thread
+	sigset_t mask, oldmask;
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGINT);
+	sigaddset(&mask, SIGTERM);
+	sigaddset(&mask, SIGHUP);
+	pthread_sigmask(SIG_BLOCK, &mask, &oldmask);
+	
+	// Create Recorder Thread
+	_trace_running = 1;
+	int result = pthread_create(&_trace_thread, NULL, trace_main, NULL);
+	
+	// Restore Signal Mask
+	pthread_sigmask(SIG_SETMASK, &oldmask, NULL);
+	
+	// Failed to create Recorder Thread
+	if(result != 0)
+	{
+		// Notify User
+		log_text(LOG_LEVEL_ERROR, "%s: failed to create Trace Recorder Thread.", __func__);
+		
+		// Not running
+		_trace_running = 0;
+		
+		// Close Trace File
+		fclose(_trace_file);
+		_trace_file = NULL;
+		
+		// Return Error
+		return -1;
+	}
+	
+	// Return Success
+	return 0;
+}
+
+/**
+ * Stop Trace Recorder Thread (writes the pending Records first)
+ */
+void stop_trace(void)
+{
+	// Recorder not running
+	if(!_trace_running) return;
+	
+	// Stop Recorder (after it wrote the pending Records)
+	pthread_mutex_lock(&_trace_lock);
+	_trace_running = 0;
+	pthread_cond_signal(&_trace_cond);
+	pthread_mutex_unlock(&_trace_lock);
+	
+	// Wait for Recorder
+	pthread_join(_trace_thread, NULL);
+	
+	// Close Trace File
+	fclose(_trace_file);
+	_trace_file = NULL;
+	
+	// Free pending Records
+	free(_trace_pending);
+	_trace_pending = NULL;
+	_trace_pending_len = 0;
+	_trace_pending_size = 0;
+	
+	// Notify User
+	if(_trace_dropped > 0) log_text(LOG_LEVEL_WARNING, "Trace Recorder fell behind and dropped %u Records.", _trace_dropped);
+	log_text(LOG_LEVEL_INFO, "Recorded %u Connections.", _trace_connections);
+}
+
+/**
+ * Record Trace Event (use trace_user)
+ * @param type Record Type
+ * @param user User Node
+ * @param data Payload (NULL if none)
+ * @param size Payload Size
+ */
+void record_trace(int type, SceNetAdhocctlUserNode * user, const void * data, uint32_t size)
+{
+	// Current Time
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	
+	// Lock Trace
+	pthread_mutex_lock(&_trace_lock);
+	
+	// New Connection
+	if(type == TRACE_RECORD_CONNECT) user->info->trace = ++_trace_connections;
+	
+	// Record Event (Connections from before the Recording are skipped)
+	if(user->info->trace != 0 && append_trace(type, user->info->trace, data, size, (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000) == -1)
+	{
+		// Count Drop
+		_trace_dropped++;
+		
+		// Leave the whole Connection out (its later Records would belong to a Connection the Trace never opened)
+		if(type == TRACE_RECORD_CONNECT) user->info->trace = 0;
+	}
+	
+	// Wake Recorder for a full Chunk
+	if(_trace_pending_len >= TRACE_CHUNK) pthread_cond_signal(&_trace_cond);
+	
+	// Unlock Trace
+	pthread_mutex_unlock(&_trace_lock);
+}
+
+/**
+ * Append Record to the pending Records (Trace Lock held)
+ * @param type Record Type
+ * @param connection Connection Number
+ * @param data Payload (NULL if none)
+ * @param size Payload Size
+ * @param now Current Time (Monotonic Microseconds)
+ * @return 0 on Success or -1 if the Backlog is full
+ */
+int append_trace(uint8_t type, uint32_t connection, const void * data, uint32_t size, uint64_t now)
+{
+	// Time since the last Record (Threads may read the Clock slightly out of Order)
+	uint64_t delta = (now > _trace_clock) ? now - _trace_clock : 0;
+	
+	// Time Records bridge Gaps beyond the Delta Range
+	uint32_t fillers = (uint32_t)(delta / 0xFFFFFFFFULL);
+	
+	// Required Space
+	uint32_t required = (fillers + 1) * sizeof(SceNetAdhocctlTraceRecord) + size;
+	
+	// Buffer too small
+	if(_trace_pending_len + required > _trace_pending_size)
+	{
+		// Backlog full
+		if(_trace_pending_len + required > SERVER_TRACE_BACKLOG) return -1;
+		
+		// New Capacity
+		uint32_t capacity = (_trace_pending_size == 0) ? TRACE_CHUNK * 2 : _trace_pending_size * 2;
+		while(capacity < _trace_pending_len + required) capacity *= 2;
+		
+		// Grow Buffer
+		uint8_t * pending = (uint8_t *)realloc(_trace_pending, capacity);
+		
+		// Out of Memory
+		if(pending == NULL) return -1;
+		
+		// Replace Buffer
+		_trace_pending = pending;
+		_trace_pending_size = capacity;
+	}
+	
+	// Record Header
+	SceNetAdhocctlTraceRecord record;
+	record.connection = 0;
+	record.type = TRACE_RECORD_TIME;
+	record.size = 0;
+	record.delta = 0xFFFFFFFFU;
+	
+	// Write Time Records
+	uint32_t i = 0; for(; i < fillers; i++)
+	{
+		memcpy(_trace_pending + _trace_pending_len, &record, sizeof(record));
+		_trace_pending_len += sizeof(record);
+	}
+	
+	// Write Record
+	record.delta = (uint32_t)(delta - (uint64_t)fillers * 0xFFFFFFFFULL);
+	record.connection = connection;
+	record.type = type;
+	record.size = (uint8_t)size;
+	memcpy(_trace_pending + _trace_pending_len, &record, sizeof(record));
+	_trace_pending_len += sizeof(record);
+	
+	// Write Payload
+	if(size > 0) memcpy(_trace_pending + _trace_pending_len, data, size);
+	_trace_pending_len += size;
+	
+	// Move Clock
+	if(now > _trace_clock) _trace_clock = now;
+	
+	// Return Success
+	return 0;
+}
+
+/**
+ * Trace Recorder Thread (writes the pending Records in Chunks, at least once per Second)
+ * @param arg Unused
+ * @return NULL
+ */
+void * trace_main(void * arg)
+{
+	// Write Buffer (swapped with the pending Records)
+	uint8_t * batch = NULL;
+	uint32_t batchsize = 0;
+	
+	// Lock Trace
+	pthread_mutex_lock(&_trace_lock);
+	
+	// Write Batches until stopped and drained
+	while(1)
+	{
+		// Wait for a full Chunk, the Flush Interval or the Stop Request
+		if(_trace_pending_len < TRACE_CHUNK && _trace_running)
+		{
+			struct timespec deadline;
+			clock_gettime(CLOCK_REALTIME, &deadline);
+			deadline.tv_sec++;
+			pthread_cond_timedwait(&_trace_cond, &_trace_lock, &deadline);
+		}
+		
+		// Stopped without pending Records
+		if(_trace_pending_len == 0 && !_trace_running) break;
+		
+		// Nothing to write yet
+		if(_trace_pending_len == 0) continue;
+		
+		// Take pending Records
+		uint8_t * records = _trace_pending;
+		uint32_t len = _trace_pending_len;
+		uint32_t size = _trace_pending_size;
+		_trace_pending = batch;
+		_trace_pending_len = 0;
+		_trace_pending_size = batchsize;
+		batch = records;
+		batchsize = size;
+		
+		// Unlock Trace
+		pthread_mutex_unlock(&_trace_lock);
+		
+		// Write Batch
+		if(fwrite(batch, 1, len, _trace_file) != len || fflush(_trace_file) != 0) log_text(LOG_LEVEL_ERROR, "%s: failed to write Trace (%s).", __func__, strerror(errno));
+		
+		// Lock Trace
+		pthread_mutex_lock(&_trace_lock);
+	}
+	
+	// Unlock Trace
+	pthread_mutex_unlock(&_trace_lock);
+	
+	// Free Write Buffer
+	free(batch);
+	
+	// Exit Thread
+	return NULL;
+}
@@ -0,0 +1,90 @@
+/*
+ * This file is part of PRO ONLINE.
+
+ * PRO ONLINE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * PRO ONLINE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PRO ONLINE. If not, see <http://www.gnu.org/licenses/ .
+ */
+
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <stdint.h>
+#include <user.h>
+
+// Trace File Magic & Version
+#define TRACE_MAGIC "PROTRACE"
+#define TRACE_VERSION 1
+
+// Trace Record Types
+#define TRACE_RECORD_CONNECT 0 // Payload: IP Address (Network Order)
+#define TRACE_RECORD_PACKET 1 // Payload: framed C2S Packet
+#define TRACE_RECORD_CLOSE 2 // No Payload
+#define TRACE_RECORD_TIME 3 // No Payload, only moves the Clock (Gaps beyond the Delta Range)
+
+// Trace File Header
+typedef struct
+{
+	// File Magic (TRACE_MAGIC without Terminator)
+	char magic[8];
+	
+	// Format Version
+	uint32_t version;
+	
+	// Recording Start (Unix Time in Milliseconds)
+	uint64_t started;
+} __attribute__((packed)) SceNetAdhocctlTraceHeader;
+
+// Trace Record (followed by its Payload, Host Byte Order)
+typedef struct
+{
+	// Microseconds since the previous Record
+	uint32_t delta;
+	
+	// Connection Number (unique within the Trace)
+	uint32_t connection;
+	
+	// Record Type
+	uint8_t type;
+	
+	// Payload Size (C2S Packets are at most 144 Bytes)
+	uint8_t size;
+} __attribute__((packed)) SceNetAdhocctlTraceRecord;
+
+// Trace Recorder running (Producers skip the Trace otherwise)
+extern int _trace_running;
+
+// Record Trace Event (Arguments aren't evaluated while the Recorder is off)
+#define trace_user(type, user, data, size) do { if(_trace_running) record_trace(type, user, data, size); } while(0)
+
+/**
+ * Start Trace Recorder Thread
+ * @param path Trace File (overwritten)
+ * @return 0 on Success or -1 on Error
+ */
+int start_trace(const char * path);
+
+/**
+ * Stop Trace Recorder Thread (writes the pending Records first)
+ */
+void stop_trace(void);
+
+/**
+ * Record Trace Event (use trace_user)
+ * @param type Record Type
+ * @param user User Node
+ * @param data Payload (NULL if none)
+ * @param size Payload Size
+ */
+void record_trace(int type, SceNetAdhocctlUserNode * user, const void * data, uint32_t size);
+
+#endif
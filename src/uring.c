@@ -0,0 +1,1177 @@
+/*
+ * This file is part of PRO ONLINE.
+
+ * PRO ONLINE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * PRO ONLINE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PRO ONLINE. If not, see <http://www.gnu.org/licenses/ .
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <netinet/in.h>
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+#endif
+#include <uring.h>
+#include <loop.h>
+#include <metrics.h>
+#include <config.h>
+#include <log.h>
+
+// I/O Ring of the calling Thread is running
+__thread int _uring_active = 0;
+
+// Ring Backend (needs Linux 6.1 Headers, older Build Hosts get Stubs that keep every Thread on epoll)
+#if defined(IORING_SETUP_DEFER_TASKRUN) && defined(__NR_io_uring_setup)
+
+// Completion Tags (lowest User Data Bits, Sends carry their 8-Byte aligned Send Pointer)
+#define URING_TAG_MASK 7
+#define URING_TAG_SEND 0
+#define URING_TAG_EPOLL 1
+#define URING_TAG_ACCEPT 2
+#define URING_TAG_CANCEL 3
+#define URING_TAG_RECV 4 // Socket in Bits 3-31, Watch Generation in Bits 32-63
+
+// Provided Buffer Group of the Receive Buffers
+#define URING_BUFFER_GROUP 0
+
+// Listener Retry Delay after Accept Errors (in milliseconds)
+#define URING_ACCEPT_RETRY 1000
+
+// Send Drain Limit on Shutdown (in milliseconds, Users with unsent Data get hung up afterwards)
+#define URING_STOP_TIMEOUT 5000
+
+// Socket Slot (maps Completions to the User watching the Socket)
+typedef struct
+{
+	// User Node (NULL if unwatched)
+	SceNetAdhocctlUserNode * user;
+	
+	// Watch Generation (Completions of earlier Watches are stale)
+	uint32_t generation;
+} SceNetAdhocctlUringSlot;
+
+// Scheduled Send
+typedef struct
+{
+	// User Socket
+	int fd;
+	
+	// Watch Generation
+	uint32_t generation;
+} SceNetAdhocctlUringQueued;
+
+// I/O Ring State
+typedef struct
+{
+	// Ring Descriptor
+	int fd;
+	
+	// Ring Mappings
+	uint8_t * sq;
+	size_t sqsize;
+	uint8_t * cq;
+	size_t cqsize;
+	struct io_uring_sqe * sqes;
+	size_t sqessize;
+	
+	// Submission Queue
+	uint32_t * sqhead;
+	uint32_t * sqtail;
+	uint32_t sqmask;
+	uint32_t sqentries;
+	uint32_t sqprepared;
+	
+	// Completion Queue
+	uint32_t * cqhead;
+	uint32_t * cqtail;
+	uint32_t cqmask;
+	struct io_uring_cqe * cqes;
+	
+	// Provided Receive Buffers
+	struct io_uring_buf_ring * bufring;
+	size_t bufringsize;
+	uint8_t * buffers;
+	uint16_t buftail;
+	
+	// Socket Slots (indexed by Socket)
+	SceNetAdhocctlUringSlot * slots;
+	uint32_t slotcount;
+	uint32_t generation;
+	
+	// Scheduled Sends
+	SceNetAdhocctlUringQueued * queue;
+	uint32_t queuelen;
+	uint32_t queuesize;
+	
+	// Sends in Flight
+	uint32_t sends;
+	
+	// Event Poll (polled through the Ring)
+	int epoll;
+	int epollarmed;
+	
+	// Listener armed & Retry Time
+	int acceptarmed;
+	uint64_t acceptretry;
+	
+	// Multishot Receive supported
+	int multishot;
+	
+	// Ring is being stopped (Completions only release their Resources, Sends still finish)
+	int stopping;
+	
+	// Sends were cancelled (Users with unsent Data get hung up)
+	int hangup;
+} SceNetAdhocctlUring;
+
+// I/O Ring of the calling Thread
+static __thread SceNetAdhocctlUring _uring;
+
+// Function Prototypes
+void release_uring(void);
+struct io_uring_sqe * get_uring_sqe(void);
+void submit_uring(void);
+void cancel_uring(uint64_t data);
+void flush_uring_sends(void);
+SceNetAdhocctlUringSlot * find_uring_slot(SceNetAdhocctlUserNode * user);
+SceNetAdhocctlUserNode * find_uring_user(int fd, uint32_t generation);
+void recycle_uring_buffer(uint16_t bid);
+void arm_uring_poll(void);
+void arm_uring_accept(int server);
+void arm_uring_recv(SceNetAdhocctlUserNode * user, uint32_t generation);
+void start_uring_send(SceNetAdhocctlUserNode * user, uint32_t generation);
+void prepare_uring_send(struct io_uring_sqe * sqe, SceNetAdhocctlUringSend * send);
+void complete_uring_accept(int server, int result, uint32_t flags);
+void complete_uring_recv(uint64_t data, int result, uint32_t flags);
+void complete_uring_send(SceNetAdhocctlUringSend * send, int result);
+
+/**
+ * Start I/O Ring for the calling Thread (User Sockets move from the Event Poll to the Ring)
+ * @param epoll Event Poll of the calling Thread (keeps the remaining Event Sources, waited on through the Ring)
+ * @param server Server Listening Socket (-1 for Worker Loops)
+ * @return 0 on Success or -1 if the Kernel lacks the required Ring Features
+ */
+int start_uring(int epoll, int server)
+{
+	// Setup Flags (newest Kernels first, Task Work only runs while the Thread waits on the Ring)
+	static const uint32_t setups[] = {
+		IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN | IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN,
+		IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN,
+		IORING_SETUP_CQSIZE,
+	};
+	
+	// Clear Ring State
+	memset(&_uring, 0, sizeof(_uring));
+	_uring.fd = -1;
+	
+	// Create Ring (the Completion Queue absorbs Send Fan-Outs)
+	struct io_uring_params params;
+	uint32_t i = 0; for(; i < sizeof(setups) / sizeof(setups[0]) && _uring.fd == -1; i++)
+	{
+		memset(&params, 0, sizeof(params));
+		params.flags = setups[i];
+		params.cq_entries = SERVER_URING_ENTRIES * 4;
+		_uring.fd = (int)syscall(__NR_io_uring_setup, SERVER_URING_ENTRIES, &params);
+	}
+	
+	// Ring unavailable (old Kernel, Seccomp Filter or disabled by Sysctl)
+	if(_uring.fd == -1)
+	{
+		// Notify User
+		log_text(LOG_LEVEL_WARNING, "%s: io_uring_setup failed (%s), falling back to epoll.", __func__, strerror(errno));
+		
+		// Return Error
+		return -1;
+	}
+	
+	// Timed Waits and lossless Completion Queue required
+	if(!(params.features & IORING_FEAT_EXT_ARG) || !(params.features & IORING_FEAT_NODROP))
+	{
+		// Notify User
+		log_text(LOG_LEVEL_WARNING, "%s: io_uring lacks Timed Waits or lossless Completions (Features 0x%x), falling back to epoll.", __func__, params.features);
+		
+		// Release Ring
+		release_uring();
+		
+		// Return Error
+		return -1;
+	}
+	
+	// Ring Mapping Sizes
+	_uring.sqsize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+	_uring.cqsize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	_uring.sqessize = params.sq_entries * sizeof(struct io_uring_sqe);
+	
+	// Both Queues share one Mapping
+	if(params.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		if(_uring.cqsize > _uring.sqsize) _uring.sqsize = _uring.cqsize;
+		_uring.cqsize = 0;
+	}
+	
+	// Map Submission Queue
+	void * sq = mmap(NULL, _uring.sqsize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _uring.fd, IORING_OFF_SQ_RING);
+	_uring.sq = (sq != MAP_FAILED) ? (uint8_t *)sq : NULL;
+	
+	// Map Completion Queue
+	void * cq = (_uring.cqsize > 0) ? mmap(NULL, _uring.cqsize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _uring.fd, IORING_OFF_CQ_RING) : sq;
+	_uring.cq = (cq != MAP_FAILED && _uring.cqsize > 0) ? (uint8_t *)cq : NULL;
+	
+	// Map Submission Queue Entries
+	void * sqes = mmap(NULL, _uring.sqessize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _uring.fd, IORING_OFF_SQES);
+	_uring.sqes = (sqes != MAP_FAILED) ? (struct io_uring_sqe *)sqes : NULL;
+	
+	// Map Provided Buffer Ring (Page-aligned)
+	_uring.bufringsize = SERVER_URING_BUFFERS * sizeof(struct io_uring_buf);
+	void * bufring = mmap(NULL, _uring.bufringsize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	_uring.bufring = (bufring != MAP_FAILED) ? (struct io_uring_buf_ring *)bufring : NULL;
+	
+	// Allocate Receive Buffers, Socket Slots and Send Schedule
+	_uring.buffers = (uint8_t *)malloc(SERVER_URING_BUFFERS * SERVER_URING_BUFFER_SIZE);
+	_uring.slotcount = 1024;
+	_uring.slots = (SceNetAdhocctlUringSlot *)calloc(_uring.slotcount, sizeof(SceNetAdhocctlUringSlot));
+	_uring.queuesize = 64;
+	_uring.queue = (SceNetAdhocctlUringQueued *)malloc(_uring.queuesize * sizeof(SceNetAdhocctlUringQueued));
+	
+	// Mapping or Allocation failed
+	if(_uring.sq == NULL || cq == MAP_FAILED || _uring.sqes == NULL || _uring.bufring == NULL || _uring.buffers == NULL || _uring.slots == NULL || _uring.queue == NULL)
+	{
+		// Notify User
+		log_text(LOG_LEVEL_WARNING, "%s: failed to map the io_uring Queues or allocate its Buffers, falling back to epoll.", __func__);
+		
+		// Release Ring
+		release_uring();
+		
+		// Return Error
+		return -1;
+	}
+	
+	// Link Submission Queue (Entries are used in Array Order)
+	_uring.sqhead = (uint32_t *)(_uring.sq + params.sq_off.head);
+	_uring.sqtail = (uint32_t *)(_uring.sq + params.sq_off.tail);
+	_uring.sqmask = *(uint32_t *)(_uring.sq + params.sq_off.ring_mask);
+	_uring.sqentries = params.sq_entries;
+	_uring.sqprepared = *_uring.sqtail;
+	uint32_t * array = (uint32_t *)(_uring.sq + params.sq_off.array);
+	for(i = 0; i < params.sq_entries; i++) array[i] = i;
+	
+	// Link Completion Queue
+	uint8_t * cqbase = (_uring.cq != NULL) ? _uring.cq : _uring.sq;
+	_uring.cqhead = (uint32_t *)(cqbase + params.cq_off.head);
+	_uring.cqtail = (uint32_t *)(cqbase + params.cq_off.tail);
+	_uring.cqmask = *(uint32_t *)(cqbase + params.cq_off.ring_mask);
+	_uring.cqes = (struct io_uring_cqe *)(cqbase + params.cq_off.cqes);
+	
+	// Register Provided Buffer Ring
+	struct io_uring_buf_reg reg;
+	memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = (uint64_t)(uintptr_t)_uring.bufring;
+	reg.ring_entries = SERVER_URING_BUFFERS;
+	reg.bgid = URING_BUFFER_GROUP;
+	if(syscall(__NR_io_uring_register, _uring.fd, IORING_REGISTER_PBUF_RING, &reg, 1) == -1)
+	{
+		// Notify User (Provided Buffer Rings, Multishot Accept and Cancel by Socket arrived with Linux 5.19)
+		log_text(LOG_LEVEL_WARNING, "%s: io_uring lacks Provided Buffer Rings (%s), falling back to epoll.", __func__, strerror(errno));
+		
+		// Release Ring
+		release_uring();
+		
+		// Return Error
+		return -1;
+	}
+	
+	// Provide Receive Buffers
+	uint16_t bid = 0; for(; bid < SERVER_URING_BUFFERS; bid++) recycle_uring_buffer(bid);
+	
+	// Assume Multishot Receive (Linux 6.0, the first rejected Receive switches to single Receives)
+	_uring.multishot = 1;
+	
+	// Save Event Poll
+	_uring.epoll = epoll;
+	
+	// Ring is running
+	_uring_active = 1;
+	
+	// Poll Event Poll (Timers, Wakeups and HTTP Clients stay there)
+	arm_uring_poll();
+	
+	// Accept Logins
+	if(server != -1) arm_uring_accept(server);
+	
+	// Return Success
+	return 0;
+}
+
+/**
+ * Stop I/O Ring of the calling Thread (cancels Receives, Listener & Event Poll and drains the Sends)
+ */
+void stop_uring(void)
+{
+	// Completions only release their Resources from now on
+	_uring.stopping = 1;
+	
+	// Cancel Listener & Event Poll
+	cancel_uring(URING_TAG_ACCEPT);
+	cancel_uring(URING_TAG_EPOLL);
+	
+	// Cancel Receives of watched Users
+	uint32_t i = 0; for(; i < _uring.slotcount; i++)
+	{
+		// Watched Socket
+		if(_uring.slots[i].user != NULL) cancel_uring(((uint64_t)_uring.slots[i].generation << 32) | ((uint64_t)i << 3) | URING_TAG_RECV);
+	}
+	
+	// Drain Deadline
+	update_loop_clock();
+	uint64_t deadline = _loop_clock + URING_STOP_TIMEOUT;
+	
+	// Send queued Data (a cut Packet would garble the Shutdown Notice)
+	while(_uring.sends > 0 || _uring.queuelen > 0)
+	{
+		// Prepare scheduled Sends
+		flush_uring_sends();
+		
+		// Deadline passed
+		update_loop_clock();
+		if(!_uring.hangup && _loop_clock >= deadline)
+		{
+			// Log Hangup
+			log_text(LOG_LEVEL_WARNING, "%s: %u Sends didn't drain in time, hanging up their Users.", __func__, _uring.sends);
+			
+			// Cancel remaining Sends (their Users get hung up)
+			_uring.hangup = 1;
+			struct io_uring_sqe * sqe = get_uring_sqe();
+			if(sqe != NULL)
+			{
+				sqe->opcode = IORING_OP_ASYNC_CANCEL;
+				sqe->cancel_flags = IORING_ASYNC_CANCEL_ANY;
+				sqe->user_data = URING_TAG_CANCEL;
+			}
+		}
+		
+		// Wait for Completions (Sends own their Queue Buffers, so none is left behind)
+		wait_uring(100);
+		process_uring(-1);
+	}
+	
+	// Ring stopped
+	_uring_active = 0;
+	
+	// Release Ring
+	release_uring();
+}
+
+/**
+ * Release I/O Ring Mappings, Buffers and Descriptor
+ */
+void release_uring(void)
+{
+	// Unmap Queues
+	if(_uring.sq != NULL) munmap(_uring.sq, _uring.sqsize);
+	if(_uring.cq != NULL) munmap(_uring.cq, _uring.cqsize);
+	if(_uring.sqes != NULL) munmap(_uring.sqes, _uring.sqessize);
+	
+	// Close Ring (unregisters the Buffer Ring)
+	if(_uring.fd != -1) close(_uring.fd);
+	
+	// Unmap Buffer Ring
+	if(_uring.bufring != NULL) munmap(_uring.bufring, _uring.bufringsize);
+	
+	// Free Buffers & Tables
+	free(_uring.buffers);
+	free(_uring.slots);
+	free(_uring.queue);
+	
+	// Clear Ring State
+	memset(&_uring, 0, sizeof(_uring));
+	_uring.fd = -1;
+}
+
+/**
+ * Submit prepared Operations and wait for Completions
+ * @param timeout Timeout in Milliseconds (-1 waits forever)
+ */
+void wait_uring(int timeout)
+{
+	// Publish prepared Operations
+	__atomic_store_n(_uring.sqtail, _uring.sqprepared, __ATOMIC_RELEASE);
+	
+	// Timeout
+	struct __kernel_timespec ts;
+	ts.tv_sec = timeout / 1000;
+	ts.tv_nsec = (timeout % 1000) * 1000000LL;
+	
+	// Wait Arguments (no Timeout for negative Values)
+	struct io_uring_getevents_arg arg;
+	memset(&arg, 0, sizeof(arg));
+	if(timeout >= 0) arg.ts = (uint64_t)(uintptr_t)&ts;
+	
+	// Submit and wait for one Completion (interrupted by Shutdown Signals)
+	syscall(__NR_io_uring_enter, _uring.fd, _uring.sqprepared - __atomic_load_n(_uring.sqhead, __ATOMIC_ACQUIRE), 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+}
+
+/**
+ * Process Completions (Logins, User Data and finished Sends)
+ * @param server Server Listening Socket (-1 for Worker Loops)
+ * @return 1 if the Event Poll has ready Events or 0 otherwise
+ */
+int process_uring(int server)
+{
+	// Event Poll Readiness
+	int ready = 0;
+	
+	// Completions available now (later ones wait for the next Iteration)
+	uint32_t head = *_uring.cqhead;
+	uint32_t tail = __atomic_load_n(_uring.cqtail, __ATOMIC_ACQUIRE);
+	
+	// Iterate Completions
+	while(head != tail)
+	{
+		// Copy Completion
+		struct io_uring_cqe cqe = _uring.cqes[head & _uring.cqmask];
+		
+		// Release Completion Slot (Handlers might submit)
+		__atomic_store_n(_uring.cqhead, ++head, __ATOMIC_RELEASE);
+		
+		// Dispatch Completion
+		switch(cqe.user_data & URING_TAG_MASK)
+		{
+			// Send finished
+			case URING_TAG_SEND:
+				complete_uring_send((SceNetAdhocctlUringSend *)(uintptr_t)cqe.user_data, cqe.res);
+				break;
+			
+			// Event Poll ready (single Poll, re-armed by the Flush)
+			case URING_TAG_EPOLL:
+				_uring.epollarmed = 0;
+				ready = !_uring.stopping;
+				break;
+			
+			// Login Request
+			case URING_TAG_ACCEPT:
+				complete_uring_accept(server, cqe.res, cqe.flags);
+				break;
+			
+			// User Data
+			case URING_TAG_RECV:
+				complete_uring_recv(cqe.user_data, cqe.res, cqe.flags);
+				break;
+		}
+	}
+	
+	// Return Event Poll Readiness
+	return ready;
+}
+
+/**
+ * Prepare scheduled Sends and re-arm finished Operations (call at the End of every Loop Iteration)
+ * @param server Server Listening Socket (-1 for Worker Loops)
+ */
+void flush_uring(int server)
+{
+	// Prepare scheduled Sends
+	flush_uring_sends();
+	
+	// Re-arm Event Poll
+	if(!_uring.epollarmed) arm_uring_poll();
+	
+	// Re-arm Listener
+	if(server != -1 && !_uring.acceptarmed && _loop_clock >= _uring.acceptretry) arm_uring_accept(server);
+}
+
+/**
+ * Prepare scheduled Sends (one Batch of Sends per Call, submitted by the next Wait)
+ */
+void flush_uring_sends(void)
+{
+	// Iterate scheduled Sends
+	uint32_t i = 0; for(; i < _uring.queuelen; i++)
+	{
+		// Live User
+		SceNetAdhocctlUserNode * user = find_uring_user(_uring.queue[i].fd, _uring.queue[i].generation);
+		if(user == NULL) continue;
+		
+		// Clear Schedule Flag
+		user->info->txqueued = 0;
+		
+		// Send TX Queue (Users with a Send in Flight continue once it finished, hung up Users send nothing)
+		if(!_uring.hangup && user->info->txflight == NULL && user->txpos < user->txlen) start_uring_send(user, _uring.queue[i].generation);
+	}
+	
+	// Clear Schedule
+	_uring.queuelen = 0;
+}
+
+/**
+ * Receive User Data through the I/O Ring of the calling Thread
+ * @param user User Node
+ */
+void watch_uring_user(SceNetAdhocctlUserNode * user)
+{
+	// Grow Slot Table
+	if((uint32_t)user->stream >= _uring.slotcount)
+	{
+		// New Slot Count
+		uint32_t count = _uring.slotcount * 2;
+		while(count <= (uint32_t)user->stream) count *= 2;
+		
+		// Reallocate Slot Memory
+		SceNetAdhocctlUringSlot * slots = (SceNetAdhocctlUringSlot *)realloc(_uring.slots, count * sizeof(SceNetAdhocctlUringSlot));
+		
+		// Out of Memory
+		if(slots == NULL)
+		{
+			// Hangup Connection (nothing receives from it, the Timeout logs the User out)
+			shutdown(user->stream, SHUT_RDWR);
+			
+			// Stop Watching
+			return;
+		}
+		
+		// Clear new Slots
+		memset(slots + _uring.slotcount, 0, (count - _uring.slotcount) * sizeof(SceNetAdhocctlUringSlot));
+		
+		// Save Slot Table
+		_uring.slots = slots;
+		_uring.slotcount = count;
+	}
+	
+	// Link Slot (new Generation)
+	SceNetAdhocctlUringSlot * slot = &_uring.slots[user->stream];
+	slot->user = user;
+	slot->generation = ++_uring.generation;
+	
+	// Start Receiving
+	arm_uring_recv(user, slot->generation);
+	
+	// Send Data queued before the Watch (pipelined Packets of a Handoff)
+	if(user->txpos < user->txlen) queue_uring_send(user);
+}
+
+/**
+ * Stop receiving User Data through the I/O Ring (cancels pending Operations before the Socket gets closed)
+ * @param user User Node
+ */
+void unwatch_uring_user(SceNetAdhocctlUserNode * user)
+{
+	// Watching Slot
+	SceNetAdhocctlUringSlot * slot = find_uring_slot(user);
+	
+	// User isn't watched by this Ring
+	if(slot == NULL) return;
+	
+	// Unlink Slot (late Completions carry the old Generation)
+	slot->user = NULL;
+	
+	// Orphan Send in Flight (frees itself on Completion)
+	user->info->txflight = NULL;
+	
+	// Drop Schedule (the Entry went stale)
+	user->info->txqueued = 0;
+	
+	// Cancel Receive & Send of the Socket
+	struct io_uring_sqe * sqe = get_uring_sqe();
+	if(sqe != NULL)
+	{
+		sqe->opcode = IORING_OP_ASYNC_CANCEL;
+		sqe->fd = user->stream;
+		sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+		sqe->user_data = URING_TAG_CANCEL;
+	}
+	
+	// Submit right away (the Cancel resolves the Socket Number, which gets reused once it's closed)
+	submit_uring();
+}
+
+/**
+ * Schedule Send of the User TX Queue (prepared with the next Flush)
+ * @param user User Node
+ */
+void queue_uring_send(SceNetAdhocctlUserNode * user)
+{
+	// Watching Slot
+	SceNetAdhocctlUringSlot * slot = find_uring_slot(user);
+	
+	// Unwatched or already scheduled
+	if(slot == NULL || user->info->txqueued) return;
+	
+	// Grow Schedule
+	if(_uring.queuelen == _uring.queuesize)
+	{
+		// Reallocate Schedule Memory
+		SceNetAdhocctlUringQueued * queue = (SceNetAdhocctlUringQueued *)realloc(_uring.queue, _uring.queuesize * 2 * sizeof(SceNetAdhocctlUringQueued));
+		
+		// Out of Memory (the Data stays queued until the next Send schedules it)
+		if(queue == NULL) return;
+		
+		// Save Schedule
+		_uring.queue = queue;
+		_uring.queuesize *= 2;
+	}
+	
+	// Schedule Send
+	_uring.queue[_uring.queuelen].fd = user->stream;
+	_uring.queue[_uring.queuelen].generation = slot->generation;
+	_uring.queuelen++;
+	
+	// Set Schedule Flag
+	user->info->txqueued = 1;
+}
+
+/**
+ * Get free Submission Queue Entry (submits prepared Operations if the Queue is full)
+ * @return Cleared Submission Queue Entry or NULL if the Queue stays full
+ */
+struct io_uring_sqe * get_uring_sqe(void)
+{
+	// Queue full
+	if(_uring.sqprepared - __atomic_load_n(_uring.sqhead, __ATOMIC_ACQUIRE) >= _uring.sqentries)
+	{
+		// Submit prepared Operations
+		submit_uring();
+		
+		// Kernel didn't take any
+		if(_uring.sqprepared - __atomic_load_n(_uring.sqhead, __ATOMIC_ACQUIRE) >= _uring.sqentries) return NULL;
+	}
+	
+	// Next Entry
+	struct io_uring_sqe * sqe = &_uring.sqes[_uring.sqprepared & _uring.sqmask];
+	_uring.sqprepared++;
+	
+	// Clear Entry
+	memset(sqe, 0, sizeof(struct io_uring_sqe));
+	
+	// Return Entry
+	return sqe;
+}
+
+/**
+ * Submit prepared Operations without waiting
+ */
+void submit_uring(void)
+{
+	// Publish prepared Operations
+	__atomic_store_n(_uring.sqtail, _uring.sqprepared, __ATOMIC_RELEASE);
+	
+	// Submit Operations
+	syscall(__NR_io_uring_enter, _uring.fd, _uring.sqprepared - __atomic_load_n(_uring.sqhead, __ATOMIC_ACQUIRE), 0, 0, NULL, 0);
+}
+
+/**
+ * Cancel Operations by User Data
+ * @param data User Data of the Operations
+ */
+void cancel_uring(uint64_t data)
+{
+	// Cancel Operations
+	struct io_uring_sqe * sqe = get_uring_sqe();
+	if(sqe != NULL)
+	{
+		sqe->opcode = IORING_OP_ASYNC_CANCEL;
+		sqe->addr = data;
+		sqe->cancel_flags = IORING_ASYNC_CANCEL_ALL;
+		sqe->user_data = URING_TAG_CANCEL;
+	}
+}
+
+/**
+ * Find Slot watching a User
+ * @param user User Node
+ * @return Slot or NULL if the User isn't watched by this Ring
+ */
+SceNetAdhocctlUringSlot * find_uring_slot(SceNetAdhocctlUserNode * user)
+{
+	// Ring not running or Socket beyond the Slot Table
+	if(!_uring_active || (uint32_t)user->stream >= _uring.slotcount) return NULL;
+	
+	// Slot of the Socket
+	SceNetAdhocctlUringSlot * slot = &_uring.slots[user->stream];
+	
+	// Return Slot (if it's watching this User)
+	return (slot->user == user) ? slot : NULL;
+}
+
+/**
+ * Find User of a Completion
+ * @param fd User Socket
+ * @param generation Watch Generation
+ * @return User Node or NULL if the Completion is stale
+ */
+SceNetAdhocctlUserNode * find_uring_user(int fd, uint32_t generation)
+{
+	// Socket beyond the Slot Table
+	if((uint32_t)fd >= _uring.slotcount) return NULL;
+	
+	// Slot of the Socket
+	SceNetAdhocctlUringSlot * slot = &_uring.slots[fd];
+	
+	// Return User (if it's still the same Watch)
+	return (slot->generation == generation) ? slot->user : NULL;
+}
+
+/**
+ * Give Receive Buffer back to the Kernel
+ * @param bid Buffer ID
+ */
+void recycle_uring_buffer(uint16_t bid)
+{
+	// Fill next Ring Entry
+	struct io_uring_buf * buf = &_uring.bufring->bufs[_uring.buftail & (SERVER_URING_BUFFERS - 1)];
+	buf->addr = (uint64_t)(uintptr_t)(_uring.buffers + (uint32_t)bid * SERVER_URING_BUFFER_SIZE);
+	buf->len = SERVER_URING_BUFFER_SIZE;
+	buf->bid = bid;
+	
+	// Publish Entry
+	__atomic_store_n(&_uring.bufring->tail, ++_uring.buftail, __ATOMIC_RELEASE);
+}
+
+/**
+ * Poll Event Poll through the Ring
+ */
+void arm_uring_poll(void)
+{
+	// Get Entry
+	struct io_uring_sqe * sqe = get_uring_sqe();
+	if(sqe == NULL) return;
+	
+	// Single Poll (the Event Poll stays ready until drained, so re-arming can't miss Events)
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = _uring.epoll;
+	sqe->poll32_events = POLLIN;
+	sqe->user_data = URING_TAG_EPOLL;
+	
+	// Poll armed
+	_uring.epollarmed = 1;
+}
+
+/**
+ * Accept Logins through the Ring
+ * @param server Server Listening Socket
+ */
+void arm_uring_accept(int server)
+{
+	// Get Entry
+	struct io_uring_sqe * sqe = get_uring_sqe();
+	if(sqe == NULL) return;
+	
+	// Multishot Accept (the Peer Address is read per Socket, all Completions would share one Buffer)
+	sqe->opcode = IORING_OP_ACCEPT;
+	sqe->fd = server;
+	sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+	sqe->accept_flags = SOCK_NONBLOCK;
+	sqe->user_data = URING_TAG_ACCEPT;
+	
+	// Listener armed
+	_uring.acceptarmed = 1;
+}
+
+/**
+ * Receive User Data through the Ring
+ * @param user User Node
+ * @param generation Watch Generation
+ */
+void arm_uring_recv(SceNetAdhocctlUserNode * user, uint32_t generation)
+{
+	// Get Entry
+	struct io_uring_sqe * sqe = get_uring_sqe();
+	
+	// Ring overloaded
+	if(sqe == NULL)
+	{
+		// Hangup Connection (nothing receives from it, the Timeout logs the User out)
+		shutdown(user->stream, SHUT_RDWR);
+		
+		// Stop Receiving
+		return;
+	}
+	
+	// Receive into a provided Buffer
+	sqe->opcode = IORING_OP_RECV;
+	sqe->fd = user->stream;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = URING_BUFFER_GROUP;
+	sqe->user_data = ((uint64_t)generation << 32) | ((uint64_t)(uint32_t)user->stream << 3) | URING_TAG_RECV;
+	
+	// Logged-In Users receive continuously
+	if(_uring.multishot && get_user_state(user) == USER_STATE_LOGGED_IN) sqe->ioprio = IORING_RECV_MULTISHOT;
+	
+	// Logins receive one RX Ring Fill at a Time (a Handoff mustn't leave received Data behind)
+	else sqe->len = USER_RXBUF_SIZE - (uint16_t)(user->rxtail - user->rxhead);
+}
+
+/**
+ * Send TX Queue through the Ring
+ * @param user User Node
+ * @param generation Watch Generation
+ */
+void start_uring_send(SceNetAdhocctlUserNode * user, uint32_t generation)
+{
+	// Allocate Send
+	SceNetAdhocctlUringSend * send = (SceNetAdhocctlUringSend *)malloc(sizeof(SceNetAdhocctlUringSend));
+	if(send == NULL) return;
+	
+	// Get Entry
+	struct io_uring_sqe * sqe = get_uring_sqe();
+	
+	// Ring overloaded (rescheduled with the next Send)
+	if(sqe == NULL)
+	{
+		// Free Send
+		free(send);
+		
+		// Stop Sending
+		return;
+	}
+	
+	// Take TX Queue over (new Data queues up in a fresh Buffer behind it)
+	send->fd = user->stream;
+	send->generation = generation;
+	send->data = user->tx;
+	send->pos = user->txpos;
+	send->len = user->txlen;
+	user->tx = NULL;
+	user->txpos = user->txlen = user->txsize = 0;
+	
+	// Link Send
+	user->info->txflight = send;
+	
+	// Count Send
+	_uring.sends++;
+	
+	// Prepare Send
+	prepare_uring_send(sqe, send);
+}
+
+/**
+ * Prepare Send of the unsent Part
+ * @param sqe Submission Queue Entry
+ * @param send Send
+ */
+void prepare_uring_send(struct io_uring_sqe * sqe, SceNetAdhocctlUringSend * send)
+{
+	sqe->opcode = IORING_OP_SEND;
+	sqe->fd = send->fd;
+	sqe->addr = (uint64_t)(uintptr_t)(send->data + send->pos);
+	sqe->len = send->len - send->pos;
+	sqe->msg_flags = MSG_NOSIGNAL;
+	sqe->user_data = (uint64_t)(uintptr_t)send;
+}
+
+/**
+ * Handle Accept Completion
+ * @param server Server Listening Socket
+ * @param result Accepted Socket or negative Error Code
+ * @param flags Completion Flags
+ */
+void complete_uring_accept(int server, int result, uint32_t flags)
+{
+	// Multishot Accept ended
+	if(!(flags & IORING_CQE_F_MORE))
+	{
+		// Listener disarmed
+		_uring.acceptarmed = 0;
+		
+		// Accept Error (out of Descriptors or Memory, retried a little later)
+		if(result < 0)
+		{
+			// Notify User
+			log_text(LOG_LEVEL_WARNING, "%s: accept failed (%s), retrying in %u ms.", __func__, strerror(-result), URING_ACCEPT_RETRY);
+			
+			// Delay Retry
+			_uring.acceptretry = _loop_clock + URING_ACCEPT_RETRY;
+		}
+	}
+	
+	// No Socket
+	if(result < 0) return;
+	
+	// Ring is being stopped
+	if(_uring.stopping)
+	{
+		// Close Stream
+		close(result);
+		
+		// Stop Processing
+		return;
+	}
+	
+	// Prepare Address Structure
+	struct sockaddr_in addr;
+	socklen_t addrlen = sizeof(addr);
+	memset(&addr, 0, sizeof(addr));
+	
+	// Peer already gone
+	if(getpeername(result, (struct sockaddr *)&addr, &addrlen) == -1)
+	{
+		// Close Stream
+		close(result);
+		
+		// Stop Processing
+		return;
+	}
+	
+	// Login User (Stream)
+	SceNetAdhocctlUserNode * user = login_user_stream(result, addr.sin_addr.s_addr);
+	
+	// Watch User Socket
+	if(user != NULL) watch_uring_user(user);
+}
+
+/**
+ * Handle Receive Completion
+ * @param data Completion User Data (Socket & Watch Generation)
+ * @param result Received Bytes or negative Error Code
+ * @param flags Completion Flags
+ */
+void complete_uring_recv(uint64_t data, int result, uint32_t flags)
+{
+	// Watch Generation
+	uint32_t generation = (uint32_t)(data >> 32);
+	
+	// Received Buffer
+	int buffered = (flags & IORING_CQE_F_BUFFER) != 0;
+	uint16_t bid = (uint16_t)(flags >> IORING_CQE_BUFFER_SHIFT);
+	const uint8_t * buffer = _uring.buffers + (uint32_t)bid * SERVER_URING_BUFFER_SIZE;
+	
+	// Live User
+	SceNetAdhocctlUserNode * user = find_uring_user((int)((uint32_t)data >> 3), generation);
+	
+	// Stale Completion or Ring being stopped
+	if(user == NULL || _uring.stopping)
+	{
+		// Give Buffer back
+		if(buffered) recycle_uring_buffer(bid);
+		
+		// Stop Processing
+		return;
+	}
+	
+	// Data received
+	if(result > 0 && buffered && get_user_state(user) != USER_STATE_TIMED_OUT)
+	{
+		// Update Death Clock
+		touch_user(user);
+		
+		// Copy Data into the RX Ring
+		uint32_t offset = 0;
+		while(1)
+		{
+			// Free Space behind the Ring Tail (wraps around at most once)
+			uint32_t tail = user->rxtail & (USER_RXBUF_SIZE - 1);
+			uint32_t space = USER_RXBUF_SIZE - (uint16_t)(user->rxtail - user->rxhead);
+			uint32_t size = (uint32_t)result - offset;
+			if(size > space) size = space;
+			uint32_t first = USER_RXBUF_SIZE - tail;
+			if(first > size) first = size;
+			memcpy(user->info->rx + tail, buffer + offset, first);
+			memcpy(user->info->rx, buffer + offset + first, size - first);
+			
+			// Move Ring Tail
+			user->rxtail += size;
+			offset += size;
+			
+			// Copied everything
+			if(offset == (uint32_t)result) break;
+			
+			// Make Room (only continuous Receives exceed the RX Ring, Logins can't hand off here)
+			if(process_user_packets(user) == -1)
+			{
+				// Give Buffer back
+				recycle_uring_buffer(bid);
+				
+				// Stop Processing
+				return;
+			}
+		}
+		
+		// Give Buffer back
+		recycle_uring_buffer(bid);
+		
+		// Process all complete Packets (stop if the User was logged out or handed off)
+		if(process_user_packets(user) == -1) return;
+	}
+	
+	// No Data
+	else
+	{
+		// Give Buffer back
+		if(buffered) recycle_uring_buffer(bid);
+		
+		// Kernel rejects Multishot Receive
+		if(result == -EINVAL && _uring.multishot)
+		{
+			// Notify User
+			log_text(LOG_LEVEL_WARNING, "%s: io_uring rejects Multishot Receive, switching to single Receives.", __func__);
+			
+			// Switch to single Receives
+			_uring.multishot = 0;
+		}
+		
+		// Connection Closed, Failed or Timed Out (out of Buffers just re-arms)
+		else if(result != -ENOBUFS)
+		{
+			// Count Timeout
+			if(get_user_state(user) == USER_STATE_TIMED_OUT) count_metric(timeouts, 1);
+			
+			// Logout User
+			logout_user(user);
+			
+			// Stop Processing
+			return;
+		}
+	}
+	
+	// Re-arm finished Receive
+	if(!(flags & IORING_CQE_F_MORE)) arm_uring_recv(user, generation);
+}
+
+/**
+ * Handle Send Completion
+ * @param send Send
+ * @param result Sent Bytes or negative Error Code
+ */
+void complete_uring_send(SceNetAdhocctlUringSend * send, int result)
+{
+	// Live User (still owning this Send)
+	SceNetAdhocctlUserNode * user = find_uring_user(send->fd, send->generation);
+	if(user != NULL && user->info->txflight != send) user = NULL;
+	
+	// Move Send Pointer
+	if(result > 0) send->pos += result;
+	
+	// Short Send of a live User (also while stopping, unless the Sends were cancelled)
+	if(user != NULL && !_uring.hangup && result > 0 && send->pos < send->len)
+	{
+		// Count Short Write
+		count_metric(txshort, 1);
+		
+		// Send the Rest (the next Queue waits, which keeps the Byte Order)
+		struct io_uring_sqe * sqe = get_uring_sqe();
+		if(sqe != NULL)
+		{
+			prepare_uring_send(sqe, send);
+			return;
+		}
+	}
+	
+	// Failed, cancelled or cut Send of a live User
+	if(user != NULL && send->pos < send->len)
+	{
+		// Hangup Connection (the Receive logs the User out)
+		shutdown(send->fd, SHUT_RDWR);
+		
+		// Drop unsent Data (anything sent later would continue mid-Packet)
+		user->txpos = user->txlen = 0;
+	}
+	
+	// Free Send (finished, failed, cancelled or stale)
+	free(send->data);
+	free(send);
+	_uring.sends--;
+	
+	// Live User
+	if(user != NULL)
+	{
+		// Unlink Send
+		user->info->txflight = NULL;
+		
+		// Send Data queued meanwhile
+		if(!_uring.hangup && user->txpos < user->txlen) queue_uring_send(user);
+	}
+}
+
+#else
+
+/**
+ * Start I/O Ring for the calling Thread (built without Ring Headers)
+ * @param epoll Unused
+ * @param server Unused
+ * @return -1 (the Thread stays on epoll)
+ */
+int start_uring(int epoll, int server)
+{
+	// Notify User
+	log_text(LOG_LEVEL_WARNING, "%s: built without io_uring Support, falling back to epoll.", __func__);
+	
+	// Return Error
+	return -1;
+}
+
+/**
+ * Stop I/O Ring of the calling Thread (never started)
+ */
+void stop_uring(void)
+{
+}
+
+/**
+ * Wait for Completions (never called, the Ring never starts)
+ * @param timeout Unused
+ */
+void wait_uring(int timeout)
+{
+}
+
+/**
+ * Process Completions (never called, the Ring never starts)
+ * @param server Unused
+ * @return 0
+ */
+int process_uring(int server)
+{
+	// Return Idle Event Poll
+	return 0;
+}
+
+/**
+ * Prepare scheduled Sends (never called, the Ring never starts)
+ * @param server Unused
+ */
+void flush_uring(int server)
+{
+}
+
+/**
+ * Receive User Data through the I/O Ring (never called, the Ring never starts)
+ * @param user Unused
+ */
+void watch_uring_user(SceNetAdhocctlUserNode * user)
+{
+}
+
+/**
+ * Stop receiving User Data through the I/O Ring (never called, the Ring never starts)
+ * @param user Unused
+ */
+void unwatch_uring_user(SceNetAdhocctlUserNode * user)
+{
+}
+
+/**
+ * Schedule Send of the User TX Queue (never called, the Ring never starts)
+ * @param user Unused
+ */
+void queue_uring_send(SceNetAdhocctlUserNode * user)
+{
+}
+
+#endif
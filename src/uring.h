@@ -0,0 +1,94 @@
+/*
+ * This file is part of PRO ONLINE.
+
+ * PRO ONLINE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * PRO ONLINE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PRO ONLINE. If not, see <http://www.gnu.org/licenses/ .
+ */
+
+#ifndef _URING_H_
+#define _URING_H_
+
+#include <stdint.h>
+#include <user.h>
+
+// Ring Send (owns the TX Queue Buffer while the Kernel sends from it)
+typedef struct SceNetAdhocctlUringSend
+{
+	// User Socket
+	int fd;
+	
+	// Watch Generation of the User (Sends outliving their User complete as stale)
+	uint32_t generation;
+	
+	// Queue Buffer
+	uint8_t * data;
+	
+	// Sent & Total Bytes
+	uint32_t pos;
+	uint32_t len;
+} SceNetAdhocctlUringSend;
+
+// I/O Ring of the calling Thread is running (User Sockets bypass the Event Poll)
+extern __thread int _uring_active;
+
+/**
+ * Start I/O Ring for the calling Thread (User Sockets move from the Event Poll to the Ring)
+ * @param epoll Event Poll of the calling Thread (keeps the remaining Event Sources, waited on through the Ring)
+ * @param server Server Listening Socket (-1 for Worker Loops)
+ * @return 0 on Success or -1 if the Kernel lacks the required Ring Features
+ */
+int start_uring(int epoll, int server);
+
+/**
+ * Stop I/O Ring of the calling Thread (cancels Receives, Listener & Event Poll and drains the Sends)
+ */
+void stop_uring(void);
+
+/**
+ * Submit prepared Operations and wait for Completions
+ * @param timeout Timeout in Milliseconds (-1 waits forever)
+ */
+void wait_uring(int timeout);
+
+/**
+ * Process Completions (Logins, User Data and finished Sends)
+ * @param server Server Listening Socket (-1 for Worker Loops)
+ * @return 1 if the Event Poll has ready Events or 0 otherwise
+ */
+int process_uring(int server);
+
+/**
+ * Prepare scheduled Sends and re-arm finished Operations (call at the End of every Loop Iteration)
+ * @param server Server Listening Socket (-1 for Worker Loops)
+ */
+void flush_uring(int server);
+
+/**
+ * Receive User Data through the I/O Ring of the calling Thread
+ * @param user User Node
+ */
+void watch_uring_user(SceNetAdhocctlUserNode * user);
+
+/**
+ * Stop receiving User Data through the I/O Ring (cancels pending Operations before the Socket gets closed)
+ * @param user User Node
+ */
+void unwatch_uring_user(SceNetAdhocctlUserNode * user);
+
+/**
+ * Schedule Send of the User TX Queue (prepared with the next Flush)
+ * @param user User Node
+ */
+void queue_uring_send(SceNetAdhocctlUserNode * user);
+
+#endif
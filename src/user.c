@@ -21,86 +21,204 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/socket.h>
 #include <user.h>
 #include <status.h>
 #include <config.h>
-#include <sqlite3.h>
+#include <worker.h>
+#include <pool.h>
+#include <catalog.h>
+#include <loop.h>
+#include <log.h>
+#include <metrics.h>
+#include <feed.h>
+#include <trace.h>
+#include <settings.h>
+#include <uring.h>
 
-// User Count
+// User Count (all Threads)
 uint32_t _db_user_count = 0;
 
-// User Database
-SceNetAdhocctlUserNode * _db_user = NULL;
+// User Database (per Thread)
+__thread SceNetAdhocctlUserNode * _db_user = NULL;
 
-// Game Database
-SceNetAdhocctlGameNode * _db_game = NULL;
+// User Idle List (per Thread, least recently heard from first)
+__thread SceNetAdhocctlUserNode * _db_user_idle = NULL;
+static __thread SceNetAdhocctlUserNode * _db_user_idle_tail = NULL;
+
+// Game Database (per Thread)
+__thread SceNetAdhocctlGameNode * _db_game = NULL;
+
+// Game Hash Index (per Thread)
+static __thread SceNetAdhocctlGameNode * _db_game_hash[SERVER_GAME_HASH_BUCKETS];
+
+// Node Pools (all Threads)
+static SceNetAdhocctlPool _pool_user;
+static SceNetAdhocctlPool _pool_info;
+static SceNetAdhocctlPool _pool_game;
+static SceNetAdhocctlPool _pool_group;
+
+// User Hash Buckets (Power of 2, about the User Maximum)
+uint32_t _db_user_buckets = 0;
+
+// User Hash Indexes by IP and MAC (all Threads, guarded by the Index Lock)
+static SceNetAdhocctlUserNode ** _db_user_ip = NULL;
+static SceNetAdhocctlUserNode ** _db_user_mac = NULL;
+static pthread_mutex_t _db_index_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Batch Buffer (grown on Demand, reused across Calls)
+static __thread uint8_t * _batch = NULL;
+static __thread uint32_t _batch_size = 0;
+
+// Function Prototypes
+uint8_t * get_batch_buffer(uint32_t size);
+int grow_group_hash(SceNetAdhocctlGameNode * game);
+uint32_t hash_mac(SceNetEtherAddr * mac);
+int index_user_ip(SceNetAdhocctlUserNode * user);
+void index_user_mac(SceNetAdhocctlUserNode * user);
+void unindex_user(SceNetAdhocctlUserNode * user);
+
+/**
+ * Hash Game Product Code
+ * @param product Game Product Code
+ * @return FNV-1a Hash
+ */
+uint32_t hash_product_code(SceNetAdhocctlProductCode * product)
+{
+	// FNV-1a Hash over the Product Code
+	uint32_t hash = 2166136261U;
+	int i = 0; for(; i < PRODUCT_CODE_LENGTH; i++) hash = (hash ^ (uint8_t)product->data[i]) * 16777619U;
+	
+	// Return Hash
+	return hash;
+}
+
+/**
+ * Find Game in the Database of the calling Thread
+ * @param product Game Product Code
+ * @return Game Node or NULL
+ */
+SceNetAdhocctlGameNode * find_game(SceNetAdhocctlProductCode * product)
+{
+	// Iterate Hash Bucket
+	SceNetAdhocctlGameNode * game = _db_game_hash[hash_product_code(product) & (SERVER_GAME_HASH_BUCKETS - 1)];
+	while(game != NULL && memcmp(game->game.data, product->data, PRODUCT_CODE_LENGTH) != 0) game = game->hash_next;
+	
+	// Return Game Node
+	return game;
+}
+
+/**
+ * Hash Group Name
+ * @param group Group Name
+ * @return FNV-1a Hash (up to the first NUL, like the Group Name Comparison)
+ */
+uint32_t hash_group_name(SceNetAdhocctlGroupName * group)
+{
+	// FNV-1a Hash over the Group Name
+	uint32_t hash = 2166136261U;
+	int i = 0; for(; i < ADHOCCTL_GROUPNAME_LEN && group->data[i] != 0; i++) hash = (hash ^ group->data[i]) * 16777619U;
+	
+	// Return Hash
+	return hash;
+}
+
+/**
+ * Find Group in Game Node
+ * @param game Game Node
+ * @param group Group Name
+ * @return Group Node or NULL
+ */
+SceNetAdhocctlGroupNode * find_group(SceNetAdhocctlGameNode * game, SceNetAdhocctlGroupName * group)
+{
+	// No Groups yet
+	if(game->grouphashsize == 0) return NULL;
+	
+	// Iterate Hash Bucket
+	SceNetAdhocctlGroupNode * g = game->grouphash[hash_group_name(group) & (game->grouphashsize - 1)];
+	while(g != NULL && strncmp((char *)g->group.data, (char *)group->data, ADHOCCTL_GROUPNAME_LEN) != 0) g = g->hash_next;
+	
+	// Return Group Node
+	return g;
+}
 
 /**
  * Login User into Database (Stream)
  * @param fd Socket
  * @param ip IP Address (Network Order)
+ * @return User Node or NULL if the Connection was refused
  */
-void login_user_stream(int fd, uint32_t ip)
+SceNetAdhocctlUserNode * login_user_stream(int fd, uint32_t ip)
 {
 	// Enough Space available
-	if(_db_user_count < SERVER_USER_MAXIMUM)
+	if(__atomic_load_n(&_db_user_count, __ATOMIC_RELAXED) < _settings.usermax)
 	{
-		// Check IP Duplication
-		SceNetAdhocctlUserNode * u = _db_user;
-		while(u != NULL && u->resolver.ip != ip) u = u->next;
+		// Allocate User Node Memory (cleared)
+		SceNetAdhocctlUserNode * user = (SceNetAdhocctlUserNode *)alloc_pool(&_pool_user);
+		
+		// Allocate Cold User Data (cleared)
+		SceNetAdhocctlUserInfo * info = (SceNetAdhocctlUserInfo *)alloc_pool(&_pool_info);
 		
-		// Unique IP Address
-		if(u == NULL)
+		// Allocated User Node Memory
+		if(user != NULL && info != NULL)
 		{
-			// Allocate User Node Memory
-			SceNetAdhocctlUserNode * user = (SceNetAdhocctlUserNode *)malloc(sizeof(SceNetAdhocctlUserNode));
+			// Link Cold User Data
+			user->info = info;
+			
+			// Save Socket
+			user->stream = fd;
 			
-			// Allocated User Node Memory
-			if(user != NULL)
+			// Save IP
+			user->info->resolver.ip = ip;
+			
+			// Unique IP Address
+			if(index_user_ip(user) == 0)
 			{
-				// Clear Memory
-				memset(user, 0, sizeof(SceNetAdhocctlUserNode));
-				
-				// Save Socket
-				user->stream = fd;
-				
-				// Save IP
-				user->resolver.ip = ip;
+				// Initialize Death Clock
+				user->last_recv = _loop_clock;
 				
 				// Link into User List
-				user->next = _db_user;
-				if(_db_user != NULL) _db_user->prev = user;
-				_db_user = user;
+				attach_user(user);
 				
-				// Initialize Death Clock
-				user->last_recv = time(NULL);
+				// Record Connection
+				trace_user(TRACE_RECORD_CONNECT, user, &ip, sizeof(ip));
 				
 				// Notify User
-				uint8_t * ipa = (uint8_t *)&user->resolver.ip;
-				printf("New Connection from %u.%u.%u.%u.\n", ipa[0], ipa[1], ipa[2], ipa[3]);
+				log_user(LOG_LEVEL_INFO, LOG_EVENT_CONNECT, user, NULL, NULL, NULL, 0, NULL);
 				
 				// Fix User Counter
-				_db_user_count++;
+				__atomic_add_fetch(&_db_user_count, 1, __ATOMIC_RELAXED);
 				
 				// Update Status Log
 				update_status();
 				
-				// Exit Function
-				return;
+				// Return User Node
+				return user;
 			}
 		}
+		
+		// Free User Node Memory
+		free_pool(&_pool_user, user);
+		free_pool(&_pool_info, info);
 	}
 		
 	// Duplicate IP, Allocation Error or not enough space - Close Stream
 	close(fd);
+	
+	// Return Error
+	return NULL;
 }
 
 /**
  * Login User into Database (Login Data)
  * @param user User Node
  * @param data Login Packet
+ * @return 0 on Success or -1 if the User was logged out (or handed to a Worker Thread)
  */
-void login_user_data(SceNetAdhocctlUserNode * user, SceNetAdhocctlLoginPacketC2S * data)
+int login_user_data(SceNetAdhocctlUserNode * user, SceNetAdhocctlLoginPacketC2S * data)
 {
 	// Product Code Check
 	int valid_product_code = 1;
@@ -118,83 +236,144 @@ void login_user_data(SceNetAdhocctlUserNode * user, SceNetAdhocctlLoginPacketC2S
 		// Game Product Override
 		game_product_override(&data->game);
 		
-		// Find existing Game
-		SceNetAdhocctlGameNode * game = _db_game;
-		while(game != NULL && strncmp(game->game.data, data->game.data, PRODUCT_CODE_LENGTH) != 0) game = game->next;
+		// Save MAC
+		user->info->resolver.mac = data->mac;
+		
+		// Save Nickname
+		user->info->resolver.name = data->name;
 		
-		// Game not found
-		if(game == NULL)
+		// Index MAC
+		index_user_mac(user);
+		
+		// Sharded Mode - the Worker of this Game finishes the Login
+		if(_worker_count > 0)
 		{
-			// Allocate Game Node Memory
-			game = (SceNetAdhocctlGameNode *)malloc(sizeof(SceNetAdhocctlGameNode));
+			// Hand User over
+			handoff_user(user, &data->game);
 			
-			// Allocated Game Node Memory
-			if(game != NULL)
-			{
-				// Clear Memory
-				memset(game, 0, sizeof(SceNetAdhocctlGameNode));
-				
-				// Save Game Product ID
-				game->game = data->game;
-				
-				// Link into Game List
-				game->next = _db_game;
-				if(_db_game != NULL) _db_game->prev = game;
-				_db_game = game;
-			}
+			// User left this Thread
+			return -1;
 		}
 		
-		// Game now available
+		// Join Game
+		return login_user_game(user, &data->game);
+	}
+	
+	// Invalid Packet Data
+	else
+	{
+		// Notify User
+		log_user(LOG_LEVEL_WARNING, LOG_EVENT_LOGIN_INVALID, user, NULL, NULL, NULL, 0, NULL);
+	}
+	
+	// Logout User - Invalid Arguments
+	logout_user(user);
+	
+	// Return Logout
+	return -1;
+}
+
+/**
+ * Login User into Database (Game)
+ * @param user User Node (with Resolver Information)
+ * @param product Resolved Game Product Code
+ * @return 0 on Success or -1 if the User was logged out
+ */
+int login_user_game(SceNetAdhocctlUserNode * user, SceNetAdhocctlProductCode * product)
+{
+	// Find existing Game
+	SceNetAdhocctlGameNode * game = find_game(product);
+	
+	// Game not found
+	if(game == NULL)
+	{
+		// Allocate Game Node Memory (cleared)
+		game = (SceNetAdhocctlGameNode *)alloc_pool(&_pool_game);
+		
+		// Allocated Game Node Memory
 		if(game != NULL)
 		{
-			// Save MAC
-			user->resolver.mac = data->mac;
-			
-			// Save Nickname
-			user->resolver.name = data->name;
-			
-			// Increase Player Count in Game Node
-			game->playercount++;
+			// Save Game Product ID
+			game->game = *product;
 			
-			// Link Game to Player
-			user->game = game;
+			// Link into Game List
+			game->next = _db_game;
+			if(_db_game != NULL) _db_game->prev = game;
+			_db_game = game;
 			
-			// Notify User
-			uint8_t * ip = (uint8_t *)&user->resolver.ip;
-			char safegamestr[10];
-			memset(safegamestr, 0, sizeof(safegamestr));
-			strncpy(safegamestr, game->game.data, PRODUCT_CODE_LENGTH);
-			printf("%s (MAC: %02X:%02X:%02X:%02X:%02X:%02X - IP: %u.%u.%u.%u) started playing %s.\n", (char *)user->resolver.name.data, user->resolver.mac.data[0], user->resolver.mac.data[1], user->resolver.mac.data[2], user->resolver.mac.data[3], user->resolver.mac.data[4], user->resolver.mac.data[5], ip[0], ip[1], ip[2], ip[3], safegamestr);
-			
-			// Update Status Log
-			update_status();
+			// Link into Game Hash Bucket
+			SceNetAdhocctlGameNode ** bucket = &_db_game_hash[hash_product_code(product) & (SERVER_GAME_HASH_BUCKETS - 1)];
+			game->hash_next = *bucket;
+			*bucket = game;
 			
-			// Leave Function
-			return;
+			// Count Game
+			count_metric(games, 1);
 		}
 	}
 	
-	// Invalid Packet Data
-	else
+	// Game now available
+	if(game != NULL)
 	{
+		// Increase Player Count in Game Node
+		game->playercount++;
+		
+		// Link Game to Player
+		user->game = game;
+		
 		// Notify User
-		uint8_t * ip = (uint8_t *)&user->resolver.ip;
-		printf("Invalid Login Packet Contents from %u.%u.%u.%u.\n", ip[0], ip[1], ip[2], ip[3]);
+		log_user(LOG_LEVEL_INFO, LOG_EVENT_LOGIN, user, &game->game, NULL, NULL, 0, NULL);
+		
+		// Count Login
+		count_metric(logins, 1);
+		
+		// Publish Login
+		feed_user(FEED_EVENT_LOGIN, user);
+		
+		// Update Status Log
+		update_status();
+		
+		// Leave Function
+		return 0;
 	}
 	
-	// Logout User - Out of Memory or Invalid Arguments
+	// Logout User - Out of Memory
 	logout_user(user);
+	
+	// Return Logout
+	return -1;
 }
 
 /**
- * Logout User from Database
+ * Attach User to the Database of the calling Thread
  * @param user User Node
  */
-void logout_user(SceNetAdhocctlUserNode * user)
+void attach_user(SceNetAdhocctlUserNode * user)
 {
-	// Disconnect from Group
-	if(user->group != NULL) disconnect_user(user);
+	// Link into User List
+	user->prev = NULL;
+	user->next = _db_user;
+	if(_db_user != NULL) _db_user->prev = user;
+	_db_user = user;
+	
+	// Find Idle List Position (Handoffs may arrive slightly out of Order, so search from the newest End)
+	SceNetAdhocctlUserNode * prev = _db_user_idle_tail;
+	while(prev != NULL && prev->last_recv > user->last_recv) prev = prev->idle_prev;
+	
+	// Link into Idle List
+	user->idle_prev = prev;
+	user->idle_next = (prev != NULL) ? prev->idle_next : _db_user_idle;
+	if(user->idle_next != NULL) user->idle_next->idle_prev = user;
+	else _db_user_idle_tail = user;
+	if(prev != NULL) prev->idle_next = user;
+	else _db_user_idle = user;
+}
 
+/**
+ * Detach User from the Database of the calling Thread
+ * @param user User Node
+ */
+void detach_user(SceNetAdhocctlUserNode * user)
+{
 	// Unlink Leftside (Beginning)
 	if(user->prev == NULL) _db_user = user->next;
 	
@@ -204,18 +383,57 @@ void logout_user(SceNetAdhocctlUserNode * user)
 	// Unlink Rightside
 	if(user->next != NULL) user->next->prev = user->prev;
 	
+	// Unlink from Idle List
+	if(user->idle_prev == NULL) _db_user_idle = user->idle_next;
+	else user->idle_prev->idle_next = user->idle_next;
+	if(user->idle_next == NULL) _db_user_idle_tail = user->idle_prev;
+	else user->idle_next->idle_prev = user->idle_prev;
+	
+	// Clear Links
+	user->next = NULL;
+	user->prev = NULL;
+	user->idle_next = NULL;
+	user->idle_prev = NULL;
+}
+
+/**
+ * Logout User from Database
+ * @param user User Node
+ */
+void logout_user(SceNetAdhocctlUserNode * user)
+{
+	// Disconnect from Group
+	if(user->group != NULL) disconnect_user(user);
+
+	// Unlink User
+	detach_user(user);
+	
+	// Publish Logout (before the IP is free for a new Login on another Thread)
+	if(user->game != NULL) feed_user(FEED_EVENT_LOGOUT, user);
+	
+	// Remove User from IP and MAC Index
+	unindex_user(user);
+	
+	// Record Disconnect
+	trace_user(TRACE_RECORD_CLOSE, user, NULL, 0);
+	
+	// Cancel Ring Operations (they hold the Socket open past the Close)
+	if(_uring_active) unwatch_uring_user(user);
+	
 	// Close Stream
 	close(user->stream);
 	
+	// Free TX Queue
+	free(user->tx);
+	
 	// Playing User
 	if(user->game != NULL)
 	{
 		// Notify User
-		uint8_t * ip = (uint8_t *)&user->resolver.ip;
-		char safegamestr[10];
-		memset(safegamestr, 0, sizeof(safegamestr));
-		strncpy(safegamestr, user->game->game.data, PRODUCT_CODE_LENGTH);
-		printf("%s (MAC: %02X:%02X:%02X:%02X:%02X:%02X - IP: %u.%u.%u.%u) stopped playing %s.\n", (char *)user->resolver.name.data, user->resolver.mac.data[0], user->resolver.mac.data[1], user->resolver.mac.data[2], user->resolver.mac.data[3], user->resolver.mac.data[4], user->resolver.mac.data[5], ip[0], ip[1], ip[2], ip[3], safegamestr);
+		log_user(LOG_LEVEL_INFO, LOG_EVENT_LOGOUT, user, &user->game->game, NULL, NULL, 0, NULL);
+		
+		// Count Logout
+		count_metric(logouts, 1);
 		
 		// Fix Game Player Count
 		user->game->playercount--;
@@ -232,8 +450,22 @@ void logout_user(SceNetAdhocctlUserNode * user)
 			// Unlink Rightside
 			if(user->game->next != NULL) user->game->next->prev = user->game->prev;
 			
+			// Unlink from Game Hash Bucket
+			SceNetAdhocctlGameNode ** link = &_db_game_hash[hash_product_code(&user->game->game) & (SERVER_GAME_HASH_BUCKETS - 1)];
+			while(*link != user->game) link = &(*link)->hash_next;
+			*link = user->game->hash_next;
+			
+			// Free Group Hash Memory
+			free(user->game->grouphash);
+			
+			// Free Scan Result Memory
+			free(user->game->scan);
+			
 			// Free Game Node Memory
-			free(user->game);
+			free_pool(&_pool_game, user->game);
+			
+			// Uncount Game
+			count_metric(games, -1);
 		}
 	}
 	
@@ -241,20 +473,68 @@ void logout_user(SceNetAdhocctlUserNode * user)
 	else
 	{
 		// Notify User
-		uint8_t * ip = (uint8_t *)&user->resolver.ip;
-		printf("Dropped Connection to %u.%u.%u.%u.\n", ip[0], ip[1], ip[2], ip[3]);
+		log_user(LOG_LEVEL_INFO, LOG_EVENT_DROP, user, NULL, NULL, NULL, 0, NULL);
+		
+		// Count Drop
+		count_metric(drops, 1);
 	}
 	
 	// Free Memory
-	free(user);
+	free_pool(&_pool_info, user->info);
+	free_pool(&_pool_user, user);
 	
 	// Fix User Counter
-	_db_user_count--;
+	__atomic_sub_fetch(&_db_user_count, 1, __ATOMIC_RELAXED);
 	
 	// Update Status Log
 	update_status();
 }
 
+/**
+ * Initialize Database (allocates the Node Pools and Hash Indexes for the User Maximum)
+ * @return 0 on Success or -1 if out of Memory
+ */
+int init_database(void)
+{
+	// Hash Buckets (smallest Power of 2 that fits the User Maximum)
+	_db_user_buckets = 1;
+	while(_db_user_buckets < _settings.usermax) _db_user_buckets <<= 1;
+	
+	// Allocate Hash Indexes (cleared)
+	_db_user_ip = (SceNetAdhocctlUserNode **)calloc(_db_user_buckets, sizeof(SceNetAdhocctlUserNode *));
+	_db_user_mac = (SceNetAdhocctlUserNode **)calloc(_db_user_buckets, sizeof(SceNetAdhocctlUserNode *));
+	
+	// Pool Capacity (every Game and Group holds at least one User, the Thread Caches of the Acceptor and Workers keep some Nodes aside)
+	uint32_t capacity = _settings.usermax + (_settings.workers + 1) * POOL_CACHE_MAXIMUM;
+	
+	// Create Node Pools
+	if(_db_user_ip != NULL && _db_user_mac != NULL && create_pool(&_pool_user, sizeof(SceNetAdhocctlUserNode), capacity) == 0 && create_pool(&_pool_info, sizeof(SceNetAdhocctlUserInfo), capacity) == 0 && create_pool(&_pool_game, sizeof(SceNetAdhocctlGameNode), capacity) == 0 && create_pool(&_pool_group, sizeof(SceNetAdhocctlGroupNode), capacity) == 0) return 0;
+	
+	// Destroy partially created Pools
+	destroy_database();
+	
+	// Return Error
+	return -1;
+}
+
+/**
+ * Destroy Database (releases the Node Pools, all Threads must be done)
+ */
+void destroy_database(void)
+{
+	// Destroy Node Pools
+	destroy_pool(&_pool_user);
+	destroy_pool(&_pool_info);
+	destroy_pool(&_pool_game);
+	destroy_pool(&_pool_group);
+	
+	// Free Hash Indexes
+	free(_db_user_ip);
+	free(_db_user_mac);
+	_db_user_ip = NULL;
+	_db_user_mac = NULL;
+}
+
 /**
  * Free Database Memory
  */
@@ -280,14 +560,26 @@ void free_database(void)
 		// Move Pointer
 		user = next;
 	}
+	
+	// Free Batch Buffer
+	free(_batch);
+	_batch = NULL;
+	_batch_size = 0;
+	
+	// Return Thread Caches (Worker Threads end after this)
+	flush_pool_cache(&_pool_user);
+	flush_pool_cache(&_pool_info);
+	flush_pool_cache(&_pool_game);
+	flush_pool_cache(&_pool_group);
 }
 
 /**
  * Connect User to Game Group
  * @param user User Node
  * @param group Group Name
+ * @return 0 on Success or -1 if the User was logged out
  */
-void connect_user(SceNetAdhocctlUserNode * user, SceNetAdhocctlGroupName * group)
+int connect_user(SceNetAdhocctlUserNode * user, SceNetAdhocctlGroupName * group)
 {
 	// Group Name Check
 	int valid_group_name = 1;
@@ -319,30 +611,24 @@ void connect_user(SceNetAdhocctlUserNode * user, SceNetAdhocctlGroupName * group
 		if(user->group == NULL)
 		{
 			// Find Group in Game Node
-			SceNetAdhocctlGroupNode * g = user->game->group;
-			while(g != NULL && strncmp((char *)g->group.data, (char *)group->data, ADHOCCTL_GROUPNAME_LEN) != 0) g = g->next;
-			
-			// BSSID Packet
-			SceNetAdhocctlConnectBSSIDPacketS2C bssid;
+			SceNetAdhocctlGroupNode * g = find_group(user->game, group);
 			
-			// Set BSSID Opcode
-			bssid.base.opcode = OPCODE_CONNECT_BSSID;
+			// Peer List Batch (Connect Packets of all Peers + BSSID, sent to the joining User in one Write)
+			uint32_t peercount = (g != NULL) ? g->playercount : 0;
+			SceNetAdhocctlConnectPacketS2C * batch = (SceNetAdhocctlConnectPacketS2C *)get_batch_buffer(peercount * sizeof(SceNetAdhocctlConnectPacketS2C) + sizeof(SceNetAdhocctlConnectBSSIDPacketS2C));
 			
-			// Set Default BSSID
-			bssid.mac = user->resolver.mac;
+			// BSSID Packet (placed behind the Peer List)
+			SceNetAdhocctlConnectBSSIDPacketS2C * bssid = (SceNetAdhocctlConnectBSSIDPacketS2C *)(batch + peercount);
 			
 			// No Group found
-			if(g == NULL)
+			if(g == NULL && batch != NULL)
 			{
-				// Allocate Group Memory
-				g = (SceNetAdhocctlGroupNode *)malloc(sizeof(SceNetAdhocctlGroupNode));
+				// Allocate Group Memory (cleared, if the Group Hash has Room)
+				if(grow_group_hash(user->game) == 0) g = (SceNetAdhocctlGroupNode *)alloc_pool(&_pool_group);
 				
 				// Allocated Group Memory
 				if(g != NULL)
 				{
-					// Clear Memory
-					memset(g, 0, sizeof(SceNetAdhocctlGroupNode));
-					
 					// Link Game Node
 					g->game = user->game;
 					
@@ -354,56 +640,67 @@ void connect_user(SceNetAdhocctlUserNode * user, SceNetAdhocctlGroupName * group
 					// Copy Group Name
 					g->group = *group;
 					
+					// Link into Group Hash Bucket
+					SceNetAdhocctlGroupNode ** bucket = &g->game->grouphash[hash_group_name(group) & (g->game->grouphashsize - 1)];
+					g->hash_next = *bucket;
+					*bucket = g;
+					
 					// Increase Group Counter for Game
 					g->game->groupcount++;
+					
+					// Count Group
+					count_metric(groups, 1);
 				}
 			}
 			
 			// Group now available
-			if(g != NULL)
+			if(g != NULL && batch != NULL)
 			{
+				// Set BSSID Opcode
+				bssid->base.opcode = OPCODE_CONNECT_BSSID;
+				
+				// Set BSSID (the Group Host, or the joining User for a new Group)
+				bssid->mac = (g->host != NULL) ? g->host->info->resolver.mac : user->info->resolver.mac;
+				
+				// Connect Packet (announces the joining User)
+				SceNetAdhocctlConnectPacketS2C packet;
+				
+				// Set Connect Opcode
+				packet.base.opcode = OPCODE_CONNECT;
+				
+				// Set Player Name
+				packet.name = user->info->resolver.name;
+				
+				// Set Player MAC
+				packet.mac = user->info->resolver.mac;
+				
+				// Set Player IP
+				packet.ip = user->info->resolver.ip;
+				
 				// Iterate remaining Group Players
+				SceNetAdhocctlConnectPacketS2C * entry = batch;
 				SceNetAdhocctlUserNode * peer = g->player;
 				while(peer != NULL)
 				{
-					// Connect Packet
-					SceNetAdhocctlConnectPacketS2C packet;
-					
-					// Clear Memory
-					// memset(&packet, 0, sizeof(packet));
+					// Send Data
+					send_user_data(peer, &packet, sizeof(packet));
+					count_tx_metric(OPCODE_CONNECT, 1, sizeof(packet));
 					
 					// Set Connect Opcode
-					packet.base.opcode = OPCODE_CONNECT;
-					
-					// Set Player Name
-					packet.name = user->resolver.name;
-					
-					// Set Player MAC
-					packet.mac = user->resolver.mac;
-					
-					// Set Player IP
-					packet.ip = user->resolver.ip;
-					
-					// Send Data
-					send(peer->stream, &packet, sizeof(packet), 0);
+					entry->base.opcode = OPCODE_CONNECT;
 					
 					// Set Player Name
-					packet.name = peer->resolver.name;
+					entry->name = peer->info->resolver.name;
 					
 					// Set Player MAC
-					packet.mac = peer->resolver.mac;
+					entry->mac = peer->info->resolver.mac;
 					
 					// Set Player IP
-					packet.ip = peer->resolver.ip;
+					entry->ip = peer->info->resolver.ip;
 					
-					// Send Data
-					send(user->stream, &packet, sizeof(packet), 0);
-					
-					// Set BSSID
-					if(peer->group_next == NULL) bssid.mac = peer->resolver.mac;
-					
-					// Move Pointer
+					// Move Pointers
 					peer = peer->group_next;
+					entry++;
 				}
 				
 				// Link User to Group
@@ -414,27 +711,35 @@ void connect_user(SceNetAdhocctlUserNode * user, SceNetAdhocctlGroupName * group
 				// Link Group to User
 				user->group = g;
 				
+				// First Player founds the Group
+				if(g->host == NULL)
+				{
+					// Set Group Host
+					g->host = user;
+					
+					// Invalidate Scan Result (new Group)
+					g->game->scanlen = 0;
+				}
+				
 				// Increase Player Count
 				g->playercount++;
 				
-				// Send Network BSSID to User
-				send(user->stream, &bssid, sizeof(bssid), 0);
+				// Send Peer List + Network BSSID to User
+				send_user_data(user, batch, peercount * sizeof(SceNetAdhocctlConnectPacketS2C) + sizeof(SceNetAdhocctlConnectBSSIDPacketS2C));
+				count_tx_metric(OPCODE_CONNECT, peercount, peercount * sizeof(SceNetAdhocctlConnectPacketS2C));
+				count_tx_metric(OPCODE_CONNECT_BSSID, 1, sizeof(SceNetAdhocctlConnectBSSIDPacketS2C));
 				
 				// Notify User
-				uint8_t * ip = (uint8_t *)&user->resolver.ip;
-				char safegamestr[10];
-				memset(safegamestr, 0, sizeof(safegamestr));
-				strncpy(safegamestr, user->game->game.data, PRODUCT_CODE_LENGTH);
-				char safegroupstr[9];
-				memset(safegroupstr, 0, sizeof(safegroupstr));
-				strncpy(safegroupstr, (char *)user->group->group.data, ADHOCCTL_GROUPNAME_LEN);
-				printf("%s (MAC: %02X:%02X:%02X:%02X:%02X:%02X - IP: %u.%u.%u.%u) joined %s group %s.\n", (char *)user->resolver.name.data, user->resolver.mac.data[0], user->resolver.mac.data[1], user->resolver.mac.data[2], user->resolver.mac.data[3], user->resolver.mac.data[4], user->resolver.mac.data[5], ip[0], ip[1], ip[2], ip[3], safegamestr, safegroupstr);
+				log_user(LOG_LEVEL_INFO, LOG_EVENT_JOIN, user, &user->game->game, &user->group->group, NULL, 0, NULL);
+				
+				// Publish Join
+				feed_user(FEED_EVENT_JOIN, user);
 
 				// Update Status Log
 				update_status();
 				
 				// Exit Function
-				return;
+				return 0;
 			}
 		}
 		
@@ -442,17 +747,7 @@ void connect_user(SceNetAdhocctlUserNode * user, SceNetAdhocctlGroupName * group
 		else
 		{
 			// Notify User
-			uint8_t * ip = (uint8_t *)&user->resolver.ip;
-			char safegamestr[10];
-			memset(safegamestr, 0, sizeof(safegamestr));
-			strncpy(safegamestr, user->game->game.data, PRODUCT_CODE_LENGTH);
-			char safegroupstr[9];
-			memset(safegroupstr, 0, sizeof(safegroupstr));
-			strncpy(safegroupstr, (char *)group->data, ADHOCCTL_GROUPNAME_LEN);
-			char safegroupstr2[9];
-			memset(safegroupstr2, 0, sizeof(safegroupstr2));
-			strncpy(safegroupstr2, (char *)user->group->group.data, ADHOCCTL_GROUPNAME_LEN);
-			printf("%s (MAC: %02X:%02X:%02X:%02X:%02X:%02X - IP: %u.%u.%u.%u) attempted to join %s group %s without disconnecting from %s first.\n", (char *)user->resolver.name.data, user->resolver.mac.data[0], user->resolver.mac.data[1], user->resolver.mac.data[2], user->resolver.mac.data[3], user->resolver.mac.data[4], user->resolver.mac.data[5], ip[0], ip[1], ip[2], ip[3], safegamestr, safegroupstr, safegroupstr2);
+			log_user(LOG_LEVEL_WARNING, LOG_EVENT_JOIN_TWICE, user, &user->game->game, group, &user->group->group, 0, NULL);
 		}
 	}
 	
@@ -460,25 +755,22 @@ void connect_user(SceNetAdhocctlUserNode * user, SceNetAdhocctlGroupName * group
 	else
 	{
 		// Notify User
-		uint8_t * ip = (uint8_t *)&user->resolver.ip;
-		char safegamestr[10];
-		memset(safegamestr, 0, sizeof(safegamestr));
-		strncpy(safegamestr, user->game->game.data, PRODUCT_CODE_LENGTH);
-		char safegroupstr[9];
-		memset(safegroupstr, 0, sizeof(safegroupstr));
-		strncpy(safegroupstr, (char *)group->data, ADHOCCTL_GROUPNAME_LEN);
-		printf("%s (MAC: %02X:%02X:%02X:%02X:%02X:%02X - IP: %u.%u.%u.%u) attempted to join invalid %s group %s.\n", (char *)user->resolver.name.data, user->resolver.mac.data[0], user->resolver.mac.data[1], user->resolver.mac.data[2], user->resolver.mac.data[3], user->resolver.mac.data[4], user->resolver.mac.data[5], ip[0], ip[1], ip[2], ip[3], safegamestr, safegroupstr);
+		log_user(LOG_LEVEL_WARNING, LOG_EVENT_JOIN_INVALID, user, &user->game->game, group, NULL, 0, NULL);
 	}
 	
 	// Invalid State, Out of Memory or Invalid Group Name
 	logout_user(user);
+	
+	// Return Logout
+	return -1;
 }
 
 /**
  * Disconnect User from Game Group
  * @param user User Node
+ * @return 0 on Success or -1 if the User was logged out
  */
-void disconnect_user(SceNetAdhocctlUserNode * user)
+int disconnect_user(SceNetAdhocctlUserNode * user)
 {
 	// User is connected
 	if(user->group != NULL)
@@ -492,6 +784,16 @@ void disconnect_user(SceNetAdhocctlUserNode * user)
 		// Unlink Rightside
 		if(user->group_next != NULL) user->group_next->group_prev = user->group_prev;
 		
+		// Group Host left
+		if(user->group->host == user)
+		{
+			// Next oldest Player takes over (NULL for an empty Group)
+			user->group->host = user->group_prev;
+			
+			// Invalidate Scan Result (Host changed or Group vanishes)
+			user->game->scanlen = 0;
+		}
+		
 		// Fix Player Count
 		user->group->playercount--;
 		
@@ -509,24 +811,21 @@ void disconnect_user(SceNetAdhocctlUserNode * user)
 			packet.base.opcode = OPCODE_DISCONNECT;
 			
 			// Set User IP
-			packet.ip = user->resolver.ip;
+			packet.ip = user->info->resolver.ip;
 			
 			// Send Data
-			send(peer->stream, &packet, sizeof(packet), 0);
+			send_user_data(peer, &packet, sizeof(packet));
+			count_tx_metric(OPCODE_DISCONNECT, 1, sizeof(packet));
 			
 			// Move Pointer
 			peer = peer->group_next;
 		}
 		
 		// Notify User
-		uint8_t * ip = (uint8_t *)&user->resolver.ip;
-		char safegamestr[10];
-		memset(safegamestr, 0, sizeof(safegamestr));
-		strncpy(safegamestr, user->game->game.data, PRODUCT_CODE_LENGTH);
-		char safegroupstr[9];
-		memset(safegroupstr, 0, sizeof(safegroupstr));
-		strncpy(safegroupstr, (char *)user->group->group.data, ADHOCCTL_GROUPNAME_LEN);
-		printf("%s (MAC: %02X:%02X:%02X:%02X:%02X:%02X - IP: %u.%u.%u.%u) left %s group %s.\n", (char *)user->resolver.name.data, user->resolver.mac.data[0], user->resolver.mac.data[1], user->resolver.mac.data[2], user->resolver.mac.data[3], user->resolver.mac.data[4], user->resolver.mac.data[5], ip[0], ip[1], ip[2], ip[3], safegamestr, safegroupstr);
+		log_user(LOG_LEVEL_INFO, LOG_EVENT_LEAVE, user, &user->game->game, &user->group->group, NULL, 0, NULL);
+		
+		// Publish Leave
+		feed_user(FEED_EVENT_LEAVE, user);
 		
 		// Empty Group
 		if(user->group->playercount == 0)
@@ -540,11 +839,19 @@ void disconnect_user(SceNetAdhocctlUserNode * user)
 			// Unlink Rightside
 			if(user->group->next != NULL) user->group->next->prev = user->group->prev;
 			
+			// Unlink from Group Hash Bucket
+			SceNetAdhocctlGroupNode ** link = &user->game->grouphash[hash_group_name(&user->group->group) & (user->game->grouphashsize - 1)];
+			while(*link != user->group) link = &(*link)->hash_next;
+			*link = user->group->hash_next;
+			
 			// Free Group Memory
-			free(user->group);
+			free_pool(&_pool_group, user->group);
 			
 			// Decrease Group Counter in Game Node
 			user->game->groupcount--;
+			
+			// Uncount Group
+			count_metric(groups, -1);
 		}
 		
 		// Unlink from Group
@@ -556,133 +863,163 @@ void disconnect_user(SceNetAdhocctlUserNode * user)
 		update_status();
 		
 		// Exit Function
-		return;
+		return 0;
 	}
 	
 	// Not in a game group
 	else
 	{
 		// Notify User
-		uint8_t * ip = (uint8_t *)&user->resolver.ip;
-		char safegamestr[10];
-		memset(safegamestr, 0, sizeof(safegamestr));
-		strncpy(safegamestr, user->game->game.data, PRODUCT_CODE_LENGTH);
-		printf("%s (MAC: %02X:%02X:%02X:%02X:%02X:%02X - IP: %u.%u.%u.%u) attempted to leave %s group without joining one first.\n", (char *)user->resolver.name.data, user->resolver.mac.data[0], user->resolver.mac.data[1], user->resolver.mac.data[2], user->resolver.mac.data[3], user->resolver.mac.data[4], user->resolver.mac.data[5], ip[0], ip[1], ip[2], ip[3], safegamestr);
+		log_user(LOG_LEVEL_WARNING, LOG_EVENT_LEAVE_INVALID, user, &user->game->game, NULL, NULL, 0, NULL);
 	}
 	
 	// Delete User
 	logout_user(user);
+	
+	// Return Logout
+	return -1;
 }
 
 /**
  * Send Game Group List
  * @param user User Node
+ * @return 0 on Success or -1 if the User was logged out
  */
-void send_scan_results(SceNetAdhocctlUserNode * user)
+int send_scan_results(SceNetAdhocctlUserNode * user)
 {
 	// User is disconnected
 	if(user->group == NULL)
 	{
-		// Iterate Groups
-		SceNetAdhocctlGroupNode * group = user->game->group;
-		for(; group != NULL; group = group->next)
+		// Scan Result stale
+		if(user->game->scanlen == 0 && build_scan_result(user->game) < 0)
 		{
-			// Scan Result Packet
-			SceNetAdhocctlScanPacketS2C packet;
-			
-			// Clear Memory
-			// memset(&packet, 0, sizeof(packet));
-			
-			// Set Opcode
-			packet.base.opcode = OPCODE_SCAN;
+			// Notify User
+			log_text(LOG_LEVEL_ERROR, "Out of Memory for the Scan Result of %.*s.", PRODUCT_CODE_LENGTH, user->game->game.data);
 			
-			// Set Group Name
-			packet.group = group->group;
+			// Delete User
+			logout_user(user);
 			
-			// Iterate Players in Network Group
-			SceNetAdhocctlUserNode * peer = group->player;
-			for(; peer != NULL; peer = peer->group_next)
-			{
-				// Found Network Founder
-				if(peer->group_next == NULL)
-				{
-					// Set Group Host MAC
-					packet.mac = peer->resolver.mac;
-				}
-			}
-			
-			// Send Group Packet
-			send(user->stream, &packet, sizeof(packet), 0);
+			// Return Logout
+			return -1;
 		}
 		
-		// Notify Player of End of Scan
-		uint8_t opcode = OPCODE_SCAN_COMPLETE;
-		send(user->stream, &opcode, 1, 0);
+		// Send Group Packets and Scan Complete in one Write
+		send_user_data(user, user->game->scan, user->game->scanlen);
+		count_tx_metric(OPCODE_SCAN, user->game->groupcount, user->game->scanlen - 1);
+		count_tx_metric(OPCODE_SCAN_COMPLETE, 1, 1);
 		
 		// Notify User
-		uint8_t * ip = (uint8_t *)&user->resolver.ip;
-		char safegamestr[10];
-		memset(safegamestr, 0, sizeof(safegamestr));
-		strncpy(safegamestr, user->game->game.data, PRODUCT_CODE_LENGTH);
-		printf("%s (MAC: %02X:%02X:%02X:%02X:%02X:%02X - IP: %u.%u.%u.%u) requested information on %d %s groups.\n", (char *)user->resolver.name.data, user->resolver.mac.data[0], user->resolver.mac.data[1], user->resolver.mac.data[2], user->resolver.mac.data[3], user->resolver.mac.data[4], user->resolver.mac.data[5], ip[0], ip[1], ip[2], ip[3], user->game->groupcount, safegamestr);
+		log_user(LOG_LEVEL_DEBUG, LOG_EVENT_SCAN, user, &user->game->game, NULL, NULL, user->game->groupcount, NULL);
 		
 		// Exit Function
-		return;
+		return 0;
 	}
 	
 	// User in a game group
 	else
 	{
 		// Notify User
-		uint8_t * ip = (uint8_t *)&user->resolver.ip;
-		char safegamestr[10];
-		memset(safegamestr, 0, sizeof(safegamestr));
-		strncpy(safegamestr, user->game->game.data, PRODUCT_CODE_LENGTH);
-		char safegroupstr[9];
-		memset(safegroupstr, 0, sizeof(safegroupstr));
-		strncpy(safegroupstr, (char *)user->group->group.data, ADHOCCTL_GROUPNAME_LEN);
-		printf("%s (MAC: %02X:%02X:%02X:%02X:%02X:%02X - IP: %u.%u.%u.%u) attempted to scan for %s groups without disconnecting from %s first.\n", (char *)user->resolver.name.data, user->resolver.mac.data[0], user->resolver.mac.data[1], user->resolver.mac.data[2], user->resolver.mac.data[3], user->resolver.mac.data[4], user->resolver.mac.data[5], ip[0], ip[1], ip[2], ip[3], safegamestr, safegroupstr);
+		log_user(LOG_LEVEL_WARNING, LOG_EVENT_SCAN_INVALID, user, &user->game->game, &user->group->group, NULL, 0, NULL);
 	}
 	
 	// Delete User
 	logout_user(user);
+	
+	// Return Logout
+	return -1;
+}
+
+/**
+ * Serialize the Scan Result of a Game (one Packet per Group + Scan Complete)
+ * @param game Game Node
+ * @return 0 on Success or -1 if out of Memory
+ */
+int build_scan_result(SceNetAdhocctlGameNode * game)
+{
+	// Required Size
+	uint32_t size = game->groupcount * sizeof(SceNetAdhocctlScanPacketS2C) + 1;
+	
+	// Buffer too small
+	if(size > game->scansize)
+	{
+		// Grow Buffer
+		uint8_t * scan = (uint8_t *)realloc(game->scan, size);
+		
+		// Out of Memory
+		if(scan == NULL) return -1;
+		
+		// Replace Buffer
+		game->scan = scan;
+		game->scansize = size;
+	}
+	
+	// Packet Cursor
+	SceNetAdhocctlScanPacketS2C * packet = (SceNetAdhocctlScanPacketS2C *)game->scan;
+	
+	// Iterate Groups
+	SceNetAdhocctlGroupNode * group = game->group;
+	for(; group != NULL; group = group->next)
+	{
+		// Set Opcode
+		packet->base.opcode = OPCODE_SCAN;
+		
+		// Set Group Name
+		packet->group = group->group;
+		
+		// Set Group Host MAC
+		packet->mac = group->host->info->resolver.mac;
+		
+		// Move Pointer
+		packet++;
+	}
+	
+	// Append Scan Complete
+	*(uint8_t *)packet = OPCODE_SCAN_COMPLETE;
+	
+	// Set Result Length
+	game->scanlen = size;
+	
+	// Return Success
+	return 0;
 }
 
 /**
  * Spread Chat Message in P2P Network
  * @param user Sender User Node
  * @param message Chat Message
+ * @return 0 on Success or -1 if the Sender was logged out
  */
-void spread_message(SceNetAdhocctlUserNode * user, char * message)
+int spread_message(SceNetAdhocctlUserNode * user, char * message)
 {
 	// Global Notice
 	if(user == NULL)
 	{
+		// Chat Packet (encoded once, shared by all Recipients)
+		SceNetAdhocctlChatPacketS2C packet;
+		
+		// Clear Memory (anonymous Sender)
+		memset(&packet, 0, sizeof(packet));
+		
+		// Set Chat Opcode
+		packet.base.base.opcode = OPCODE_CHAT;
+		
+		// Set Chat Message
+		strcpy(packet.base.message, message);
+		
 		// Iterate Players
 		for(user = _db_user; user != NULL; user = user->next)
 		{
 			// Player has access to chat
 			if(user->group != NULL)
 			{
-				// Chat Packet
-				SceNetAdhocctlChatPacketS2C packet;
-				
-				// Clear Memory
-				memset(&packet, 0, sizeof(packet));
-				
-				// Set Chat Opcode
-				packet.base.base.opcode = OPCODE_CHAT;
-				
-				// Set Chat Message
-				strcpy(packet.base.message, message);
-				
 				// Send Data
-				send(user->stream, &packet, sizeof(packet), 0);
+				send_user_data(user, &packet, sizeof(packet));
+				count_tx_metric(OPCODE_CHAT, 1, sizeof(packet));
 			}
 		}
 		
 		// Prevent NULL Error
-		return;
+		return 0;
 	}
 	
 	// User is connected
@@ -691,6 +1028,21 @@ void spread_message(SceNetAdhocctlUserNode * user, char * message)
 		// Broadcast Range Counter
 		uint32_t counter = 0;
 		
+		// Chat Packet (encoded once, shared by all Recipients)
+		SceNetAdhocctlChatPacketS2C packet;
+		
+		// Clear Memory
+		memset(&packet, 0, sizeof(packet));
+		
+		// Set Chat Opcode
+		packet.base.base.opcode = OPCODE_CHAT;
+		
+		// Set Chat Message
+		strcpy(packet.base.message, message);
+		
+		// Set Sender Nickname
+		packet.name = user->info->resolver.name;
+		
 		// Iterate Group Players
 		SceNetAdhocctlUserNode * peer = user->group->player;
 		while(peer != NULL)
@@ -705,20 +1057,9 @@ void spread_message(SceNetAdhocctlUserNode * user, char * message)
 				continue;
 			}
 			
-			// Chat Packet
-			SceNetAdhocctlChatPacketS2C packet;
-			
-			// Set Chat Opcode
-			packet.base.base.opcode = OPCODE_CHAT;
-			
-			// Set Chat Message
-			strcpy(packet.base.message, message);
-			
-			// Set Sender Nickname
-			packet.name = user->resolver.name;
-			
 			// Send Data
-			send(peer->stream, &packet, sizeof(packet), 0);
+			send_user_data(peer, &packet, sizeof(packet));
+			count_tx_metric(OPCODE_CHAT, 1, sizeof(packet));
 			
 			// Move Pointer
 			peer = peer->group_next;
@@ -731,33 +1072,49 @@ void spread_message(SceNetAdhocctlUserNode * user, char * message)
 		if(counter > 0)
 		{
 			// Notify User
-			uint8_t * ip = (uint8_t *)&user->resolver.ip;
-			char safegamestr[10];
-			memset(safegamestr, 0, sizeof(safegamestr));
-			strncpy(safegamestr, user->game->game.data, PRODUCT_CODE_LENGTH);
-			char safegroupstr[9];
-			memset(safegroupstr, 0, sizeof(safegroupstr));
-			strncpy(safegroupstr, (char *)user->group->group.data, ADHOCCTL_GROUPNAME_LEN);
-			printf("%s (MAC: %02X:%02X:%02X:%02X:%02X:%02X - IP: %u.%u.%u.%u) sent \"%s\" to %d players in %s group %s.\n", (char *)user->resolver.name.data, user->resolver.mac.data[0], user->resolver.mac.data[1], user->resolver.mac.data[2], user->resolver.mac.data[3], user->resolver.mac.data[4], user->resolver.mac.data[5], ip[0], ip[1], ip[2], ip[3], message, counter, safegamestr, safegroupstr);
+			log_user(LOG_LEVEL_DEBUG, LOG_EVENT_CHAT, user, &user->game->game, &user->group->group, NULL, counter, message);
 		}
 		
 		// Exit Function
-		return;
+		return 0;
 	}
 	
 	// User not in a game group
 	else
 	{
 		// Notify User
-		uint8_t * ip = (uint8_t *)&user->resolver.ip;
-		char safegamestr[10];
-		memset(safegamestr, 0, sizeof(safegamestr));
-		strncpy(safegamestr, user->game->game.data, PRODUCT_CODE_LENGTH);
-		printf("%s (MAC: %02X:%02X:%02X:%02X:%02X:%02X - IP: %u.%u.%u.%u) attempted to send a text message without joining a %s group first.\n", (char *)user->resolver.name.data, user->resolver.mac.data[0], user->resolver.mac.data[1], user->resolver.mac.data[2], user->resolver.mac.data[3], user->resolver.mac.data[4], user->resolver.mac.data[5], ip[0], ip[1], ip[2], ip[3], safegamestr);
+		log_user(LOG_LEVEL_WARNING, LOG_EVENT_CHAT_INVALID, user, &user->game->game, NULL, NULL, 0, NULL);
 	}
 	
 	// Delete User
 	logout_user(user);
+	
+	// Return Logout
+	return -1;
+}
+
+/**
+ * Refresh User Death Clock (moves the User to the End of the Idle List)
+ * @param user User Node
+ */
+void touch_user(SceNetAdhocctlUserNode * user)
+{
+	// Update Death Clock
+	user->last_recv = _loop_clock;
+	
+	// Already last in Idle List
+	if(user->idle_next == NULL) return;
+	
+	// Unlink from Idle List
+	if(user->idle_prev == NULL) _db_user_idle = user->idle_next;
+	else user->idle_prev->idle_next = user->idle_next;
+	user->idle_next->idle_prev = user->idle_prev;
+	
+	// Append to Idle List
+	user->idle_prev = _db_user_idle_tail;
+	user->idle_next = NULL;
+	_db_user_idle_tail->idle_next = user;
+	_db_user_idle_tail = user;
 }
 
 /**
@@ -767,7 +1124,7 @@ void spread_message(SceNetAdhocctlUserNode * user, char * message)
 int get_user_state(SceNetAdhocctlUserNode * user)
 {
 	// Timeout Status
-	if((time(NULL) - user->last_recv) >= SERVER_USER_TIMEOUT) return USER_STATE_TIMED_OUT;
+	if(_loop_clock >= user->last_recv + _settings.timeout * 1000ULL) return USER_STATE_TIMED_OUT;
 	
 	// Waiting Status
 	if(user->game == NULL) return USER_STATE_WAITING;
@@ -777,20 +1134,340 @@ int get_user_state(SceNetAdhocctlUserNode * user)
 }
 
 /**
- * Clear RX Buffer
+ * Send Data to User (queues what the Socket can't take right now)
+ * @param user User Node
+ * @param data Data
+ * @param size Size of Data
+ */
+void send_user_data(SceNetAdhocctlUserNode * user, const void * data, uint32_t size)
+{
+	// Sent Bytes
+	uint32_t sent = 0;
+	
+	// Nothing queued (keeps Data in Order, the I/O Ring only sends from the Queue)
+	if(!_uring_active && user->txpos == user->txlen)
+	{
+		// Send Data
+		int sendresult = send(user->stream, data, size, MSG_NOSIGNAL | MSG_DONTWAIT);
+		
+		// Broken Connection (the Event Loop will pick up the Hangup)
+		if(sendresult == -1 && errno != EAGAIN && errno != EWOULDBLOCK) return;
+		
+		// Count Sent Bytes
+		if(sendresult > 0) sent = sendresult;
+		
+		// Sent everything
+		if(sent == size) return;
+		
+		// Count Short Write (the Rest gets queued)
+		count_metric(txshort, 1);
+	}
+	
+	// Remaining Data
+	uint32_t remaining = size - sent;
+	
+	// I/O Ring Queue outgrows the Limit within one Iteration (the Socket hasn't seen it yet, nothing in Flight keeps the Order)
+	if(_uring_active && user->info->txflight == NULL && user->txlen - user->txpos + remaining > SERVER_USER_TXBUF_MAXIMUM) flush_user_txbuf(user);
+	
+	// Unsent Bytes (an I/O Ring Send in Flight took the older Queue over, it counts towards the same Limit)
+	uint32_t pending = user->txlen - user->txpos;
+	if(user->info->txflight != NULL) pending += user->info->txflight->len - user->info->txflight->pos;
+	
+	// User fell too far behind
+	if(pending + remaining > SERVER_USER_TXBUF_MAXIMUM)
+	{
+		// Notify User
+		log_user(LOG_LEVEL_WARNING, LOG_EVENT_TX_OVERFLOW, user, NULL, NULL, NULL, 0, NULL);
+		
+		// Count Overflow
+		count_metric(txoverflow, 1);
+		
+		// Hangup Connection (the Event Loop will logout the User)
+		shutdown(user->stream, SHUT_RDWR);
+		
+		// Discard Queue
+		user->txpos = user->txlen = 0;
+		
+		// Stop Queueing
+		return;
+	}
+	
+	// Compact Queue
+	if(user->txpos > 0)
+	{
+		// Move Unsent Data to Front
+		memmove(user->tx, user->tx + user->txpos, user->txlen - user->txpos);
+		
+		// Fix Queue Pointers
+		user->txlen -= user->txpos;
+		user->txpos = 0;
+	}
+	
+	// Grow Queue
+	if(user->txlen + remaining > user->txsize)
+	{
+		// New Queue Size (doubled to keep Reallocations rare)
+		uint32_t txsize = (user->txsize > 0) ? (user->txsize * 2) : 1024;
+		while(txsize < user->txlen + remaining) txsize *= 2;
+		if(txsize > SERVER_USER_TXBUF_MAXIMUM) txsize = SERVER_USER_TXBUF_MAXIMUM;
+		
+		// Reallocate Queue Memory
+		uint8_t * tx = (uint8_t *)realloc(user->tx, txsize);
+		
+		// Out of Memory
+		if(tx == NULL)
+		{
+			// Hangup Connection
+			shutdown(user->stream, SHUT_RDWR);
+			
+			// Stop Queueing
+			return;
+		}
+		
+		// Save Queue
+		user->tx = tx;
+		user->txsize = txsize;
+	}
+	
+	// Queue Remaining Data
+	memcpy(user->tx + user->txlen, (const uint8_t *)data + sent, remaining);
+	user->txlen += remaining;
+	
+	// Schedule Ring Send (one per Loop Iteration and User)
+	if(_uring_active) queue_uring_send(user);
+}
+
+/**
+ * Flush TX Queue (call when the Socket became writable)
+ * @param user User Node
+ */
+void flush_user_txbuf(SceNetAdhocctlUserNode * user)
+{
+	// Send Queued Data
+	while(user->txpos < user->txlen)
+	{
+		// Send Data
+		int sendresult = send(user->stream, user->tx + user->txpos, user->txlen - user->txpos, MSG_NOSIGNAL | MSG_DONTWAIT);
+		
+		// Socket full or broken (Hangups get picked up by the Event Loop)
+		if(sendresult <= 0) return;
+		
+		// Move Queue Pointer
+		user->txpos += sendresult;
+	}
+	
+	// Release Queue Memory
+	free(user->tx);
+	user->tx = NULL;
+	user->txpos = user->txlen = user->txsize = 0;
+}
+
+/**
+ * Lock IP and MAC Index (required for Lookups in Sharded Mode)
+ */
+void lock_user_index(void)
+{
+	// Lock Index
+	pthread_mutex_lock(&_db_index_lock);
+}
+
+/**
+ * Unlock IP and MAC Index
+ */
+void unlock_user_index(void)
+{
+	// Unlock Index
+	pthread_mutex_unlock(&_db_index_lock);
+}
+
+/**
+ * Find User by IP Address (Index Lock must be held)
+ * @param ip IP Address (Network Order)
+ * @return User Node or NULL
+ */
+SceNetAdhocctlUserNode * find_user_by_ip(uint32_t ip)
+{
+	// Iterate Hash Bucket
+	SceNetAdhocctlUserNode * user = _db_user_ip[hash_ip(ip) & (_db_user_buckets - 1)];
+	while(user != NULL && user->info->resolver.ip != ip) user = user->ip_next;
+	
+	// Return User Node
+	return user;
+}
+
+/**
+ * Find User by MAC Address (Index Lock must be held)
+ * @param mac MAC Address
+ * @return User Node or NULL
+ */
+SceNetAdhocctlUserNode * find_user_by_mac(SceNetEtherAddr * mac)
+{
+	// Iterate Hash Bucket
+	SceNetAdhocctlUserNode * user = _db_user_mac[hash_mac(mac) & (_db_user_buckets - 1)];
+	while(user != NULL && memcmp(&user->info->resolver.mac, mac, sizeof(SceNetEtherAddr)) != 0) user = user->mac_next;
+	
+	// Return User Node
+	return user;
+}
+
+/**
+ * Hash IP Address
+ * @param ip IP Address (Network Order)
+ * @return Hash
+ */
+uint32_t hash_ip(uint32_t ip)
+{
+	// Fibonacci Hashing (spreads neighbouring Addresses)
+	return (ip * 2654435761U) >> 16;
+}
+
+/**
+ * Hash MAC Address
+ * @param mac MAC Address
+ * @return FNV-1a Hash
+ */
+uint32_t hash_mac(SceNetEtherAddr * mac)
+{
+	// FNV-1a Hash over the MAC Address
+	uint32_t hash = 2166136261U;
+	int i = 0; for(; i < ETHER_ADDR_LEN; i++) hash = (hash ^ mac->data[i]) * 16777619U;
+	
+	// Return Hash
+	return hash;
+}
+
+/**
+ * Add User to the IP Index
+ * @param user User Node
+ * @return 0 on Success or -1 if the IP Address is connected already
+ */
+int index_user_ip(SceNetAdhocctlUserNode * user)
+{
+	// Lock Index
+	pthread_mutex_lock(&_db_index_lock);
+	
+	// Unique IP Address
+	int unique = (find_user_by_ip(user->info->resolver.ip) == NULL);
+	if(unique)
+	{
+		// Link into IP Hash Bucket
+		SceNetAdhocctlUserNode ** bucket = &_db_user_ip[hash_ip(user->info->resolver.ip) & (_db_user_buckets - 1)];
+		user->ip_next = *bucket;
+		*bucket = user;
+	}
+	
+	// Unlock Index
+	pthread_mutex_unlock(&_db_index_lock);
+	
+	// Return Result
+	return unique ? 0 : -1;
+}
+
+/**
+ * Add User to the MAC Index
  * @param user User Node
- * @param clear Number of Bytes to clear (-1 for all)
  */
-void clear_user_rxbuf(SceNetAdhocctlUserNode * user, int clear)
+void index_user_mac(SceNetAdhocctlUserNode * user)
+{
+	// Lock Index
+	pthread_mutex_lock(&_db_index_lock);
+	
+	// Link into MAC Hash Bucket
+	SceNetAdhocctlUserNode ** bucket = &_db_user_mac[hash_mac(&user->info->resolver.mac) & (_db_user_buckets - 1)];
+	user->mac_next = *bucket;
+	*bucket = user;
+	
+	// Mark User as indexed
+	user->macindexed = 1;
+	
+	// Unlock Index
+	pthread_mutex_unlock(&_db_index_lock);
+}
+
+/**
+ * Remove User from the IP and MAC Index
+ * @param user User Node
+ */
+void unindex_user(SceNetAdhocctlUserNode * user)
+{
+	// Lock Index
+	pthread_mutex_lock(&_db_index_lock);
+	
+	// Unlink from IP Hash Bucket
+	SceNetAdhocctlUserNode ** link = &_db_user_ip[hash_ip(user->info->resolver.ip) & (_db_user_buckets - 1)];
+	while(*link != NULL && *link != user) link = &(*link)->ip_next;
+	if(*link != NULL) *link = user->ip_next;
+	
+	// Unlink from MAC Hash Bucket
+	if(user->macindexed)
+	{
+		link = &_db_user_mac[hash_mac(&user->info->resolver.mac) & (_db_user_buckets - 1)];
+		while(*link != user) link = &(*link)->mac_next;
+		*link = user->mac_next;
+	}
+	
+	// Unlock Index
+	pthread_mutex_unlock(&_db_index_lock);
+}
+
+/**
+ * Grow Group Hash of a Game to fit one more Group
+ * @param game Game Node
+ * @return 0 if the Group Hash can take another Group or -1 on Error
+ */
+int grow_group_hash(SceNetAdhocctlGameNode * game)
 {
-	// Fix Clear Length
-	if(clear == -1 || clear > user->rxpos) clear = user->rxpos;
+	// Enough Buckets
+	if(game->groupcount < game->grouphashsize) return 0;
 	
-	// Move Buffer
-	memmove(user->rx, user->rx + clear, sizeof(user->rx) - clear);
+	// Allocate doubled Bucket Array
+	uint32_t size = (game->grouphashsize > 0) ? (game->grouphashsize * 2) : 8;
+	SceNetAdhocctlGroupNode ** grouphash = (SceNetAdhocctlGroupNode **)calloc(size, sizeof(SceNetAdhocctlGroupNode *));
 	
-	// Fix RX Buffer Pointer
-	user->rxpos -= clear;
+	// Out of Memory (an existing Hash still works with longer Chains)
+	if(grouphash == NULL) return (game->grouphashsize > 0) ? 0 : -1;
+	
+	// Rehash Groups
+	SceNetAdhocctlGroupNode * g = game->group; for(; g != NULL; g = g->next)
+	{
+		// Link into new Hash Bucket
+		SceNetAdhocctlGroupNode ** bucket = &grouphash[hash_group_name(&g->group) & (size - 1)];
+		g->hash_next = *bucket;
+		*bucket = g;
+	}
+	
+	// Replace Group Hash
+	free(game->grouphash);
+	game->grouphash = grouphash;
+	game->grouphashsize = size;
+	
+	// Return Success
+	return 0;
+}
+
+/**
+ * Get Batch Buffer (for building multi-packet Writes)
+ * @param size Required Size
+ * @return Buffer of at least the required Size or NULL
+ */
+uint8_t * get_batch_buffer(uint32_t size)
+{
+	// Buffer too small
+	if(size > _batch_size)
+	{
+		// Reallocate Buffer Memory
+		uint8_t * batch = (uint8_t *)realloc(_batch, size);
+		
+		// Out of Memory
+		if(batch == NULL) return NULL;
+		
+		// Save Buffer
+		_batch = batch;
+		_batch_size = size;
+	}
+	
+	// Return Buffer
+	return _batch;
 }
 
 /**
@@ -818,99 +1495,26 @@ void game_product_override(SceNetAdhocctlProductCode * product)
 	strncpy(productid, product->data, PRODUCT_CODE_LENGTH);
 	productid[PRODUCT_CODE_LENGTH] = 0;
 	
-	// Database Handle
-	sqlite3 * db = NULL;
+	// Acquire Product Catalog
+	SceNetAdhocctlCatalog * catalog = acquire_catalog();
 	
-	// Open Database
-	if(sqlite3_open(SERVER_DATABASE, &db) == SQLITE_OK)
+	// Find Product
+	const SceNetAdhocctlCatalogEntry * entry = find_catalog_entry(catalog, product);
+	
+	// Crosslinked Product
+	if(entry != NULL && entry->crosslinked)
 	{
-		// Crosslinked Flag
-		int crosslinked = 0;
-		
-		// Exists Flag
-		int exists = 0;
-		
-		// SQL Statements
-		const char * sql = "SELECT id_to FROM crosslinks WHERE id_from=?;";
-		const char * sql2 = "SELECT * FROM productids WHERE id=?;";
-		const char * sql3 = "INSERT INTO productids(id, name) VALUES(?, ?);";
-		
-		// Prepared SQL Statement
-		sqlite3_stmt * statement = NULL;
-		
-		// Prepare SQL Statement
-		if(sqlite3_prepare_v2(db, sql, strlen(sql) + 1, &statement, NULL) == SQLITE_OK)
-		{
-			// Bind SQL Statement Data
-			if(sqlite3_bind_text(statement, 1, productid, strlen(productid), SQLITE_STATIC) == SQLITE_OK)
-			{
-				// Found Matching Row
-				if(sqlite3_step(statement) == SQLITE_ROW)
-				{
-					// Grab Crosslink ID
-					const char * crosslink = (const char *)sqlite3_column_text(statement, 0);
-					
-					// Crosslink Product Code
-					strncpy(product->data, crosslink, PRODUCT_CODE_LENGTH);
-					
-					// Log Crosslink
-					printf("Crosslinked %s to %s.\n", productid, crosslink);
-					
-					// Set Crosslinked Flag
-					crosslinked = 1;
-				}
-			}
-			
-			// Destroy Prepared SQL Statement
-			sqlite3_finalize(statement);
-		}
+		// Crosslink Product Code
+		*product = entry->link;
 		
-		// Not Crosslinked
-		if(!crosslinked)
-		{
-			// Prepare SQL Statement
-			if(sqlite3_prepare_v2(db, sql2, strlen(sql2) + 1, &statement, NULL) == SQLITE_OK)
-			{
-				// Bind SQL Statement Data
-				if(sqlite3_bind_text(statement, 1, productid, strlen(productid), SQLITE_STATIC) == SQLITE_OK)
-				{
-					// Found Matching Row
-					if(sqlite3_step(statement) == SQLITE_ROW)
-					{
-						// Set Exists Flag
-						exists = 1;
-					}
-				}
-				
-				// Destroy Prepare SQL Statement
-				sqlite3_finalize(statement);
-			}
-			
-			// Game doesn't exist in Database
-			if(!exists)
-			{
-				// Prepare SQL Statement
-				if(sqlite3_prepare_v2(db, sql3, strlen(sql3) + 1, &statement, NULL) == SQLITE_OK)
-				{
-					// Bind SQL Statement Data
-					if(sqlite3_bind_text(statement, 1, productid, strlen(productid), SQLITE_STATIC) == SQLITE_OK && sqlite3_bind_text(statement, 2, productid, strlen(productid), SQLITE_STATIC) == SQLITE_OK)
-					{
-						// Save Product ID to Database
-						if(sqlite3_step(statement) == SQLITE_DONE)
-						{
-							// Log Addition
-							printf("Added Unknown Product ID %s to Database.\n", productid);
-						}
-					}
-					
-					// Destroy Prepare SQL Statement
-					sqlite3_finalize(statement);
-				}
-			}
-		}
-		
-		// Close Database
-		sqlite3_close(db);
+		// Log Crosslink (Text holds the Source Product Code)
+		log_user(LOG_LEVEL_INFO, LOG_EVENT_CROSSLINK, NULL, product, NULL, NULL, 0, productid);
 	}
+	
+	// Game doesn't exist in Database (written behind by the Writer Thread)
+	if(entry == NULL) queue_unknown_product(product);
+	
+	// Release Product Catalog
+	release_catalog(catalog);
 }
 
@@ -28,6 +28,9 @@
 #define USER_STATE_LOGGED_IN 1
 #define USER_STATE_TIMED_OUT 2
 
+// User RX Buffer Size (largest C2S Packet is the 144 Byte Login Packet)
+#define USER_RXBUF_SIZE 256 // Ring Buffer (must be a Power of Two)
+
 // PSP Resolver Information
 typedef struct
 {
@@ -45,8 +48,37 @@ typedef struct
 typedef struct SceNetAdhocctlGameNode SceNetAdhocctlGameNode;
 typedef struct SceNetAdhocctlGroupNode SceNetAdhocctlGroupNode;
 
-// Double-Linked User List
+// Cold User Data (Resolver Information and RX Buffer, kept out of the List Walks)
+typedef struct
+{
+	// Resolver Information
+	SceNetAdhocctlResolverInfo resolver;
+	
+	// Trace Connection Number (0 unless the Trace Recorder is running)
+	uint32_t trace;
+	
+	// I/O Ring Send in Flight (owns the former TX Queue)
+	struct SceNetAdhocctlUringSend * txflight;
+	
+	// I/O Ring Send scheduled
+	uint32_t txqueued;
+	
+	// RX Buffer
+	uint8_t rx[USER_RXBUF_SIZE];
+} SceNetAdhocctlUserInfo;
+
+// Double-Linked User List (Hot Fields first, one Node fills two Cache Lines)
 typedef struct SceNetAdhocctlUserNode {
+	// TCP Socket
+	int stream;
+	
+	// RX Ring Offsets (free-running, masked with USER_RXBUF_SIZE - 1)
+	uint16_t rxhead;
+	uint16_t rxtail;
+	
+	// Last Ping Update (Loop Clock Milliseconds)
+	uint64_t last_recv;
+	
 	// Next Element
 	struct SceNetAdhocctlUserNode * next;
 	
@@ -59,25 +91,36 @@ typedef struct SceNetAdhocctlUserNode {
 	// Previous Element
 	struct SceNetAdhocctlUserNode * group_prev;
 	
-	// Resolver Information
-	SceNetAdhocctlResolverInfo resolver;
-	
 	// Game Link
 	SceNetAdhocctlGameNode * game;
 	
 	// Group Link
 	SceNetAdhocctlGroupNode * group;
 	
-	// TCP Socket
-	int stream;
+	// Cold User Data
+	SceNetAdhocctlUserInfo * info;
 	
-	// Last Ping Update
-	time_t last_recv;
+	// TX Queue (unsent Data, allocated on Demand)
+	uint8_t * tx;
+	uint32_t txpos;
+	uint32_t txlen;
+	uint32_t txsize;
 	
-	// RX Buffer
-	uint8_t rx[1024];
-	uint32_t rxpos;
-} SceNetAdhocctlUserNode;
+	// MAC Index Flag
+	uint32_t macindexed;
+	
+	// Next Element (IP Hash Bucket)
+	struct SceNetAdhocctlUserNode * ip_next;
+	
+	// Next Element (MAC Hash Bucket)
+	struct SceNetAdhocctlUserNode * mac_next;
+	
+	// Next Element (Idle List, ordered by last_recv)
+	struct SceNetAdhocctlUserNode * idle_next;
+	
+	// Previous Element (Idle List)
+	struct SceNetAdhocctlUserNode * idle_prev;
+} __attribute__((aligned(64))) SceNetAdhocctlUserNode;
 
 // Double-Linked Game List
 struct SceNetAdhocctlGameNode {
@@ -87,6 +130,9 @@ struct SceNetAdhocctlGameNode {
 	// Previous Element
 	struct SceNetAdhocctlGameNode * prev;
 	
+	// Next Element (Hash Bucket)
+	struct SceNetAdhocctlGameNode * hash_next;
+	
 	// PSP Game Product Code
 	SceNetAdhocctlProductCode game;
 	
@@ -98,6 +144,15 @@ struct SceNetAdhocctlGameNode {
 	
 	// Double-Linked Group List
 	SceNetAdhocctlGroupNode * group;
+	
+	// Group Hash Index (grown with the Group Count)
+	SceNetAdhocctlGroupNode ** grouphash;
+	uint32_t grouphashsize;
+	
+	// Serialized Scan Result (Group Packets + Scan Complete, empty when stale)
+	uint8_t * scan;
+	uint32_t scanlen;
+	uint32_t scansize;
 };
 
 // Double-Linked Group List
@@ -108,6 +163,9 @@ struct SceNetAdhocctlGroupNode {
 	// Previous Element
 	struct SceNetAdhocctlGroupNode * prev;
 	
+	// Next Element (Hash Bucket)
+	struct SceNetAdhocctlGroupNode * hash_next;
+	
 	// Game Link
 	SceNetAdhocctlGameNode * game;
 	
@@ -119,30 +177,121 @@ struct SceNetAdhocctlGroupNode {
 	
 	// Double-Linked Player List
 	SceNetAdhocctlUserNode * player;
+	
+	// Group Host (Founder, the oldest Player at the List Tail)
+	SceNetAdhocctlUserNode * host;
 };
 
-// User Count
+// User Count (all Threads)
 extern uint32_t _db_user_count;
 
-// User Database
-extern SceNetAdhocctlUserNode * _db_user;
+// User Hash Buckets for the IP and MAC Index (Power of 2, sized by init_database)
+extern uint32_t _db_user_buckets;
+
+// User Database (per Thread)
+extern __thread SceNetAdhocctlUserNode * _db_user;
+
+// User Idle List of the calling Thread (least recently heard from first)
+extern __thread SceNetAdhocctlUserNode * _db_user_idle;
+
+// Game Database (per Thread)
+extern __thread SceNetAdhocctlGameNode * _db_game;
+
+/**
+ * Hash IP Address
+ * @param ip IP Address (Network Order)
+ * @return Hash
+ */
+uint32_t hash_ip(uint32_t ip);
+
+/**
+ * Hash Game Product Code
+ * @param product Game Product Code
+ * @return FNV-1a Hash
+ */
+uint32_t hash_product_code(SceNetAdhocctlProductCode * product);
+
+/**
+ * Find Game in the Database of the calling Thread
+ * @param product Game Product Code
+ * @return Game Node or NULL
+ */
+SceNetAdhocctlGameNode * find_game(SceNetAdhocctlProductCode * product);
+
+/**
+ * Hash Group Name
+ * @param group Group Name
+ * @return FNV-1a Hash (up to the first NUL, like the Group Name Comparison)
+ */
+uint32_t hash_group_name(SceNetAdhocctlGroupName * group);
+
+/**
+ * Find Group in Game Node
+ * @param game Game Node
+ * @param group Group Name
+ * @return Group Node or NULL
+ */
+SceNetAdhocctlGroupNode * find_group(SceNetAdhocctlGameNode * game, SceNetAdhocctlGroupName * group);
+
+/**
+ * Lock IP and MAC Index (required for Lookups in Sharded Mode)
+ */
+void lock_user_index(void);
 
-// Game Database
-extern SceNetAdhocctlGameNode * _db_game;
+/**
+ * Unlock IP and MAC Index
+ */
+void unlock_user_index(void);
+
+/**
+ * Find User by IP Address (Index Lock must be held)
+ * @param ip IP Address (Network Order)
+ * @return User Node or NULL
+ */
+SceNetAdhocctlUserNode * find_user_by_ip(uint32_t ip);
+
+/**
+ * Find User by MAC Address (Index Lock must be held)
+ * @param mac MAC Address
+ * @return User Node or NULL
+ */
+SceNetAdhocctlUserNode * find_user_by_mac(SceNetEtherAddr * mac);
 
 /**
  * Login User into Database (Stream)
  * @param fd Socket
  * @param ip IP Address (Network Order)
+ * @return User Node or NULL if the Connection was refused
  */
-void login_user_stream(int fd, uint32_t ip);
+SceNetAdhocctlUserNode * login_user_stream(int fd, uint32_t ip);
 
 /**
  * Login User into Database (Login Data)
  * @param user User Node
  * @param data Login Packet
+ * @return 0 on Success or -1 if the User was logged out (or handed to a Worker Thread)
+ */
+int login_user_data(SceNetAdhocctlUserNode * user, SceNetAdhocctlLoginPacketC2S * data);
+
+/**
+ * Login User into Database (Game)
+ * @param user User Node (with Resolver Information)
+ * @param product Resolved Game Product Code
+ * @return 0 on Success or -1 if the User was logged out
+ */
+int login_user_game(SceNetAdhocctlUserNode * user, SceNetAdhocctlProductCode * product);
+
+/**
+ * Attach User to the Database of the calling Thread
+ * @param user User Node
+ */
+void attach_user(SceNetAdhocctlUserNode * user);
+
+/**
+ * Detach User from the Database of the calling Thread
+ * @param user User Node
  */
-void login_user_data(SceNetAdhocctlUserNode * user, SceNetAdhocctlLoginPacketC2S * data);
+void detach_user(SceNetAdhocctlUserNode * user);
 
 /**
  * Logout User from Database
@@ -150,6 +299,17 @@ void login_user_data(SceNetAdhocctlUserNode * user, SceNetAdhocctlLoginPacketC2S
  */
 void logout_user(SceNetAdhocctlUserNode * user);
 
+/**
+ * Initialize Database (allocates the Node Pools)
+ * @return 0 on Success or -1 if out of Memory
+ */
+int init_database(void);
+
+/**
+ * Destroy Database (releases the Node Pools, all Threads must be done)
+ */
+void destroy_database(void);
+
 /**
  * Free Database Memory
  */
@@ -159,27 +319,44 @@ void free_database(void);
  * Connect User to Game Group
  * @param user User Node
  * @param group Group Name
+ * @return 0 on Success or -1 if the User was logged out
  */
-void connect_user(SceNetAdhocctlUserNode * user, SceNetAdhocctlGroupName * group);
+int connect_user(SceNetAdhocctlUserNode * user, SceNetAdhocctlGroupName * group);
 
 /**
  * Disconnect User from Game Group
  * @param user User Node
+ * @return 0 on Success or -1 if the User was logged out
  */
-void disconnect_user(SceNetAdhocctlUserNode * user);
+int disconnect_user(SceNetAdhocctlUserNode * user);
 
 /**
  * Send Game Group List
  * @param user User Node
+ * @return 0 on Success or -1 if the User was logged out
  */
-void send_scan_results(SceNetAdhocctlUserNode * user);
+int send_scan_results(SceNetAdhocctlUserNode * user);
+
+/**
+ * Serialize the Scan Result of a Game (one Packet per Group + Scan Complete)
+ * @param game Game Node
+ * @return 0 on Success or -1 if out of Memory
+ */
+int build_scan_result(SceNetAdhocctlGameNode * game);
 
 /**
  * Spread Chat Message in P2P Network
  * @param user Sender User Node
  * @param message Chat Message
+ * @return 0 on Success or -1 if the Sender was logged out
  */
-void spread_message(SceNetAdhocctlUserNode * user, char * message);
+int spread_message(SceNetAdhocctlUserNode * user, char * message);
+
+/**
+ * Refresh User Death Clock (moves the User to the End of the Idle List)
+ * @param user User Node
+ */
+void touch_user(SceNetAdhocctlUserNode * user);
 
 /**
  * Get User State
@@ -188,11 +365,18 @@ void spread_message(SceNetAdhocctlUserNode * user, char * message);
 int get_user_state(SceNetAdhocctlUserNode * user);
 
 /**
- * Clear RX Buffer
+ * Send Data to User (queues what the Socket can't take right now)
+ * @param user User Node
+ * @param data Data
+ * @param size Size of Data
+ */
+void send_user_data(SceNetAdhocctlUserNode * user, const void * data, uint32_t size);
+
+/**
+ * Flush TX Queue (call when the Socket became writable)
  * @param user User Node
- * @param clear Number of Bytes to clear (-1 for all)
  */
-void clear_user_rxbuf(SceNetAdhocctlUserNode * user, int clear);
+void flush_user_txbuf(SceNetAdhocctlUserNode * user);
 
 /**
  * Patch Game Product Code
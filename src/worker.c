@@ -0,0 +1,318 @@
+/*
+ * This file is part of PRO ONLINE.
+
+ * PRO ONLINE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * PRO ONLINE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PRO ONLINE. If not, see <http://www.gnu.org/licenses/ .
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <user.h>
+#include <loop.h>
+#include <worker.h>
+#include <log.h>
+#include <catalog.h>
+
+// Worker Count (0 for Single-Threaded Mode)
+uint32_t _worker_count = 0;
+
+// Worker Threads
+SceNetAdhocctlWorker * _workers = NULL;
+
+// Function Prototypes
+void * worker_main(void * arg);
+SceNetAdhocctlWorker * find_worker(SceNetAdhocctlProductCode * game);
+
+/**
+ * Start Worker Threads
+ * @param count Number of Worker Threads
+ * @return 0 on Success or -1 on Error
+ */
+int start_workers(uint32_t count)
+{
+	// Single-Threaded Mode
+	if(count == 0) return 0;
+	
+	// Allocate Worker Memory
+	_workers = (SceNetAdhocctlWorker *)calloc(count, sizeof(SceNetAdhocctlWorker));
+	
+	// Out of Memory
+	if(_workers == NULL) return -1;
+	
+	// Keep Signals on the Acceptor Thread (Workers inherit this Mask)
+	sigset_t mask, oldmask;
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGINT);
+	sigaddset(&mask, SIGTERM);
+	sigaddset(&mask, SIGHUP);
+	pthread_sigmask(SIG_BLOCK, &mask, &oldmask);
+	
+	// Create Workers
+	uint32_t i = 0; for(; i < count; i++)
+	{
+		// Worker
+		SceNetAdhocctlWorker * worker = &_workers[i];
+		
+		// Initialize Locks
+		pthread_mutex_init(&worker->lock, NULL);
+		pthread_mutex_init(&worker->handofflock, NULL);
+		
+		// Create Wakeup Event
+		worker->wakeup = eventfd(0, EFD_NONBLOCK);
+		
+		// Create Worker Thread
+		if(worker->wakeup == -1 || pthread_create(&worker->thread, NULL, worker_main, worker) != 0)
+		{
+			// Notify User
+			log_text(LOG_LEVEL_ERROR, "%s: failed to create Worker Thread %u.", __func__, i);
+			
+			// Close Wakeup Event
+			if(worker->wakeup != -1) close(worker->wakeup);
+			
+			// Stop here
+			break;
+		}
+		
+		// Count Worker
+		_worker_count++;
+	}
+	
+	// Restore Signal Mask
+	pthread_sigmask(SIG_SETMASK, &oldmask, NULL);
+	
+	// Not all Workers started
+	if(_worker_count < count)
+	{
+		// Drop Server Status (makes the running Workers leave their Loop)
+		_status = 0;
+		
+		// Stop running Workers
+		stop_workers();
+		
+		// Return Error
+		return -1;
+	}
+	
+	// Return Success
+	return 0;
+}
+
+/**
+ * Stop Worker Threads (logs out all of their Users)
+ */
+void stop_workers(void)
+{
+	// Wake Workers (they leave their Loop once the Server Status dropped)
+	uint32_t i = 0; for(; i < _worker_count; i++)
+	{
+		// Signal Wakeup Event
+		uint64_t wakeup = 1;
+		write(_workers[i].wakeup, &wakeup, sizeof(wakeup));
+	}
+	
+	// Wait for Workers
+	for(i = 0; i < _worker_count; i++)
+	{
+		// Worker
+		SceNetAdhocctlWorker * worker = &_workers[i];
+		
+		// Join Worker Thread
+		pthread_join(worker->thread, NULL);
+		
+		// Close Wakeup Event
+		close(worker->wakeup);
+		
+		// Free Handoff Queue & Adoption Batch
+		free(worker->handoff);
+		free(worker->adopt);
+		
+		// Destroy Locks
+		pthread_mutex_destroy(&worker->lock);
+		pthread_mutex_destroy(&worker->handofflock);
+	}
+	
+	// Back to Single-Threaded Mode
+	_worker_count = 0;
+	
+	// Free Worker Memory
+	free(_workers);
+	_workers = NULL;
+}
+
+/**
+ * Hand User over to the Worker of its Game
+ * @param user User Node (owned by the calling Thread)
+ * @param game Resolved Game Product Code
+ */
+void handoff_user(SceNetAdhocctlUserNode * user, SceNetAdhocctlProductCode * game)
+{
+	// Find Worker
+	SceNetAdhocctlWorker * worker = find_worker(game);
+	
+	// Stop watching User Socket
+	unwatch_user(user);
+	
+	// Unlink User from this Thread
+	detach_user(user);
+	
+	// Lock Handoff Queue
+	pthread_mutex_lock(&worker->handofflock);
+	
+	// Grow Handoff Queue
+	if(worker->handoffcount == worker->handoffsize)
+	{
+		// New Queue Size
+		uint32_t size = (worker->handoffsize > 0) ? (worker->handoffsize * 2) : 16;
+		
+		// Reallocate Queue Memory
+		SceNetAdhocctlHandoff * handoff = (SceNetAdhocctlHandoff *)realloc(worker->handoff, size * sizeof(SceNetAdhocctlHandoff));
+		
+		// Allocated Queue Memory
+		if(handoff != NULL)
+		{
+			// Save Queue
+			worker->handoff = handoff;
+			worker->handoffsize = size;
+		}
+	}
+	
+	// Queue has Space
+	int queued = (worker->handoffcount < worker->handoffsize);
+	if(queued)
+	{
+		// Queue User
+		worker->handoff[worker->handoffcount].user = user;
+		worker->handoff[worker->handoffcount].game = *game;
+		worker->handoffcount++;
+	}
+	
+	// Unlock Handoff Queue
+	pthread_mutex_unlock(&worker->handofflock);
+	
+	// Queued User
+	if(queued)
+	{
+		// Wake Worker
+		uint64_t wakeup = 1;
+		write(worker->wakeup, &wakeup, sizeof(wakeup));
+	}
+	
+	// Out of Memory
+	else
+	{
+		// Relink User to this Thread
+		attach_user(user);
+		
+		// Logout User
+		logout_user(user);
+	}
+}
+
+/**
+ * Adopt Users handed over to the Worker (called from the Worker Thread)
+ * @param worker Worker
+ */
+void adopt_users(SceNetAdhocctlWorker * worker)
+{
+	// Lock Handoff Queue
+	pthread_mutex_lock(&worker->handofflock);
+	
+	// Take Handoffs (the Acceptor keeps queueing into the emptied Batch Memory)
+	SceNetAdhocctlHandoff * batch = worker->handoff;
+	uint32_t batchsize = worker->handoffsize;
+	uint32_t count = worker->handoffcount;
+	worker->handoff = worker->adopt;
+	worker->handoffsize = worker->adoptsize;
+	worker->handoffcount = 0;
+	
+	// Unlock Handoff Queue (Logins below must not stall the Acceptor)
+	pthread_mutex_unlock(&worker->handofflock);
+	
+	// Iterate Handoffs
+	uint32_t i = 0; for(; i < count; i++)
+	{
+		// Handoff
+		SceNetAdhocctlHandoff * handoff = &batch[i];
+		
+		// Link User to this Thread
+		attach_user(handoff->user);
+		
+		// Finish Login and process pipelined Packets
+		if(login_user_game(handoff->user, &handoff->game) == 0 && process_user_packets(handoff->user) == 0)
+		{
+			// Watch User Socket
+			watch_user(handoff->user);
+		}
+	}
+	
+	// Keep Batch Memory for the next Swap
+	worker->adopt = batch;
+	worker->adoptsize = batchsize;
+}
+
+/**
+ * Worker Thread Entry Point
+ * @param arg Worker
+ * @return NULL
+ */
+void * worker_main(void * arg)
+{
+	// Worker
+	SceNetAdhocctlWorker * worker = (SceNetAdhocctlWorker *)arg;
+	
+	// Publish Worker Database
+	pthread_mutex_lock(&worker->lock);
+	worker->db_user = &_db_user;
+	worker->db_game = &_db_game;
+	pthread_mutex_unlock(&worker->lock);
+	
+	// Enter Worker Loop
+	run_event_loop(-1, -1, worker);
+	
+	// Lock Worker Database
+	pthread_mutex_lock(&worker->lock);
+	
+	// Adopt late Handoffs (so they get logged out properly)
+	adopt_users(worker);
+	
+	// Free Worker Database Memory
+	free_database();
+	
+	// Drop cached Catalog Reference
+	drop_catalog_cache();
+	
+	// Retract Worker Database (Thread-Local Storage dies with the Thread)
+	worker->db_user = NULL;
+	worker->db_game = NULL;
+	
+	// Unlock Worker Database
+	pthread_mutex_unlock(&worker->lock);
+	
+	// Exit Thread
+	return NULL;
+}
+
+/**
+ * Find Worker responsible for a Game
+ * @param game Game Product Code
+ * @return Worker
+ */
+SceNetAdhocctlWorker * find_worker(SceNetAdhocctlProductCode * game)
+{
+	// Use the upper Hash Bits (the lower ones index the Game Hash of the Worker)
+	return &_workers[(hash_product_code(game) >> 16) % _worker_count];
+}
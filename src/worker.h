@@ -0,0 +1,95 @@
+/*
+ * This file is part of PRO ONLINE.
+
+ * PRO ONLINE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * PRO ONLINE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PRO ONLINE. If not, see <http://www.gnu.org/licenses/ .
+ */
+
+#ifndef _WORKER_H_
+#define _WORKER_H_
+
+#include <stdint.h>
+#include <pthread.h>
+#include <user.h>
+
+// Login Handoff (User waiting for its Worker to finish the Login)
+typedef struct
+{
+	// User Node
+	SceNetAdhocctlUserNode * user;
+	
+	// Resolved Game Product Code
+	SceNetAdhocctlProductCode game;
+} SceNetAdhocctlHandoff;
+
+// Worker Thread (owns the Users, Games and Groups of its Product Codes)
+typedef struct
+{
+	// Thread Handle
+	pthread_t thread;
+	
+	// Wakeup Event (signalled on Handoff and Shutdown)
+	int wakeup;
+	
+	// Database Lock (held while the Worker processes Events)
+	pthread_mutex_t lock;
+	
+	// Worker Database (NULL while the Worker isn't running)
+	SceNetAdhocctlUserNode ** db_user;
+	SceNetAdhocctlGameNode ** db_game;
+	
+	// Handoff Queue Lock
+	pthread_mutex_t handofflock;
+	
+	// Handoff Queue
+	SceNetAdhocctlHandoff * handoff;
+	uint32_t handoffcount;
+	uint32_t handoffsize;
+	
+	// Adoption Batch (swapped with the Handoff Queue, only the Worker touches it)
+	SceNetAdhocctlHandoff * adopt;
+	uint32_t adoptsize;
+} SceNetAdhocctlWorker;
+
+// Worker Count (0 for Single-Threaded Mode)
+extern uint32_t _worker_count;
+
+// Worker Threads
+extern SceNetAdhocctlWorker * _workers;
+
+/**
+ * Start Worker Threads
+ * @param count Number of Worker Threads
+ * @return 0 on Success or -1 on Error
+ */
+int start_workers(uint32_t count);
+
+/**
+ * Stop Worker Threads (logs out all of their Users)
+ */
+void stop_workers(void);
+
+/**
+ * Hand User over to the Worker of its Game
+ * @param user User Node (owned by the calling Thread)
+ * @param game Resolved Game Product Code
+ */
+void handoff_user(SceNetAdhocctlUserNode * user, SceNetAdhocctlProductCode * game);
+
+/**
+ * Adopt Users handed over to the Worker (called from the Worker Thread)
+ * @param worker Worker
+ */
+void adopt_users(SceNetAdhocctlWorker * worker);
+
+#endif
@@ -0,0 +1,653 @@
+/*
+ * This file is part of PRO ONLINE.
+
+ * PRO ONLINE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * PRO ONLINE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PRO ONLINE. If not, see <http://www.gnu.org/licenses/ .
+ */
+
+/*
+ * User Database Microbenchmark
+ *
+ * Drives the User Database Operations of src/user.c directly (no Event Loop,
+ * no Network) against Socket Pairs, one per simulated User. The Bench side
+ * of every Pair is drained between timed Chunks, so the measured Sends go
+ * through the same non-blocking Socket Path as in the Server.
+ *
+ * Every Operation is timed in Chunks of BENCH_CHUNK Calls and reported as
+ * Nanoseconds per Call. Heap Allocations (malloc, calloc & realloc of the
+ * benchmarking Thread) get counted through Linker Wrappers (see Makefile).
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <arpa/inet.h>
+#include <config.h>
+#include <user.h>
+#include <status.h>
+#include <catalog.h>
+#include <http.h>
+#include <log.h>
+#include <settings.h>
+
+// Operations per timed Chunk (Peers get drained between Chunks)
+#define BENCH_CHUNK 64
+
+// Status Captures per Scale (every Round captures the whole Database and renders it)
+#define BENCH_STATUS_ROUNDS 100
+
+// Benchmark Scale
+typedef struct
+{
+	// Users
+	uint32_t users;
+	
+	// Games (Users are spread evenly)
+	uint32_t games;
+	
+	// Groups per Game (Players of a Game are spread evenly)
+	uint32_t groups;
+} SceNetAdhocctlBenchScale;
+
+// Default Scales (used without -u / -g / -G)
+static const SceNetAdhocctlBenchScale _default_scales[] = {
+	{ 10, 1, 1 },
+	{ 100, 1, 10 },
+	{ 1000, 1, 1000 },
+	{ 1000, 50, 5 },
+	{ 1000, 500, 1 },
+	{ 10000, 1, 1000 },
+	{ 10000, 500, 5 },
+};
+
+// Report Output
+static FILE * _report = NULL;
+
+// Current Scale
+static SceNetAdhocctlBenchScale _scale;
+
+// User Nodes (NULL once logged out)
+static SceNetAdhocctlUserNode ** _users = NULL;
+
+// Server Side of the Socket Pairs (owned by the User Node once logged in)
+static int * _streams = NULL;
+
+// Bench Side of the Socket Pairs
+static int * _peers = NULL;
+
+// Peer Drain Poll
+static int _drain = -1;
+
+// Failed Operations (the User got logged out)
+static uint32_t _failures = 0;
+
+// Heap Allocations of the benchmarking Thread (counted by the Linker Wrappers)
+static __thread uint64_t _allocations = 0;
+
+// Chat Message
+static char _message[64] = "The quick brown fox jumps over the lazy dog.";
+
+// Linker Wrapped Allocator
+void * __real_malloc(size_t size);
+void * __real_calloc(size_t count, size_t size);
+void * __real_realloc(void * ptr, size_t size);
+
+// Function Prototypes
+void usage(const char * program);
+uint64_t get_clock(void);
+int open_users(uint32_t count);
+void close_users(uint32_t count);
+void drain_peers(void);
+void run_operation(const char * name, void (* operation)(uint32_t), uint32_t count, uint32_t first, uint32_t step);
+void run_scale(void);
+void bench_login_stream(uint32_t index);
+void bench_login_data(uint32_t index);
+void bench_connect(uint32_t index);
+void bench_spread(uint32_t index);
+void bench_disconnect(uint32_t index);
+void bench_scan(uint32_t index);
+void bench_update_status(uint32_t index);
+void bench_status_json(uint32_t index);
+void bench_logout(uint32_t index);
+
+/**
+ * Counting malloc Wrapper
+ * @param size Size
+ * @return Memory
+ */
+void * __wrap_malloc(size_t size)
+{
+	_allocations++;
+	return __real_malloc(size);
+}
+
+/**
+ * Counting calloc Wrapper
+ * @param count Element Count
+ * @param size Element Size
+ * @return Memory
+ */
+void * __wrap_calloc(size_t count, size_t size)
+{
+	_allocations++;
+	return __real_calloc(count, size);
+}
+
+/**
+ * Counting realloc Wrapper
+ * @param ptr Memory
+ * @param size New Size
+ * @return Memory
+ */
+void * __wrap_realloc(void * ptr, size_t size)
+{
+	_allocations++;
+	return __real_realloc(ptr, size);
+}
+
+/**
+ * Benchmark Entry Point
+ * @param argc Number of Arguments
+ * @param argv Arguments
+ * @return OS Error Code
+ */
+int main(int argc, char * argv[])
+{
+	// Custom Scale
+	SceNetAdhocctlBenchScale custom = { 0, 1, 1 };
+	
+	// Parse Options
+	int option = 0;
+	while((option = getopt(argc, argv, "u:g:G:")) != -1)
+	{
+		switch(option)
+		{
+			case 'u': custom.users = (uint32_t)atoi(optarg); break;
+			case 'g': custom.games = (uint32_t)atoi(optarg); break;
+			case 'G': custom.groups = (uint32_t)atoi(optarg); break;
+			default: usage(argv[0]); return 1;
+		}
+	}
+	
+	// Invalid Scale
+	if(custom.games == 0 || custom.games > 10000 || custom.groups == 0 || custom.groups > 10000000)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+	
+	// Report Output (Standard Output belongs to the Log Thread)
+	_report = fdopen(dup(STDOUT_FILENO), "w");
+	if(_report == NULL || freopen("/dev/null", "w", stdout) == NULL)
+	{
+		fprintf(stderr, "Failed to redirect the Log Output.\n");
+		return 1;
+	}
+	
+	// Scales
+	const SceNetAdhocctlBenchScale * scales = (custom.users > 0) ? &custom : _default_scales;
+	uint32_t scalecount = (custom.users > 0) ? 1 : sizeof(_default_scales) / sizeof(_default_scales[0]);
+	
+	// Size the Database for the largest Scale
+	_settings.usermax = 1;
+	uint32_t i = 0; for(; i < scalecount; i++) if(scales[i].users > _settings.usermax) _settings.usermax = scales[i].users;
+	
+	// Raise Descriptor Limit (two Sockets per User)
+	struct rlimit limit;
+	if(getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY && limit.rlim_cur < _settings.usermax * 2ULL + 64)
+	{
+		// Raise Soft Limit (up to the Hard Limit)
+		rlim_t previous = limit.rlim_cur;
+		limit.rlim_cur = (limit.rlim_max == RLIM_INFINITY || limit.rlim_max > _settings.usermax * 2ULL + 64) ? _settings.usermax * 2ULL + 64 : limit.rlim_max;
+		if(setrlimit(RLIMIT_NOFILE, &limit) == -1) limit.rlim_cur = previous;
+		
+		// Shrink the Database to the Descriptor Limit
+		if(limit.rlim_cur < _settings.usermax * 2ULL + 64) _settings.usermax = (limit.rlim_cur > 66) ? (uint32_t)((limit.rlim_cur - 64) / 2) : 1;
+	}
+	
+	// Start Log Thread (Records cost what they cost in the Server)
+	start_logger();
+	
+	// Allocate Node Pools
+	if(init_database() == -1)
+	{
+		fprintf(stderr, "Out of Memory for %u Users.\n", _settings.usermax);
+		stop_logger();
+		return 1;
+	}
+	
+	// Load Product Catalog (read-only, Logins run without it)
+	load_catalog();
+	
+	// Create Peer Drain Poll
+	_drain = epoll_create1(0);
+	
+	// Run Scales
+	for(i = 0; i < scalecount; i++)
+	{
+		// Set Scale
+		_scale = scales[i];
+		
+		// Not enough Descriptors for the Scale
+		if(_scale.users > _settings.usermax)
+		{
+			fprintf(_report, "\n(%u Users capped by the Descriptor Limit)\n", _scale.users);
+			_scale.users = _settings.usermax;
+		}
+		
+		// Print Scale
+		fprintf(_report, "\n%u Users, %u Games, %u Groups per Game\n", _scale.users, _scale.games, _scale.groups);
+		fprintf(_report, "%-20s %10s %12s %10s %10s\n", "operation", "ops", "ns/op", "allocs/op", "failures");
+		fflush(_report);
+		
+		// Run Scale
+		run_scale();
+		fflush(_report);
+	}
+	
+	// Free Resources
+	close(_drain);
+	free_catalog();
+	destroy_database();
+	stop_logger();
+	fclose(_report);
+	
+	// Return Success
+	return 0;
+}
+
+/**
+ * Print Usage
+ * @param program Program Name
+ */
+void usage(const char * program)
+{
+	fprintf(stderr, "Usage: %s [-u users] [-g games] [-G groups]\n", program);
+	fprintf(stderr, "  -u count  Users (runs the default Scales if omitted)\n");
+	fprintf(stderr, "  -g count  Games, Users are spread evenly (default 1)\n");
+	fprintf(stderr, "  -G count  Groups per Game, Players are spread evenly (default 1)\n");
+}
+
+/**
+ * Get Monotonic Clock
+ * @return Nanoseconds
+ */
+uint64_t get_clock(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+/**
+ * Open Socket Pairs for the simulated Users
+ * @param count User Count
+ * @return 0 on Success or -1 on Error
+ */
+int open_users(uint32_t count)
+{
+	// Allocate Arrays
+	_users = (SceNetAdhocctlUserNode **)calloc(count, sizeof(SceNetAdhocctlUserNode *));
+	_streams = (int *)malloc(count * sizeof(int));
+	_peers = (int *)malloc(count * sizeof(int));
+	if(_users == NULL || _streams == NULL || _peers == NULL) return -1;
+	
+	// Create Socket Pairs
+	uint32_t i = 0; for(; i < count; i++)
+	{
+		// Create Socket Pair
+		int pair[2];
+		if(socketpair(AF_UNIX, SOCK_STREAM, 0, pair) == -1)
+		{
+			// Notify User
+			fprintf(stderr, "socketpair failed after %u Users: %s\n", i, strerror(errno));
+			
+			// Close created Pairs
+			while(i-- > 0)
+			{
+				close(_streams[i]);
+				close(_peers[i]);
+			}
+			
+			// Return Error
+			return -1;
+		}
+		
+		// Non-Blocking like accepted Streams
+		fcntl(pair[0], F_SETFL, O_NONBLOCK);
+		fcntl(pair[1], F_SETFL, O_NONBLOCK);
+		
+		// Save Sockets
+		_streams[i] = pair[0];
+		_peers[i] = pair[1];
+		
+		// Watch Bench Side for Drains
+		struct epoll_event event;
+		memset(&event, 0, sizeof(event));
+		event.events = EPOLLIN;
+		event.data.u32 = i;
+		epoll_ctl(_drain, EPOLL_CTL_ADD, pair[1], &event);
+	}
+	
+	// Return Success
+	return 0;
+}
+
+/**
+ * Close Socket Pairs of the simulated Users (after the Logout)
+ * @param count User Count
+ */
+void close_users(uint32_t count)
+{
+	// Close Bench Side (the Server Side got closed by logout_user)
+	uint32_t i = 0; for(; _peers != NULL && i < count; i++) close(_peers[i]);
+	
+	// Free Arrays
+	free(_users);
+	free(_streams);
+	free(_peers);
+	_users = NULL;
+	_streams = NULL;
+	_peers = NULL;
+}
+
+/**
+ * Read and discard everything the Server sent to the simulated Users
+ */
+void drain_peers(void)
+{
+	// Scratch Buffer
+	static uint8_t scratch[65536];
+	
+	// Drain until no Peer is readable
+	while(1)
+	{
+		// Readable Peers
+		struct epoll_event events[256];
+		int count = epoll_wait(_drain, events, 256, 0);
+		if(count <= 0) return;
+		
+		// Drain Peers
+		int i = 0; for(; i < count; i++)
+		{
+			// Bench Side
+			int peer = _peers[events[i].data.u32];
+			
+			// Read everything
+			ssize_t recvresult = 0;
+			while((recvresult = recv(peer, scratch, sizeof(scratch), MSG_DONTWAIT)) > 0);
+			
+			// Server Side closed (Logout), stop watching
+			if(recvresult == 0) epoll_ctl(_drain, EPOLL_CTL_DEL, peer, NULL);
+		}
+	}
+}
+
+/**
+ * Time Operation and print a Report Row
+ * @param name Operation Name (NULL runs the Operation without Report)
+ * @param operation Operation
+ * @param count Number of Calls
+ * @param first First User Index
+ * @param step User Index Step
+ */
+void run_operation(const char * name, void (* operation)(uint32_t), uint32_t count, uint32_t first, uint32_t step)
+{
+	// Totals
+	uint64_t nanoseconds = 0;
+	uint64_t allocations = 0;
+	uint32_t failures = _failures;
+	
+	// Run Chunks
+	uint32_t done = 0;
+	while(done < count)
+	{
+		// Chunk Size
+		uint32_t chunk = (count - done < BENCH_CHUNK) ? count - done : BENCH_CHUNK;
+		
+		// Chunk Start
+		uint64_t allocated = _allocations;
+		uint64_t start = get_clock();
+		
+		// Run Chunk
+		uint32_t i = 0; for(; i < chunk; i++) operation(first + (done + i) * step);
+		
+		// Chunk End
+		nanoseconds += get_clock() - start;
+		allocations += _allocations - allocated;
+		done += chunk;
+		
+		// Empty Peer Sockets (keeps the TX Path on the direct Send)
+		drain_peers();
+	}
+	
+	// Print Row
+	if(name != NULL && count > 0) fprintf(_report, "%-20s %10u %12.1f %10.2f %10u\n", name, count, (double)nanoseconds / count, (double)allocations / count, _failures - failures);
+}
+
+/**
+ * Run all Operations at the current Scale
+ */
+void run_scale(void)
+{
+	// User Count
+	uint32_t users = _scale.users;
+	
+	// Create Socket Pairs
+	if(open_users(users) == -1)
+	{
+		close_users(0);
+		return;
+	}
+	
+	// Login
+	run_operation("login_user_stream", bench_login_stream, users, 0, 1);
+	run_operation("login_user_data", bench_login_data, users, 0, 1);
+	
+	// Join Groups
+	run_operation("connect_user", bench_connect, users, 0, 1);
+	
+	// Chat
+	run_operation("spread_message", bench_spread, users, 0, 1);
+	
+	// Status (the Capture runs on the next JSON Request after a Change)
+	run_operation("update_status", bench_update_status, users, 0, 1);
+	run_operation("serve_status_json", bench_status_json, BENCH_STATUS_ROUNDS, 0, 1);
+	
+	// Leave Groups (odd Users), they scan while the even Users keep the Groups alive
+	run_operation("disconnect_user", bench_disconnect, users / 2, 1, 2);
+	run_operation("send_scan_results", bench_scan, users / 2, 1, 2);
+	
+	// Leave Groups (even Users, untimed)
+	run_operation(NULL, bench_disconnect, (users + 1) / 2, 0, 2);
+	
+	// Logout
+	run_operation("logout_user", bench_logout, users, 0, 1);
+	
+	// Close Socket Pairs
+	close_users(users);
+}
+
+/**
+ * Accept simulated User
+ * @param index User Index
+ */
+void bench_login_stream(uint32_t index)
+{
+	// Login Stream (unique IP Address per User)
+	_users[index] = login_user_stream(_streams[index], htonl(0x0A000001 + index));
+	
+	// Refused
+	if(_users[index] == NULL) _failures++;
+}
+
+/**
+ * Login simulated User into its Game
+ * @param index User Index
+ */
+void bench_login_data(uint32_t index)
+{
+	// Logged out User
+	if(_users[index] == NULL) return;
+	
+	// Login Packet
+	SceNetAdhocctlLoginPacketC2S packet;
+	memset(&packet, 0, sizeof(packet));
+	packet.base.opcode = OPCODE_LOGIN;
+	packet.mac.data[0] = 0x02;
+	packet.mac.data[2] = (uint8_t)(index >> 24);
+	packet.mac.data[3] = (uint8_t)(index >> 16);
+	packet.mac.data[4] = (uint8_t)(index >> 8);
+	packet.mac.data[5] = (uint8_t)index;
+	snprintf((char *)packet.name.data, sizeof(packet.name.data), "bench%u", index);
+	
+	// Product Code (9 Characters, A-Z & 0-9, sized for 10 Digits although the Game Limit keeps it at 4)
+	char game[PRODUCT_CODE_LENGTH + 7];
+	snprintf(game, sizeof(game), "BENCH%04u", index % _scale.games);
+	memcpy(packet.game.data, game, PRODUCT_CODE_LENGTH);
+	
+	// Login User
+	if(login_user_data(_users[index], &packet) == -1)
+	{
+		_users[index] = NULL;
+		_failures++;
+	}
+}
+
+/**
+ * Join simulated User into its Group
+ * @param index User Index
+ */
+void bench_connect(uint32_t index)
+{
+	// Logged out User
+	if(_users[index] == NULL) return;
+	
+	// Group Name (Players of a Game are spread evenly across its Groups, sized for 10 Digits although the Group Limit keeps it at 7)
+	SceNetAdhocctlGroupName group;
+	char name[ADHOCCTL_GROUPNAME_LEN + 4];
+	snprintf(name, sizeof(name), "G%07u", (index / _scale.games) % _scale.groups);
+	memcpy(group.data, name, ADHOCCTL_GROUPNAME_LEN);
+	
+	// Join Group
+	if(connect_user(_users[index], &group) == -1)
+	{
+		_users[index] = NULL;
+		_failures++;
+	}
+}
+
+/**
+ * Send Chat Message to the Group of the simulated User
+ * @param index User Index
+ */
+void bench_spread(uint32_t index)
+{
+	// Logged out User
+	if(_users[index] == NULL) return;
+	
+	// Spread Message
+	if(spread_message(_users[index], _message) == -1)
+	{
+		_users[index] = NULL;
+		_failures++;
+	}
+}
+
+/**
+ * Remove simulated User from its Group
+ * @param index User Index
+ */
+void bench_disconnect(uint32_t index)
+{
+	// Logged out User
+	if(_users[index] == NULL) return;
+	
+	// Leave Group
+	if(disconnect_user(_users[index]) == -1)
+	{
+		_users[index] = NULL;
+		_failures++;
+	}
+}
+
+/**
+ * Send Scan Result to the simulated User
+ * @param index User Index
+ */
+void bench_scan(uint32_t index)
+{
+	// Logged out User
+	if(_users[index] == NULL) return;
+	
+	// Scan
+	if(send_scan_results(_users[index]) == -1)
+	{
+		_users[index] = NULL;
+		_failures++;
+	}
+}
+
+/**
+ * Mark Status as changed
+ * @param index Unused
+ */
+void bench_update_status(uint32_t index)
+{
+	// Update Status
+	update_status();
+}
+
+/**
+ * Capture and render the JSON Status
+ * @param index Unused
+ */
+void bench_status_json(uint32_t index)
+{
+	// Force Recapture (Requests within the Status Interval would serve the cached Snapshot)
+	expire_status_json();
+	
+	// Status Request
+	SceNetAdhocctlHttpExchange exchange;
+	memset(&exchange, 0, sizeof(exchange));
+	exchange.query = "";
+	exchange.header = "";
+	
+	// Serve Status
+	if(serve_status_json(&exchange) != 200) _failures++;
+	
+	// Free Response Body
+	free(exchange.body.data);
+}
+
+/**
+ * Logout simulated User
+ * @param index User Index
+ */
+void bench_logout(uint32_t index)
+{
+	// Logged out User
+	if(_users[index] == NULL) return;
+	
+	// Logout User (closes the Server Side)
+	logout_user(_users[index]);
+	_users[index] = NULL;
+}
@@ -0,0 +1,815 @@
+/*
+ * This file is part of PRO ONLINE.
+
+ * PRO ONLINE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * PRO ONLINE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PRO ONLINE. If not, see <http://www.gnu.org/licenses/ .
+ */
+
+/*
+ * Protocol Load Generator
+ *
+ * Simulates PSP Clients against a running Server. Every Client loops
+ * through Login -> Scan -> Join -> Chat -> Leave -> Scan -> Join ... and
+ * gets reconnected by the Churn Rate. Latencies are measured from Request
+ * to Reply: Login (TCP Connect until the pipelined first Scan completes),
+ * Join (until OPCODE_CONNECT_BSSID), Scan (until OPCODE_SCAN_COMPLETE) and
+ * Chat (Delivery to each Group Peer, the Send Time travels in the Message).
+ *
+ * The Server allows one Connection per IP Address, so Clients bind to
+ * consecutive Loopback Source Addresses (-b) by default.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <pspstructs.h>
+#include <packets.h>
+
+// Client States
+#define LOADGEN_STATE_IDLE 0
+#define LOADGEN_STATE_CONNECTING 1
+#define LOADGEN_STATE_LOGIN 2
+#define LOADGEN_STATE_SCAN 3
+#define LOADGEN_STATE_JOIN 4
+#define LOADGEN_STATE_GROUPED 5
+
+// Measured Operations
+#define LOADGEN_OP_LOGIN 0
+#define LOADGEN_OP_JOIN 1
+#define LOADGEN_OP_SCAN 2
+#define LOADGEN_OP_CHAT 3
+#define LOADGEN_OP_COUNT 4
+
+// Client RX Buffer (largest S2C Packet is the Chat Packet)
+#define LOADGEN_RXBUF_SIZE 4096
+
+// Ping Interval (Microseconds, well below the Server Timeout)
+#define LOADGEN_PING_INTERVAL 5000000ULL
+
+// Reconnect Delay (Microseconds, gives the Server Time to drop the old Connection of the same IP)
+#define LOADGEN_RECONNECT_DELAY 250000ULL
+
+// Simulated Client
+typedef struct
+{
+	// TCP Socket (-1 while idle)
+	int stream;
+	
+	// Client State
+	int state;
+	
+	// Client Number
+	uint32_t id;
+	
+	// Connection Generation (varies the MAC Address across Reconnects)
+	uint32_t generation;
+	
+	// Pending Operation Start (Microseconds)
+	uint64_t started;
+	
+	// Next Reconnect, Chat, Ping and Leave (Microseconds)
+	uint64_t wakeup;
+	uint64_t nextchat;
+	uint64_t nextping;
+	uint64_t leaveat;
+	
+	// RX Buffer
+	uint8_t rx[LOADGEN_RXBUF_SIZE];
+	uint32_t rxlen;
+} SceNetAdhocctlLoadgenClient;
+
+// Latency Samples of one Operation (Microseconds)
+typedef struct
+{
+	uint32_t * sample;
+	uint32_t count;
+	uint32_t size;
+} SceNetAdhocctlLoadgenSamples;
+
+// Settings
+static const char * _server_host = "127.0.0.1";
+static uint16_t _server_port = 27312;
+static uint32_t _client_count = 100;
+static uint32_t _game_count = 10;
+static uint32_t _group_size = 4;
+static uint32_t _session_ms = 5000;
+static uint32_t _chat_ms = 1000;
+static double _churn_rate = 0.01;
+static uint32_t _ramp_rate = 1000;
+static uint32_t _duration = 10;
+static const char * _source_base = "127.1.0.1";
+
+// Source Address Base (Host Order, 0 binds nothing)
+static uint32_t _source_ip = 0;
+
+// Server Address
+static struct sockaddr_in _server_addr;
+
+// Clients
+static SceNetAdhocctlLoadgenClient * _clients = NULL;
+
+// Event Poll
+static int _epoll = -1;
+
+// Latency Samples
+static SceNetAdhocctlLoadgenSamples _samples[LOADGEN_OP_COUNT];
+static const char * _op_name[LOADGEN_OP_COUNT] = { "login", "join", "scan", "chat" };
+
+// Counters
+static uint64_t _packets_sent = 0;
+static uint64_t _packets_received = 0;
+static uint64_t _connects = 0;
+static uint64_t _failures = 0;
+
+// Running Flag
+static volatile int _running = 1;
+
+// Function Prototypes
+void usage(const char * program);
+void interrupt(int sig);
+uint64_t get_clock(void);
+void record_sample(int op, uint64_t latency);
+void start_client(SceNetAdhocctlLoadgenClient * client, uint64_t now);
+void stop_client(SceNetAdhocctlLoadgenClient * client, uint64_t delay, int failed);
+void send_packet(SceNetAdhocctlLoadgenClient * client, const void * data, uint32_t size);
+void send_login(SceNetAdhocctlLoadgenClient * client);
+void send_join(SceNetAdhocctlLoadgenClient * client, uint64_t now);
+void send_chat(SceNetAdhocctlLoadgenClient * client, uint64_t now);
+void receive_client(SceNetAdhocctlLoadgenClient * client, uint64_t now);
+int process_packet(SceNetAdhocctlLoadgenClient * client, const uint8_t * packet, uint32_t size, uint64_t now);
+void tick_client(SceNetAdhocctlLoadgenClient * client, uint64_t now);
+int compare_samples(const void * a, const void * b);
+void print_report(double seconds);
+
+/**
+ * Load Generator Entry Point
+ * @param argc Number of Arguments
+ * @param argv Arguments
+ * @return OS Error Code
+ */
+int main(int argc, char * argv[])
+{
+	// Parse Options
+	int option = 0;
+	while((option = getopt(argc, argv, "H:p:n:g:s:l:t:c:r:d:b:")) != -1)
+	{
+		switch(option)
+		{
+			case 'H': _server_host = optarg; break;
+			case 'p': _server_port = (uint16_t)atoi(optarg); break;
+			case 'n': _client_count = (uint32_t)atoi(optarg); break;
+			case 'g': _game_count = (uint32_t)atoi(optarg); break;
+			case 's': _group_size = (uint32_t)atoi(optarg); break;
+			case 'l': _session_ms = (uint32_t)atoi(optarg); break;
+			case 't': _chat_ms = (uint32_t)atoi(optarg); break;
+			case 'c': _churn_rate = atof(optarg); break;
+			case 'r': _ramp_rate = (uint32_t)atoi(optarg); break;
+			case 'd': _duration = (uint32_t)atoi(optarg); break;
+			case 'b': _source_base = optarg; break;
+			default: usage(argv[0]); return 1;
+		}
+	}
+	
+	// Invalid Settings
+	if(_client_count == 0 || _game_count == 0 || _game_count > 10000 || _group_size == 0 || _ramp_rate == 0 || _duration == 0)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+	
+	// Server Address
+	memset(&_server_addr, 0, sizeof(_server_addr));
+	_server_addr.sin_family = AF_INET;
+	_server_addr.sin_port = htons(_server_port);
+	if(inet_pton(AF_INET, _server_host, &_server_addr.sin_addr) != 1)
+	{
+		fprintf(stderr, "Invalid Server Address %s.\n", _server_host);
+		return 1;
+	}
+	
+	// Source Address Base ("any" lets the Kernel pick, which only works for one Client per Host)
+	struct in_addr source;
+	if(strcmp(_source_base, "any") == 0) _source_ip = 0;
+	else if(inet_pton(AF_INET, _source_base, &source) == 1) _source_ip = ntohl(source.s_addr);
+	else
+	{
+		fprintf(stderr, "Invalid Source Address %s.\n", _source_base);
+		return 1;
+	}
+	
+	// Raise Descriptor Limit (one Socket per Client)
+	struct rlimit limit;
+	if(getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < _client_count + 64)
+	{
+		limit.rlim_cur = (limit.rlim_max == RLIM_INFINITY || limit.rlim_max > _client_count + 64) ? _client_count + 64 : limit.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &limit);
+	}
+	
+	// Allocate Clients
+	_clients = (SceNetAdhocctlLoadgenClient *)calloc(_client_count, sizeof(SceNetAdhocctlLoadgenClient));
+	_epoll = epoll_create1(0);
+	if(_clients == NULL || _epoll == -1)
+	{
+		fprintf(stderr, "Out of Memory for %u Clients.\n", _client_count);
+		return 1;
+	}
+	
+	// Stop on CTRL + C
+	signal(SIGINT, interrupt);
+	signal(SIGTERM, interrupt);
+	signal(SIGPIPE, SIG_IGN);
+	
+	// Random Seed
+	srand((unsigned int)time(NULL));
+	
+	// Initialize Clients (connected by the Ramp)
+	uint32_t i = 0; for(; i < _client_count; i++)
+	{
+		_clients[i].stream = -1;
+		_clients[i].id = i;
+		_clients[i].wakeup = (uint64_t)-1;
+	}
+	
+	// Notify User
+	printf("Simulating %u Clients in %u Games (Groups of %u) against %s:%u for %u Seconds...\n", _client_count, _game_count, _group_size, _server_host, _server_port, _duration);
+	
+	// Run Times
+	uint64_t begin = get_clock();
+	uint64_t end = begin + _duration * 1000000ULL;
+	uint64_t nextchurn = begin + 1000000ULL;
+	uint32_t ramped = 0;
+	
+	// Event Loop
+	uint64_t now = begin;
+	while(_running && now < end)
+	{
+		// Wait for Socket Events (Timers get checked every Millisecond)
+		struct epoll_event events[256];
+		int count = epoll_wait(_epoll, events, 256, 1);
+		now = get_clock();
+		
+		// Handle Socket Events
+		int j = 0; for(; j < count; j++)
+		{
+			// Client
+			SceNetAdhocctlLoadgenClient * client = (SceNetAdhocctlLoadgenClient *)events[j].data.ptr;
+			
+			// Connection established
+			if(client->state == LOADGEN_STATE_CONNECTING && (events[j].events & (EPOLLOUT | EPOLLERR | EPOLLHUP)))
+			{
+				// Connect Result
+				int error = 0;
+				socklen_t errorlen = sizeof(error);
+				getsockopt(client->stream, SOL_SOCKET, SO_ERROR, &error, &errorlen);
+				
+				// Connect failed
+				if(error != 0)
+				{
+					stop_client(client, LOADGEN_RECONNECT_DELAY, 1);
+					continue;
+				}
+				
+				// Stop watching Writability
+				struct epoll_event event;
+				memset(&event, 0, sizeof(event));
+				event.events = EPOLLIN;
+				event.data.ptr = client;
+				epoll_ctl(_epoll, EPOLL_CTL_MOD, client->stream, &event);
+				
+				// Login (and Scan, which answers once the Login went through)
+				send_login(client);
+				continue;
+			}
+			
+			// Data or Hangup
+			if(client->stream != -1 && (events[j].events & (EPOLLIN | EPOLLERR | EPOLLHUP))) receive_client(client, now);
+		}
+		
+		// Ramp up Connections
+		uint64_t due = (now - begin) * _ramp_rate / 1000000ULL + 1;
+		while(ramped < _client_count && ramped < due) start_client(&_clients[ramped++], now);
+		
+		// Churn (disconnect a random Share of the Clients every Second)
+		if(now >= nextchurn)
+		{
+			// Churned Clients
+			uint32_t churn = (uint32_t)(_churn_rate * ramped + (double)rand() / RAND_MAX);
+			for(j = 0; j < (int)churn; j++)
+			{
+				// Random Client
+				SceNetAdhocctlLoadgenClient * client = &_clients[rand() % ramped];
+				
+				// Reconnect logged-in Client
+				if(client->state >= LOADGEN_STATE_SCAN) stop_client(client, LOADGEN_RECONNECT_DELAY, 0);
+			}
+			
+			// Next Churn
+			nextchurn += 1000000ULL;
+		}
+		
+		// Client Timers
+		for(j = 0; j < (int)ramped; j++) tick_client(&_clients[j], now);
+	}
+	
+	// Print Report
+	print_report((now - begin) / 1e6);
+	
+	// Close Clients
+	for(i = 0; i < _client_count; i++) if(_clients[i].stream != -1) close(_clients[i].stream);
+	close(_epoll);
+	
+	// Free Memory
+	free(_clients);
+	for(i = 0; i < LOADGEN_OP_COUNT; i++) free(_samples[i].sample);
+	
+	// Return Success
+	return 0;
+}
+
+/**
+ * Print Usage
+ * @param program Program Name
+ */
+void usage(const char * program)
+{
+	fprintf(stderr, "Usage: %s [options]\n", program);
+	fprintf(stderr, "  -H host     Server Address (default 127.0.0.1)\n");
+	fprintf(stderr, "  -p port     Server Port (default 27312)\n");
+	fprintf(stderr, "  -n count    Clients (default 100)\n");
+	fprintf(stderr, "  -g count    Games, Clients are spread evenly (default 10)\n");
+	fprintf(stderr, "  -s count    Group Size (default 4)\n");
+	fprintf(stderr, "  -l ms       Time spent in a Group before leaving (default 5000, +-50%%)\n");
+	fprintf(stderr, "  -t ms       Chat Interval per grouped Client (default 1000, 0 disables Chat)\n");
+	fprintf(stderr, "  -c rate     Share of Clients reconnecting every Second (default 0.01)\n");
+	fprintf(stderr, "  -r rate     Connections opened per Second while ramping up (default 1000)\n");
+	fprintf(stderr, "  -d seconds  Duration (default 10)\n");
+	fprintf(stderr, "  -b address  First Source Address, one per Client (default 127.1.0.1, \"any\" for none)\n");
+}
+
+/**
+ * Stop Request Handler
+ * @param sig Captured Signal
+ */
+void interrupt(int sig)
+{
+	// Stop Event Loop (the Report still gets printed)
+	_running = 0;
+}
+
+/**
+ * Get Monotonic Clock
+ * @return Microseconds
+ */
+uint64_t get_clock(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000ULL + now.tv_nsec / 1000;
+}
+
+/**
+ * Record Latency Sample
+ * @param op Measured Operation
+ * @param latency Latency (Microseconds)
+ */
+void record_sample(int op, uint64_t latency)
+{
+	// Samples
+	SceNetAdhocctlLoadgenSamples * samples = &_samples[op];
+	
+	// Grow Sample Array
+	if(samples->count == samples->size)
+	{
+		uint32_t size = (samples->size == 0) ? 4096 : samples->size * 2;
+		uint32_t * sample = (uint32_t *)realloc(samples->sample, size * sizeof(uint32_t));
+		if(sample == NULL) return;
+		samples->sample = sample;
+		samples->size = size;
+	}
+	
+	// Store Sample (clamped to 32 Bit)
+	samples->sample[samples->count++] = (latency > 0xFFFFFFFFULL) ? 0xFFFFFFFFU : (uint32_t)latency;
+}
+
+/**
+ * Open Client Connection (non-blocking)
+ * @param client Client
+ * @param now Current Time
+ */
+void start_client(SceNetAdhocctlLoadgenClient * client, uint64_t now)
+{
+	// Create Socket
+	client->stream = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if(client->stream == -1)
+	{
+		stop_client(client, LOADGEN_RECONNECT_DELAY, 1);
+		return;
+	}
+	
+	// Non-Blocking, no Nagle (the Protocol sends tiny Packets)
+	int on = 1;
+	fcntl(client->stream, F_SETFL, O_NONBLOCK);
+	setsockopt(client->stream, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+	
+	// Bind Source Address (one per Client)
+	if(_source_ip != 0)
+	{
+		struct sockaddr_in local;
+		memset(&local, 0, sizeof(local));
+		local.sin_family = AF_INET;
+		local.sin_addr.s_addr = htonl(_source_ip + client->id);
+		if(bind(client->stream, (struct sockaddr *)&local, sizeof(local)) == -1)
+		{
+			stop_client(client, LOADGEN_RECONNECT_DELAY, 1);
+			return;
+		}
+	}
+	
+	// Reset Client
+	client->state = LOADGEN_STATE_CONNECTING;
+	client->generation++;
+	client->started = now;
+	client->rxlen = 0;
+	client->wakeup = (uint64_t)-1;
+	client->nextping = now + LOADGEN_PING_INTERVAL;
+	
+	// Start Connect
+	if(connect(client->stream, (struct sockaddr *)&_server_addr, sizeof(_server_addr)) == -1 && errno != EINPROGRESS)
+	{
+		stop_client(client, LOADGEN_RECONNECT_DELAY, 1);
+		return;
+	}
+	
+	// Watch Socket
+	struct epoll_event event;
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLOUT | EPOLLIN;
+	event.data.ptr = client;
+	epoll_ctl(_epoll, EPOLL_CTL_ADD, client->stream, &event);
+	
+	// Count Connect
+	_connects++;
+}
+
+/**
+ * Close Client Connection and schedule a Reconnect
+ * @param client Client
+ * @param delay Reconnect Delay (Microseconds)
+ * @param failed Count as Failure
+ */
+void stop_client(SceNetAdhocctlLoadgenClient * client, uint64_t delay, int failed)
+{
+	// Close Socket (removes it from the Event Poll)
+	if(client->stream != -1) close(client->stream);
+	client->stream = -1;
+	
+	// Schedule Reconnect
+	client->state = LOADGEN_STATE_IDLE;
+	client->wakeup = get_clock() + delay;
+	
+	// Count Failure
+	if(failed) _failures++;
+}
+
+/**
+ * Send Packet (the Socket Buffer is large enough for this Protocol, short Writes drop the Client)
+ * @param client Client
+ * @param data Packet
+ * @param size Packet Size
+ */
+void send_packet(SceNetAdhocctlLoadgenClient * client, const void * data, uint32_t size)
+{
+	// Send Packet
+	if(send(client->stream, data, size, MSG_NOSIGNAL) != (ssize_t)size)
+	{
+		stop_client(client, LOADGEN_RECONNECT_DELAY, 1);
+		return;
+	}
+	
+	// Count Packet
+	_packets_sent++;
+}
+
+/**
+ * Send Login and first Scan
+ * @param client Client
+ */
+void send_login(SceNetAdhocctlLoadgenClient * client)
+{
+	// Login & Scan Packets (pipelined)
+	struct
+	{
+		SceNetAdhocctlLoginPacketC2S login;
+		SceNetAdhocctlPacketBase scan;
+	} __attribute__((packed)) packet;
+	memset(&packet, 0, sizeof(packet));
+	
+	// Login Packet
+	packet.login.base.opcode = OPCODE_LOGIN;
+	packet.login.mac.data[0] = 0x02;
+	packet.login.mac.data[1] = (uint8_t)client->generation;
+	packet.login.mac.data[2] = (uint8_t)(client->id >> 24);
+	packet.login.mac.data[3] = (uint8_t)(client->id >> 16);
+	packet.login.mac.data[4] = (uint8_t)(client->id >> 8);
+	packet.login.mac.data[5] = (uint8_t)client->id;
+	snprintf((char *)packet.login.name.data, sizeof(packet.login.name.data), "lg%u", client->id);
+	
+	// Synthetic Product Code (9 Characters, A-Z & 0-9, sized for 10 Digits although the Game Limit keeps it at 4)
+	char game[PRODUCT_CODE_LENGTH + 7];
+	snprintf(game, sizeof(game), "LOADG%04u", client->id % _game_count);
+	memcpy(packet.login.game.data, game, PRODUCT_CODE_LENGTH);
+	
+	// Scan Packet
+	packet.scan.opcode = OPCODE_SCAN;
+	
+	// Send Packets
+	send_packet(client, &packet, sizeof(packet));
+	_packets_sent++;
+	
+	// Wait for the Scan Result
+	if(client->stream != -1) client->state = LOADGEN_STATE_LOGIN;
+}
+
+/**
+ * Send Group Join
+ * @param client Client
+ * @param now Current Time
+ */
+void send_join(SceNetAdhocctlLoadgenClient * client, uint64_t now)
+{
+	// Connect Packet
+	SceNetAdhocctlConnectPacketC2S packet;
+	memset(&packet, 0, sizeof(packet));
+	packet.base.opcode = OPCODE_CONNECT;
+	
+	// Group Name (Clients of a Game fill Groups of the configured Size)
+	char group[ADHOCCTL_GROUPNAME_LEN + 1];
+	snprintf(group, sizeof(group), "G%07u", (client->id / _game_count) / _group_size % 10000000);
+	memcpy(packet.group.data, group, ADHOCCTL_GROUPNAME_LEN);
+	
+	// Send Packet
+	client->started = now;
+	send_packet(client, &packet, sizeof(packet));
+	
+	// Wait for the BSSID
+	if(client->stream != -1) client->state = LOADGEN_STATE_JOIN;
+}
+
+/**
+ * Send Chat Message (carries the Send Time for the Receivers)
+ * @param client Client
+ * @param now Current Time
+ */
+void send_chat(SceNetAdhocctlLoadgenClient * client, uint64_t now)
+{
+	// Chat Packet
+	SceNetAdhocctlChatPacketC2S packet;
+	memset(&packet, 0, sizeof(packet));
+	packet.base.opcode = OPCODE_CHAT;
+	snprintf(packet.message, sizeof(packet.message), "LG%llu", (unsigned long long)now);
+	
+	// Send Packet
+	send_packet(client, &packet, sizeof(packet));
+}
+
+/**
+ * Receive and process Server Packets
+ * @param client Client
+ * @param now Current Time
+ */
+void receive_client(SceNetAdhocctlLoadgenClient * client, uint64_t now)
+{
+	// Drain Socket
+	while(client->stream != -1)
+	{
+		// Receive Data
+		ssize_t recvresult = recv(client->stream, client->rx + client->rxlen, sizeof(client->rx) - client->rxlen, MSG_DONTWAIT);
+		
+		// No more Data
+		if(recvresult == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+		
+		// Connection closed by the Server
+		if(recvresult <= 0)
+		{
+			stop_client(client, LOADGEN_RECONNECT_DELAY, 1);
+			return;
+		}
+		
+		// Move Buffer Length
+		client->rxlen += recvresult;
+		
+		// Receive Time (Replies to Requests sent while draining arrive later)
+		now = get_clock();
+		
+		// Process complete Packets
+		uint32_t offset = 0;
+		while(client->stream != -1 && offset < client->rxlen)
+		{
+			// Packet Size by Opcode
+			uint32_t size = 0;
+			switch(client->rx[offset])
+			{
+				case OPCODE_CONNECT: size = sizeof(SceNetAdhocctlConnectPacketS2C); break;
+				case OPCODE_DISCONNECT: size = sizeof(SceNetAdhocctlDisconnectPacketS2C); break;
+				case OPCODE_SCAN: size = sizeof(SceNetAdhocctlScanPacketS2C); break;
+				case OPCODE_SCAN_COMPLETE: size = 1; break;
+				case OPCODE_CONNECT_BSSID: size = sizeof(SceNetAdhocctlConnectBSSIDPacketS2C); break;
+				case OPCODE_CHAT: size = sizeof(SceNetAdhocctlChatPacketS2C); break;
+			}
+			
+			// Unknown Opcode (Protocol Error)
+			if(size == 0)
+			{
+				stop_client(client, LOADGEN_RECONNECT_DELAY, 1);
+				return;
+			}
+			
+			// Incomplete Packet
+			if(client->rxlen - offset < size) break;
+			
+			// Process Packet
+			process_packet(client, client->rx + offset, size, now);
+			offset += size;
+			_packets_received++;
+		}
+		
+		// Keep incomplete Packet
+		if(client->stream != -1 && offset > 0)
+		{
+			memmove(client->rx, client->rx + offset, client->rxlen - offset);
+			client->rxlen -= offset;
+		}
+	}
+}
+
+/**
+ * Process Server Packet
+ * @param client Client
+ * @param packet Packet
+ * @param size Packet Size
+ * @param now Current Time
+ * @return 0
+ */
+int process_packet(SceNetAdhocctlLoadgenClient * client, const uint8_t * packet, uint32_t size, uint64_t now)
+{
+	// Scan complete
+	if(packet[0] == OPCODE_SCAN_COMPLETE && (client->state == LOADGEN_STATE_LOGIN || client->state == LOADGEN_STATE_SCAN))
+	{
+		// Record Login or Scan
+		record_sample((client->state == LOADGEN_STATE_LOGIN) ? LOADGEN_OP_LOGIN : LOADGEN_OP_SCAN, now - client->started);
+		
+		// Join Group
+		send_join(client, now);
+	}
+	
+	// Joined Group
+	else if(packet[0] == OPCODE_CONNECT_BSSID && client->state == LOADGEN_STATE_JOIN)
+	{
+		// Record Join
+		record_sample(LOADGEN_OP_JOIN, now - client->started);
+		
+		// Stay in Group for a while (+-50%)
+		client->state = LOADGEN_STATE_GROUPED;
+		client->leaveat = now + (uint64_t)_session_ms * 500 + (uint64_t)(rand() % (_session_ms + 1)) * 1000;
+		client->nextchat = now + (uint64_t)(rand() % (_chat_ms + 1)) * 1000;
+	}
+	
+	// Chat Message from a Group Peer
+	else if(packet[0] == OPCODE_CHAT)
+	{
+		// Message (terminated Copy)
+		char message[sizeof(((SceNetAdhocctlChatPacketC2S *)0)->message) + 1];
+		memcpy(message, ((const SceNetAdhocctlChatPacketS2C *)packet)->base.message, sizeof(message) - 1);
+		message[sizeof(message) - 1] = 0;
+		
+		// Record Delivery (Messages of other Tools are ignored)
+		unsigned long long sent = 0;
+		if(sscanf(message, "LG%llu", &sent) == 1 && sent <= now) record_sample(LOADGEN_OP_CHAT, now - sent);
+	}
+	
+	// Return Success
+	return 0;
+}
+
+/**
+ * Run Client Timers (Reconnect, Ping, Chat and Leave)
+ * @param client Client
+ * @param now Current Time
+ */
+void tick_client(SceNetAdhocctlLoadgenClient * client, uint64_t now)
+{
+	// Reconnect
+	if(client->state == LOADGEN_STATE_IDLE)
+	{
+		if(now >= client->wakeup) start_client(client, now);
+		return;
+	}
+	
+	// Not connected yet
+	if(client->state == LOADGEN_STATE_CONNECTING) return;
+	
+	// Keep-Alive Ping
+	if(now >= client->nextping)
+	{
+		uint8_t opcode = OPCODE_PING;
+		send_packet(client, &opcode, 1);
+		client->nextping = now + LOADGEN_PING_INTERVAL;
+		if(client->stream == -1) return;
+	}
+	
+	// Grouped Client
+	if(client->state == LOADGEN_STATE_GROUPED)
+	{
+		// Chat
+		if(_chat_ms > 0 && now >= client->nextchat)
+		{
+			send_chat(client, now);
+			client->nextchat = now + _chat_ms * 1000ULL;
+			if(client->stream == -1) return;
+		}
+		
+		// Leave Group & Scan (pipelined)
+		if(now >= client->leaveat)
+		{
+			uint8_t packets[2] = { OPCODE_DISCONNECT, OPCODE_SCAN };
+			client->started = now;
+			send_packet(client, packets, sizeof(packets));
+			_packets_sent++;
+			if(client->stream != -1) client->state = LOADGEN_STATE_SCAN;
+		}
+	}
+}
+
+/**
+ * Compare Latency Samples
+ * @param a Sample A
+ * @param b Sample B
+ * @return Comparison Result
+ */
+int compare_samples(const void * a, const void * b)
+{
+	uint32_t sa = *(const uint32_t *)a;
+	uint32_t sb = *(const uint32_t *)b;
+	return (sa > sb) - (sa < sb);
+}
+
+/**
+ * Print Throughput & Latency Report
+ * @param seconds Measured Seconds
+ */
+void print_report(double seconds)
+{
+	// Totals
+	printf("\n%.1f Seconds, %llu Connects, %llu Failures, %.0f Packets/s sent, %.0f Packets/s received\n\n", seconds, (unsigned long long)_connects, (unsigned long long)_failures, _packets_sent / seconds, _packets_received / seconds);
+	
+	// Table Header
+	printf("%-8s %10s %10s %10s %10s %10s %10s\n", "op", "count", "ops/s", "p50 (us)", "p99 (us)", "p999 (us)", "max (us)");
+	
+	// Operations
+	int op = 0; for(; op < LOADGEN_OP_COUNT; op++)
+	{
+		// Samples
+		SceNetAdhocctlLoadgenSamples * samples = &_samples[op];
+		
+		// No Samples
+		if(samples->count == 0)
+		{
+			printf("%-8s %10u %10s %10s %10s %10s %10s\n", _op_name[op], 0, "-", "-", "-", "-", "-");
+			continue;
+		}
+		
+		// Sort Samples
+		qsort(samples->sample, samples->count, sizeof(uint32_t), compare_samples);
+		
+		// Percentiles
+		uint32_t p50 = samples->sample[(uint32_t)(samples->count * 0.5)];
+		uint32_t p99 = samples->sample[(uint32_t)(samples->count * 0.99)];
+		uint32_t p999 = samples->sample[(uint32_t)(samples->count * 0.999)];
+		uint32_t max = samples->sample[samples->count - 1];
+		
+		// Print Row
+		printf("%-8s %10u %10.0f %10u %10u %10u %10u\n", _op_name[op], samples->count, samples->count / seconds, p50, p99, p999, max);
+	}
+}
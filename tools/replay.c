@@ -0,0 +1,504 @@
+/*
+ * This file is part of PRO ONLINE.
+
+ * PRO ONLINE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * PRO ONLINE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PRO ONLINE. If not, see <http://www.gnu.org/licenses/ .
+ */
+
+/*
+ * Traffic Trace Replay
+ *
+ * Plays a Trace recorded by the Server (--trace) back against a
+ * Server, one TCP Connection per recorded Connection, with the recorded
+ * C2S Packets in the recorded Order. The Timing follows the Trace scaled
+ * by the Speed Factor (-s 1 is Real Time, -s 0 sends as fast as possible).
+ * Server Replies are read and discarded.
+ *
+ * The Server allows one Connection per IP Address, so Connections bind to
+ * consecutive Loopback Source Addresses (-b) instead of the recorded ones.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <trace.h>
+
+// Linger after the last Record (Microseconds, collects the last Replies)
+#define REPLAY_LINGER 1000000ULL
+
+// Settings
+static const char * _server_host = "127.0.0.1";
+static uint16_t _server_port = 27312;
+static double _speed = 1.0;
+static const char * _source_base = "127.2.0.1";
+
+// Source Address Base (Host Order, 0 binds nothing)
+static uint32_t _source_ip = 0;
+
+// Server Address
+static struct sockaddr_in _server_addr;
+
+// Connection Sockets by Connection Number (-1 if closed)
+static int * _sockets = NULL;
+static uint32_t _sockets_size = 0;
+
+// Event Poll
+static int _epoll = -1;
+
+// Counters
+static uint64_t _records = 0;
+static uint64_t _connections = 0;
+static uint64_t _packets = 0;
+static uint64_t _bytes_sent = 0;
+static uint64_t _bytes_received = 0;
+static uint64_t _skipped = 0;
+static uint64_t _failures = 0;
+static uint64_t _server_closes = 0;
+static uint64_t _lag = 0;
+
+// Running Flag
+static volatile int _running = 1;
+
+// Function Prototypes
+void usage(const char * program);
+void interrupt(int sig);
+uint64_t get_clock(void);
+int * find_socket(uint32_t connection);
+void open_connection(uint32_t connection);
+void close_connection(uint32_t connection);
+void send_packet(uint32_t connection, const uint8_t * packet, uint32_t size);
+void drain_replies(int timeout);
+
+/**
+ * Replay Entry Point
+ * @param argc Number of Arguments
+ * @param argv Arguments
+ * @return OS Error Code
+ */
+int main(int argc, char * argv[])
+{
+	// Parse Options
+	int option = 0;
+	while((option = getopt(argc, argv, "H:p:s:b:")) != -1)
+	{
+		switch(option)
+		{
+			case 'H': _server_host = optarg; break;
+			case 'p': _server_port = (uint16_t)atoi(optarg); break;
+			case 's': _speed = atof(optarg); break;
+			case 'b': _source_base = optarg; break;
+			default: usage(argv[0]); return 1;
+		}
+	}
+	
+	// Missing Trace File
+	if(optind != argc - 1 || _speed < 0)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+	
+	// Server Address
+	memset(&_server_addr, 0, sizeof(_server_addr));
+	_server_addr.sin_family = AF_INET;
+	_server_addr.sin_port = htons(_server_port);
+	if(inet_pton(AF_INET, _server_host, &_server_addr.sin_addr) != 1)
+	{
+		fprintf(stderr, "Invalid Server Address %s.\n", _server_host);
+		return 1;
+	}
+	
+	// Source Address Base ("any" lets the Kernel pick, which only works for one Connection at a Time)
+	struct in_addr source;
+	if(strcmp(_source_base, "any") == 0) _source_ip = 0;
+	else if(inet_pton(AF_INET, _source_base, &source) == 1) _source_ip = ntohl(source.s_addr);
+	else
+	{
+		fprintf(stderr, "Invalid Source Address %s.\n", _source_base);
+		return 1;
+	}
+	
+	// Open Trace File
+	FILE * trace = fopen(argv[optind], "rb");
+	if(trace == NULL)
+	{
+		fprintf(stderr, "Failed to open %s: %s\n", argv[optind], strerror(errno));
+		return 1;
+	}
+	
+	// Read File Header
+	SceNetAdhocctlTraceHeader header;
+	if(fread(&header, sizeof(header), 1, trace) != 1 || memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0 || header.version != TRACE_VERSION)
+	{
+		fprintf(stderr, "%s is not a Version %u Trace.\n", argv[optind], TRACE_VERSION);
+		fclose(trace);
+		return 1;
+	}
+	
+	// Raise Descriptor Limit (Lobby Rushes hold many Connections)
+	struct rlimit limit;
+	if(getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max)
+	{
+		limit.rlim_cur = limit.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &limit);
+	}
+	
+	// Create Event Poll
+	_epoll = epoll_create1(0);
+	if(_epoll == -1)
+	{
+		fprintf(stderr, "epoll_create1 failed: %s\n", strerror(errno));
+		fclose(trace);
+		return 1;
+	}
+	
+	// Stop on CTRL + C
+	signal(SIGINT, interrupt);
+	signal(SIGTERM, interrupt);
+	signal(SIGPIPE, SIG_IGN);
+	
+	// Notify User
+	time_t started = (time_t)(header.started / 1000);
+	printf("Replaying %s (recorded %s) against %s:%u at %s...\n", argv[optind], strtok(ctime(&started), "\n"), _server_host, _server_port, (_speed > 0) ? "the recorded Pace" : "full Speed");
+	if(_speed > 0 && _speed != 1.0) printf("Speed Factor %.2f\n", _speed);
+	
+	// Replay Clocks (Microseconds)
+	uint64_t begin = get_clock();
+	uint64_t tracetime = 0;
+	
+	// Replay Records
+	SceNetAdhocctlTraceRecord record;
+	while(_running && fread(&record, sizeof(record), 1, trace) == 1)
+	{
+		// Read Payload
+		uint8_t payload[256];
+		if(record.size > 0 && fread(payload, record.size, 1, trace) != 1)
+		{
+			fprintf(stderr, "Trace ends in the Middle of a Record.\n");
+			break;
+		}
+		
+		// Move Trace Clock
+		tracetime += record.delta;
+		_records++;
+		
+		// Wait for the Record Time (Replies get drained meanwhile)
+		if(_speed > 0)
+		{
+			// Record Time
+			uint64_t due = begin + (uint64_t)(tracetime / _speed);
+			
+			// Wait
+			uint64_t now = get_clock();
+			while(_running && now < due)
+			{
+				drain_replies((int)((due - now + 999) / 1000));
+				now = get_clock();
+			}
+			
+			// Remember Lag (the Replay couldn't keep up)
+			if(now - due > _lag) _lag = now - due;
+		}
+		
+		// Full Speed (drain without waiting)
+		else drain_replies(0);
+		
+		// Replay Record
+		switch(record.type)
+		{
+			case TRACE_RECORD_CONNECT: open_connection(record.connection); break;
+			case TRACE_RECORD_PACKET: send_packet(record.connection, payload, record.size); break;
+			case TRACE_RECORD_CLOSE: close_connection(record.connection); break;
+		}
+	}
+	
+	// Close Trace File
+	fclose(trace);
+	
+	// Collect the last Replies
+	uint64_t linger = get_clock() + REPLAY_LINGER;
+	while(_running && get_clock() < linger) drain_replies(10);
+	
+	// Elapsed Time
+	double seconds = (get_clock() - begin) / 1e6;
+	
+	// Close remaining Connections
+	uint32_t i = 0; for(; i < _sockets_size; i++) if(_sockets[i] != -1) close(_sockets[i]);
+	free(_sockets);
+	close(_epoll);
+	
+	// Print Report
+	printf("\n%llu Records (%.1f Seconds recorded) replayed in %.1f Seconds\n", (unsigned long long)_records, tracetime / 1e6, seconds);
+	printf("%llu Connections, %llu Connect Failures, %llu closed early by the Server\n", (unsigned long long)_connections, (unsigned long long)_failures, (unsigned long long)_server_closes);
+	printf("%llu Packets (%llu Bytes) sent, %llu skipped, %llu Bytes received\n", (unsigned long long)_packets, (unsigned long long)_bytes_sent, (unsigned long long)_skipped, (unsigned long long)_bytes_received);
+	if(_speed > 0) printf("Worst Lag behind the recorded Pace: %.1f ms\n", _lag / 1e3);
+	
+	// Return Success
+	return 0;
+}
+
+/**
+ * Print Usage
+ * @param program Program Name
+ */
+void usage(const char * program)
+{
+	fprintf(stderr, "Usage: %s [options] trace\n", program);
+	fprintf(stderr, "  -H host     Server Address (default 127.0.0.1)\n");
+	fprintf(stderr, "  -p port     Server Port (default 27312)\n");
+	fprintf(stderr, "  -s factor   Speed Factor (default 1 for Real Time, 0 for full Speed)\n");
+	fprintf(stderr, "  -b address  First Source Address, one per Connection (default 127.2.0.1, \"any\" for none)\n");
+}
+
+/**
+ * Stop Request Handler
+ * @param sig Captured Signal
+ */
+void interrupt(int sig)
+{
+	// Stop Replay (the Report still gets printed)
+	_running = 0;
+}
+
+/**
+ * Get Monotonic Clock
+ * @return Microseconds
+ */
+uint64_t get_clock(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000ULL + now.tv_nsec / 1000;
+}
+
+/**
+ * Find Socket Slot of Connection
+ * @param connection Connection Number
+ * @return Socket Slot or NULL if out of Memory
+ */
+int * find_socket(uint32_t connection)
+{
+	// Grow Socket Table
+	if(connection >= _sockets_size)
+	{
+		// New Capacity
+		uint32_t size = (_sockets_size == 0) ? 1024 : _sockets_size;
+		while(size <= connection) size *= 2;
+		
+		// Resize Table
+		int * sockets = (int *)realloc(_sockets, size * sizeof(int));
+		if(sockets == NULL) return NULL;
+		
+		// Mark new Slots closed
+		uint32_t i = _sockets_size; for(; i < size; i++) sockets[i] = -1;
+		_sockets = sockets;
+		_sockets_size = size;
+	}
+	
+	// Return Socket Slot
+	return &_sockets[connection];
+}
+
+/**
+ * Open recorded Connection
+ * @param connection Connection Number
+ */
+void open_connection(uint32_t connection)
+{
+	// Socket Slot
+	int * slot = find_socket(connection);
+	if(slot == NULL || *slot != -1)
+	{
+		_failures++;
+		return;
+	}
+	
+	// Create Socket
+	int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if(fd == -1)
+	{
+		_failures++;
+		return;
+	}
+	
+	// No Nagle (the Packets were recorded one by one)
+	int on = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+	
+	// Bind Source Address (one per Connection)
+	if(_source_ip != 0)
+	{
+		struct sockaddr_in local;
+		memset(&local, 0, sizeof(local));
+		local.sin_family = AF_INET;
+		local.sin_addr.s_addr = htonl(_source_ip + connection - 1);
+		if(bind(fd, (struct sockaddr *)&local, sizeof(local)) == -1)
+		{
+			close(fd);
+			_failures++;
+			return;
+		}
+	}
+	
+	// Connect (blocking, the Server backlogs it right away)
+	if(connect(fd, (struct sockaddr *)&_server_addr, sizeof(_server_addr)) == -1)
+	{
+		close(fd);
+		_failures++;
+		return;
+	}
+	
+	// Non-Blocking from now on
+	fcntl(fd, F_SETFL, O_NONBLOCK);
+	
+	// Watch Replies
+	struct epoll_event event;
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.u32 = connection;
+	epoll_ctl(_epoll, EPOLL_CTL_ADD, fd, &event);
+	
+	// Save Socket
+	*slot = fd;
+	_connections++;
+}
+
+/**
+ * Close recorded Connection
+ * @param connection Connection Number
+ */
+void close_connection(uint32_t connection)
+{
+	// Socket Slot
+	int * slot = (connection < _sockets_size) ? &_sockets[connection] : NULL;
+	
+	// Connection not open (failed or closed by the Server)
+	if(slot == NULL || *slot == -1) return;
+	
+	// Close Socket (removes it from the Event Poll)
+	close(*slot);
+	*slot = -1;
+}
+
+/**
+ * Send recorded Packet
+ * @param connection Connection Number
+ * @param packet Packet
+ * @param size Packet Size
+ */
+void send_packet(uint32_t connection, const uint8_t * packet, uint32_t size)
+{
+	// Socket Slot
+	int * slot = (connection < _sockets_size) ? &_sockets[connection] : NULL;
+	
+	// Connection not open
+	if(slot == NULL || *slot == -1)
+	{
+		_skipped++;
+		return;
+	}
+	
+	// Send Packet
+	uint32_t sent = 0;
+	while(_running && sent < size)
+	{
+		// Send Data
+		ssize_t sendresult = send(*slot, packet + sent, size - sent, MSG_NOSIGNAL);
+		
+		// Sent Data
+		if(sendresult > 0)
+		{
+			sent += sendresult;
+			continue;
+		}
+		
+		// Socket Buffer full (the Server is reading slower than the Trace sends)
+		if(sendresult == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+		{
+			// Read Replies (the Server might wait for us to read)
+			drain_replies(0);
+			
+			// Connection closed while draining
+			if(*slot == -1) break;
+			
+			// Wait for Buffer Space
+			struct pollfd pfd;
+			pfd.fd = *slot;
+			pfd.events = POLLOUT;
+			poll(&pfd, 1, 10);
+			continue;
+		}
+		
+		// Connection lost
+		close(*slot);
+		*slot = -1;
+		_server_closes++;
+		break;
+	}
+	
+	// Count Packet
+	if(sent == size)
+	{
+		_packets++;
+		_bytes_sent += size;
+	}
+	else _skipped++;
+}
+
+/**
+ * Read and discard Server Replies
+ * @param timeout Wait Timeout (Milliseconds)
+ */
+void drain_replies(int timeout)
+{
+	// Scratch Buffer
+	static uint8_t scratch[65536];
+	
+	// Readable Connections
+	struct epoll_event events[256];
+	int count = epoll_wait(_epoll, events, 256, timeout);
+	
+	// Drain Connections
+	int i = 0; for(; i < count; i++)
+	{
+		// Socket
+		uint32_t connection = events[i].data.u32;
+		int fd = _sockets[connection];
+		if(fd == -1) continue;
+		
+		// Read everything
+		ssize_t recvresult = 0;
+		while((recvresult = recv(fd, scratch, sizeof(scratch), MSG_DONTWAIT)) > 0) _bytes_received += recvresult;
+		
+		// Connection closed by the Server (Timeout or Kick ahead of the Trace)
+		if(recvresult == 0 || (recvresult == -1 && errno != EAGAIN && errno != EWOULDBLOCK))
+		{
+			close(fd);
+			_sockets[connection] = -1;
+			_server_closes++;
+		}
+	}
+}